@@ -0,0 +1,47 @@
+#pragma once
+
+//Minimal checks for the host tests, a failed check ends the executable with a non-zero status for ctest
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim_kernel.h"
+
+#define CHECK(cond) do \
+{ \
+    if (!(cond)) \
+    { \
+        fprintf(stderr, "%s:%d: CHECK(%s) failed at %llu us\n", __FILE__, __LINE__, #cond, \
+            (unsigned long long)(sim_now_us() - SIM_START_US)); \
+        exit(1); \
+    } \
+} while (0)
+
+#define CHECK_EQ(a, b) do \
+{ \
+    long long a_ = (long long)(a); \
+    long long b_ = (long long)(b); \
+    if (a_ != b_) \
+    { \
+        fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld at %llu us\n", __FILE__, __LINE__, #a, #b, a_, b_, \
+            (unsigned long long)(sim_now_us() - SIM_START_US)); \
+        exit(1); \
+    } \
+} while (0)
+
+//Inclusive range
+#define CHECK_RANGE(v, lo, hi) do \
+{ \
+    long long v_ = (long long)(v); \
+    if (v_ < (long long)(lo) || v_ > (long long)(hi)) \
+    { \
+        fprintf(stderr, "%s:%d: CHECK_RANGE(%s) failed: %lld not in [%lld, %lld]\n", __FILE__, __LINE__, #v, v_, \
+            (long long)(lo), (long long)(hi)); \
+        exit(1); \
+    } \
+} while (0)
+
+#define RUN_TEST(fn) do \
+{ \
+    printf("[ RUN  ] %s\n", #fn); \
+    fn(); \
+    printf("[   OK ] %s\n", #fn); \
+} while (0)
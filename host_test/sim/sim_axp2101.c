@@ -0,0 +1,135 @@
+#include "sim_board.h"
+#include "axp2101.h"
+#include "t_watch_s3.h"
+
+static uint32_t ldo_switches[8];
+
+static uint32_t pending(void)
+{
+    const uint8_t *r = sim_axp2101.regs;
+    uint32_t status = r[XPOWERS_AXP2101_INTSTS1] | ((uint32_t)r[XPOWERS_AXP2101_INTSTS2] << 8) |
+        ((uint32_t)r[XPOWERS_AXP2101_INTSTS3] << 16);
+    uint32_t enabled = r[XPOWERS_AXP2101_INTEN1] | ((uint32_t)r[XPOWERS_AXP2101_INTEN2] << 8) |
+        ((uint32_t)r[XPOWERS_AXP2101_INTEN3] << 16);
+    return status & enabled;
+}
+
+//Open drain, low while an enabled status bit is set
+static void update_int(void)
+{
+    if (pending() != 0) sim_gpio_drive(BOARD_PMU_INT, 0);
+    else sim_gpio_release(BOARD_PMU_INT);
+}
+
+static void update_ldos(uint8_t previous)
+{
+    uint8_t now = sim_axp2101.regs[XPOWERS_AXP2101_LDO_ONOFF_CTRL0];
+    uint8_t changed = previous ^ now;
+    uint8_t bit;
+
+    for (bit = 0; bit < 8; ++bit)
+    {
+        if (changed & (1U << bit)) ldo_switches[bit]++;
+    }
+    if (changed & AXP2101_LDO_ALDO3) sim_ft6336_power((now & AXP2101_LDO_ALDO3) != 0);
+    if (changed & AXP2101_LDO_BLDO2) sim_drv2605_power((now & AXP2101_LDO_BLDO2) != 0);
+}
+
+static void axp_write(sim_i2c_model_t *model, uint8_t reg, uint8_t value)
+{
+    uint8_t previous = model->regs[reg];
+    switch (reg)
+    {
+        case XPOWERS_AXP2101_STATUS1:
+        case XPOWERS_AXP2101_STATUS2:
+        case XPOWERS_AXP2101_IC_TYPE:
+            break;
+        case XPOWERS_AXP2101_INTSTS1:
+        case XPOWERS_AXP2101_INTSTS2:
+        case XPOWERS_AXP2101_INTSTS3:
+            model->regs[reg] &= ~value;
+            break;
+        default:
+            model->regs[reg] = value;
+            break;
+    }
+    if (reg == XPOWERS_AXP2101_LDO_ONOFF_CTRL0) update_ldos(previous);
+    update_int();
+}
+
+static void axp_changed(sim_i2c_model_t *model, uint8_t reg)
+{
+    update_int();
+}
+
+static const sim_i2c_ops_t ops = {
+    .write = axp_write,
+    .changed = axp_changed
+};
+
+sim_i2c_model_t sim_axp2101 = {
+    .name = "axp2101",
+    .address = AXP2101_SLAVE_ADDRESS,
+    .ops = &ops,
+    .regs = {
+        [XPOWERS_AXP2101_IC_TYPE] = XPOWERS_AXP2101_CHIP_ID,
+        [XPOWERS_AXP2101_LDO_ONOFF_CTRL0] = AXP2101_LDO_ALDO1 | AXP2101_LDO_ALDO2 | AXP2101_LDO_ALDO3,
+        [XPOWERS_AXP2101_ADC_DATA_RELUST0] = 3900 >> 8,
+        [XPOWERS_AXP2101_ADC_DATA_RELUST1] = 3900 & 0xFF,
+        [XPOWERS_AXP2101_ADC_DATA_RELUST6] = 3850 >> 8,
+        [XPOWERS_AXP2101_ADC_DATA_RELUST7] = 3850 & 0xFF,
+        [XPOWERS_AXP2101_ADC_DATA_RELUST8] = 7074 >> 8,     //32.0 degC
+        [XPOWERS_AXP2101_ADC_DATA_RELUST9] = 7074 & 0xFF,
+        [XPOWERS_AXP2101_BAT_PERCENT_DATA] = 80
+    }
+};
+
+void sim_axp2101_raise(uint32_t irq)
+{
+    sim_axp2101.regs[XPOWERS_AXP2101_INTSTS1] |= irq & 0xFF;
+    sim_axp2101.regs[XPOWERS_AXP2101_INTSTS2] |= (irq >> 8) & 0xFF;
+    sim_axp2101.regs[XPOWERS_AXP2101_INTSTS3] |= (irq >> 16) & 0xFF;
+    update_int();
+}
+
+void sim_axp2101_set_vbus(bool present)
+{
+    if (present) sim_axp2101.regs[XPOWERS_AXP2101_STATUS1] |= XPOWERS_AXP2101_STATUS1_VBUS_GOOD;
+    else sim_axp2101.regs[XPOWERS_AXP2101_STATUS1] &= ~XPOWERS_AXP2101_STATUS1_VBUS_GOOD;
+    sim_axp2101_raise(present ? AXP2101_IRQ_VBUS_INSERT : AXP2101_IRQ_VBUS_REMOVE);
+}
+
+void sim_axp2101_set_adc(uint16_t battery_mv, uint16_t vbus_mv, uint16_t system_mv, uint16_t temp_raw)
+{
+    uint8_t *r = sim_axp2101.regs;
+    r[XPOWERS_AXP2101_ADC_DATA_RELUST0] = (battery_mv >> 8) & 0x1F;
+    r[XPOWERS_AXP2101_ADC_DATA_RELUST1] = battery_mv & 0xFF;
+    r[XPOWERS_AXP2101_ADC_DATA_RELUST4] = (vbus_mv >> 8) & 0x3F;
+    r[XPOWERS_AXP2101_ADC_DATA_RELUST5] = vbus_mv & 0xFF;
+    r[XPOWERS_AXP2101_ADC_DATA_RELUST6] = (system_mv >> 8) & 0x3F;
+    r[XPOWERS_AXP2101_ADC_DATA_RELUST7] = system_mv & 0xFF;
+    r[XPOWERS_AXP2101_ADC_DATA_RELUST8] = (temp_raw >> 8) & 0x3F;
+    r[XPOWERS_AXP2101_ADC_DATA_RELUST9] = temp_raw & 0xFF;
+}
+
+void sim_axp2101_set_battery_percent(uint8_t percent)
+{
+    sim_axp2101.regs[XPOWERS_AXP2101_BAT_PERCENT_DATA] = percent;
+}
+
+uint32_t sim_axp2101_ldo_switches(uint8_t mask)
+{
+    uint32_t count = 0;
+    uint8_t bit;
+    for (bit = 0; bit < 8; ++bit)
+    {
+        if (mask & (1U << bit)) count += ldo_switches[bit];
+    }
+    return count;
+}
+
+void sim_axp2101_attach(void)
+{
+    update_int();
+    sim_i2c_attach(I2C_NUM_1, &sim_axp2101);
+}
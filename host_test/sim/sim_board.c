@@ -0,0 +1,20 @@
+#include "sim_board.h"
+#include "sim_kernel.h"
+#include "i2c_controller.h"
+#include "power_profile.h"
+
+void sim_board_attach_models(void)
+{
+    sim_axp2101_attach();
+    sim_ft6336_attach();
+    sim_drv2605_attach();
+}
+
+//Same order as app_main up to the I2C devices
+void sim_board_init(peripheral_handles_t *peripherals)
+{
+    sim_init();
+    sim_board_attach_models();
+    ESP_ERROR_CHECK(power_profile_init());
+    i2c_controller_init(peripherals);
+}
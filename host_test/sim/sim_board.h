@@ -0,0 +1,73 @@
+#pragma once
+
+//Register models of the T-Watch S3 I2C devices and the glue that boots the firmware against them
+#include <stdint.h>
+#include <stdbool.h>
+#include "app_main.h"
+#include "sim_i2c.h"
+#include "sim_gpio.h"
+
+#define SIM_FT6336_BOOT_US (20000)          //Hibernate wake or power-on to the first acknowledged transaction
+#define SIM_FT6336_INT_PULSE_US (100)       //Trigger mode INT pulse per report
+#define SIM_FT6336_WAKE_PULSE_MIN_US (1000) //Shorter host pulses on INT are ignored in hibernate
+#define SIM_DRV2605_LOG_MAX (64)
+
+//AXP2101 at 0x34 on the system bus, INT on BOARD_PMU_INT is low while an enabled status bit is set
+extern sim_i2c_model_t sim_axp2101;
+//Sets INTSTS bits (AXP2101_IRQ_* layout) at the current time
+void sim_axp2101_raise(uint32_t irq);
+//STATUS1 VBUS_GOOD, raising INSERT or REMOVE
+void sim_axp2101_set_vbus(bool present);
+void sim_axp2101_set_adc(uint16_t battery_mv, uint16_t vbus_mv, uint16_t system_mv, uint16_t temp_raw);
+void sim_axp2101_set_battery_percent(uint8_t percent);
+//On/off switches of the LDOs in mask (LDO_ONOFF_CTRL0 bits) seen on the wire
+uint32_t sim_axp2101_ldo_switches(uint8_t mask);
+
+//FT6336 at 0x38 on the touch bus
+extern sim_i2c_model_t sim_ft6336;
+typedef enum
+{
+    SimTouchDown,
+    SimTouchUp,
+    SimTouchContact
+} sim_touch_event_t;
+//One report with a single point, INT pulses (trigger mode) or stays low until lifted (polling mode)
+void sim_ft6336_report(sim_touch_event_t event, uint16_t x, uint16_t y);
+//Two-point report
+void sim_ft6336_report2(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
+void sim_ft6336_set_gesture(uint8_t gesture_id);
+bool sim_ft6336_hibernating(void);
+//Times the chip left hibernate or power-off and reloaded its defaults
+uint32_t sim_ft6336_resets(void);
+uint32_t sim_ft6336_reports(void);
+extern const uint8_t sim_ft6336_defaults[SIM_I2C_REGS];
+
+//DRV2605L at 0x5A on the system bus, powered from BLDO2
+extern sim_i2c_model_t sim_drv2605;
+typedef struct
+{
+    uint64_t start_us;
+    uint64_t end_us;            //Expected end, or when GO was cleared
+    uint8_t sequence[8];
+    uint8_t library;
+    bool stopped;               //GO cleared by the host before the end
+} sim_drv2605_play_t;
+//Duration the model gives a sequence, waits count (value & 0x7F) x 10 ms
+uint32_t sim_drv2605_sequence_ms(const uint8_t sequence[8]);
+uint32_t sim_drv2605_effect_ms(uint8_t effect);
+bool sim_drv2605_powered(void);
+uint32_t sim_drv2605_power_ups(void);
+uint8_t sim_drv2605_play_count(void);
+const sim_drv2605_play_t *sim_drv2605_play(uint8_t index);
+
+//Wiring between the models, the AXP2101 model switches the supplies of the other two
+void sim_axp2101_attach(void);
+void sim_ft6336_attach(void);
+void sim_drv2605_attach(void);
+void sim_ft6336_power(bool on);
+void sim_drv2605_power(bool on);
+
+//Starts the simulated kernel, attaches the models and runs the firmware's I2C bring-up
+void sim_board_init(peripheral_handles_t *peripherals);
+//Called by sim_board_init, models only, for tests that bring up the drivers themselves
+void sim_board_attach_models(void);
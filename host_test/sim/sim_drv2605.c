@@ -0,0 +1,153 @@
+#include "sim_board.h"
+#include "drv2605.h"
+#include <string.h>
+
+#define STATUS_DEVICE_ID (DRV2605L_CHIP_ID << 5)
+#define MODE_STANDBY (1U << 6)
+#define EFFECT_DEFAULT_MS (50)
+
+static bool powered;
+static uint32_t power_ups;
+static sim_event_t end_event;
+static sim_drv2605_play_t plays[SIM_DRV2605_LOG_MAX];
+static uint8_t play_count;
+
+//Rough durations of the ROM library effects the firmware uses, the rest get EFFECT_DEFAULT_MS
+static const struct
+{
+    uint8_t effect;
+    uint16_t ms;
+} effect_times[] = {
+    { 1, 60 },      //Strong click
+    { 10, 150 },    //Double click
+    { 14, 300 },    //Strong buzz
+    { 24, 30 },     //Sharp tick
+    { 47, 240 },    //Buzz
+    { 52, 400 }     //Pulsing strong
+};
+
+uint32_t sim_drv2605_effect_ms(uint8_t effect)
+{
+    uint8_t i;
+    for (i = 0; i < sizeof(effect_times) / sizeof(effect_times[0]); ++i)
+    {
+        if (effect_times[i].effect == effect) return effect_times[i].ms;
+    }
+    return EFFECT_DEFAULT_MS;
+}
+
+uint32_t sim_drv2605_sequence_ms(const uint8_t sequence[8])
+{
+    uint32_t ms = 0;
+    uint8_t i;
+    for (i = 0; i < DRV2605_WAVESEQ_COUNT && sequence[i] != DRV2605_WAVESEQ_END; ++i)
+    {
+        if (sequence[i] & DRV2605_WAVESEQ_WAIT) ms += (sequence[i] & 0x7FU) * 10;
+        else ms += sim_drv2605_effect_ms(sequence[i]);
+    }
+    return ms;
+}
+
+static void reset_registers(void)
+{
+    memset(sim_drv2605.regs, 0, sizeof(sim_drv2605.regs));
+    sim_drv2605.regs[DRV2605_REG_STATUS] = STATUS_DEVICE_ID;
+    sim_drv2605.regs[DRV2605_REG_MODE] = MODE_STANDBY;
+    sim_drv2605.regs[DRV2605_REG_WAVESEQ1] = 1;
+}
+
+static void play_end(void *arg)
+{
+    sim_drv2605.regs[DRV2605_REG_GO] = 0;
+}
+
+static void start(void)
+{
+    const uint8_t *seq = &sim_drv2605.regs[DRV2605_REG_WAVESEQ1];
+    sim_drv2605_play_t *play = &plays[play_count % SIM_DRV2605_LOG_MAX];
+
+    play->start_us = sim_now_us();
+    play->end_us = play->start_us + (uint64_t)sim_drv2605_sequence_ms(seq) * 1000;
+    memcpy(play->sequence, seq, sizeof(play->sequence));
+    play->library = sim_drv2605.regs[DRV2605_REG_LIBRARY];
+    play->stopped = false;
+    play_count++;
+    sim_drv2605.regs[DRV2605_REG_GO] = 1;
+    sim_event_schedule(&end_event, play->end_us, play_end, NULL);
+}
+
+static void drv_write(sim_i2c_model_t *model, uint8_t reg, uint8_t value)
+{
+    if (reg == DRV2605_REG_STATUS) return;
+    if (reg != DRV2605_REG_GO)
+    {
+        model->regs[reg] = value;
+        return;
+    }
+
+    if ((value & 1U) != 0)
+    {
+        //Ignored in standby and while a sequence plays
+        if ((model->regs[DRV2605_REG_MODE] & MODE_STANDBY) == 0 && !end_event.queued) start();
+    }
+    else if (end_event.queued)
+    {
+        sim_event_cancel(&end_event);
+        plays[(play_count - 1) % SIM_DRV2605_LOG_MAX].end_us = sim_now_us();
+        plays[(play_count - 1) % SIM_DRV2605_LOG_MAX].stopped = true;
+        model->regs[DRV2605_REG_GO] = 0;
+    }
+}
+
+static const sim_i2c_ops_t ops = {
+    .write = drv_write
+};
+
+sim_i2c_model_t sim_drv2605 = {
+    .name = "drv2605",
+    .address = DRV2605_SLAVE_ADDRESS,
+    .ops = &ops,
+    .absent = true
+};
+
+void sim_drv2605_power(bool on)
+{
+    powered = on;
+    sim_drv2605.absent = !on;
+    if (on)
+    {
+        power_ups++;
+        reset_registers();
+    }
+    else if (end_event.queued)
+    {
+        sim_event_cancel(&end_event);
+        plays[(play_count - 1) % SIM_DRV2605_LOG_MAX].end_us = sim_now_us();
+        plays[(play_count - 1) % SIM_DRV2605_LOG_MAX].stopped = true;
+    }
+}
+
+bool sim_drv2605_powered(void)
+{
+    return powered;
+}
+
+uint32_t sim_drv2605_power_ups(void)
+{
+    return power_ups;
+}
+
+uint8_t sim_drv2605_play_count(void)
+{
+    return play_count;
+}
+
+const sim_drv2605_play_t *sim_drv2605_play(uint8_t index)
+{
+    return &plays[index % SIM_DRV2605_LOG_MAX];
+}
+
+void sim_drv2605_attach(void)
+{
+    sim_i2c_attach(I2C_NUM_1, &sim_drv2605);
+}
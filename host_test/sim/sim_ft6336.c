@@ -0,0 +1,194 @@
+#include "sim_board.h"
+#include "ft5436.h"
+#include "t_watch_s3.h"
+#include <string.h>
+
+#define DEFAULT_THRESHOLD (0x28)
+#define DEFAULT_RATE_ACTIVE (0x0C)
+
+//Power-on values, chosen so that every register the firmware configures differs from what it writes
+const uint8_t sim_ft6336_defaults[SIM_I2C_REGS] = {
+    [FT6X36_REG_NUM_TOUCHES] = 0x00,
+    [FT6X36_REG_THRESHHOLD] = DEFAULT_THRESHOLD,
+    [FT6X36_REG_CTRL] = FT6X36_CTRL_AUTO_MONITOR,
+    [FT6X36_REG_TIME_ENTER_MONITOR] = 10,
+    [FT6X36_REG_TOUCHRATE_ACTIVE] = DEFAULT_RATE_ACTIVE,
+    [FT6X36_REG_TOUCHRATE_MONITOR] = 0x28,
+    [FT6X36_REG_RADIAN_VALUE] = 10,
+    [FT6X36_REG_OFFSET_LEFT_RIGHT] = 25,
+    [FT6X36_REG_OFFSET_UP_DOWN] = 25,
+    [FT6X36_REG_DISTANCE_LEFT_RIGHT] = 25,
+    [FT6X36_REG_DISTANCE_UP_DOWN] = 25,
+    [FT6X36_REG_DISTANCE_ZOOM] = 50,
+    [FT6X36_REG_LIB_VERSION_H] = 0x30,
+    [FT6X36_REG_LIB_VERSION_L] = 0x03,
+    [FT6X36_REG_CHIPID] = FT6336_CHIPID,
+    [FT6X36_REG_INTERRUPT_MODE] = FT6X36_INT_MODE_POLLING,
+    [FT6X36_REG_POWER_MODE] = FT6X36_PMODE_ACTIVE,
+    [FT6X36_REG_FIRMWARE_VERSION] = 0x10,
+    [FT6X36_REG_PANEL_ID] = FT6X36_VENDID
+};
+
+static bool hibernating;
+static bool powered = true;
+static uint64_t host_low_since_us;
+static uint32_t resets;
+static uint32_t reports;
+static sim_event_t pulse_event;
+static sim_event_t boot_event;
+
+static bool read_only(uint8_t reg)
+{
+    return (reg >= FT6X36_REG_GESTURE_ID && reg <= FT6X36_REG_P2_MISC) || reg == FT6X36_REG_LIB_VERSION_H ||
+        reg == FT6X36_REG_LIB_VERSION_L || reg == FT6X36_REG_CHIPID || reg == FT6X36_REG_FIRMWARE_VERSION ||
+        reg == FT6X36_REG_PANEL_ID;
+}
+
+static void ft_write(sim_i2c_model_t *model, uint8_t reg, uint8_t value)
+{
+    if (read_only(reg)) return;
+    model->regs[reg] = value;
+    if (reg == FT6X36_REG_POWER_MODE && value == FT6X36_PMODE_HIBERNATE)
+    {
+        //Only a reset or a low pulse on INT brings it back
+        hibernating = true;
+        model->absent = true;
+        sim_event_cancel(&pulse_event);
+        sim_gpio_release(BOARD_TOUCH_INT);
+    }
+}
+
+static const sim_i2c_ops_t ops = {
+    .write = ft_write
+};
+
+sim_i2c_model_t sim_ft6336 = {
+    .name = "ft6336",
+    .address = FT6X36_ADDR,
+    .ops = &ops
+};
+
+static void boot_done(void *arg)
+{
+    memcpy(sim_ft6336.regs, sim_ft6336_defaults, sizeof(sim_ft6336.regs));
+    sim_ft6336.absent = false;
+    hibernating = false;
+    resets++;
+}
+
+static void start_boot(void)
+{
+    sim_ft6336.absent = true;
+    sim_event_schedule(&boot_event, sim_now_us() + SIM_FT6336_BOOT_US, boot_done, NULL);
+}
+
+//In hibernate the chip only listens for the host pulling INT low
+static void int_watch(gpio_num_t pin, int level, void *ctx)
+{
+    if (!hibernating || !powered || boot_event.queued) return;
+    if (level == 0)
+    {
+        host_low_since_us = sim_now_us();
+    }
+    else if (host_low_since_us != 0)
+    {
+        if (sim_now_us() - host_low_since_us >= SIM_FT6336_WAKE_PULSE_MIN_US) start_boot();
+        host_low_since_us = 0;
+    }
+}
+
+void sim_ft6336_power(bool on)
+{
+    powered = on;
+    hibernating = false;
+    host_low_since_us = 0;
+    sim_event_cancel(&pulse_event);
+    sim_gpio_release(BOARD_TOUCH_INT);
+    if (on)
+    {
+        start_boot();
+    }
+    else
+    {
+        sim_event_cancel(&boot_event);
+        sim_ft6336.absent = true;
+    }
+}
+
+static void pulse_end(void *arg)
+{
+    sim_gpio_release(BOARD_TOUCH_INT);
+}
+
+static void set_point(uint8_t index, sim_touch_event_t event, uint16_t x, uint16_t y)
+{
+    uint8_t *p = &sim_ft6336.regs[FT6X36_REG_P1_XH + index * (FT6X36_REG_P2_XH - FT6X36_REG_P1_XH)];
+    p[0] = (uint8_t)(event << 6) | ((x >> 8) & FT6X36_MSB_MASK);
+    p[1] = x & 0xFF;
+    p[2] = (uint8_t)(index << 4) | ((y >> 8) & FT6X36_MSB_MASK);
+    p[3] = y & 0xFF;
+    p[4] = 0x20;
+    p[5] = 0x10;
+}
+
+static void signal_report(bool touching)
+{
+    reports++;
+    if (sim_ft6336.regs[FT6X36_REG_INTERRUPT_MODE] == FT6X36_INT_MODE_TRIGGER)
+    {
+        sim_gpio_drive(BOARD_TOUCH_INT, 0);
+        sim_event_schedule(&pulse_event, sim_now_us() + SIM_FT6336_INT_PULSE_US, pulse_end, NULL);
+    }
+    else if (touching)
+    {
+        sim_gpio_drive(BOARD_TOUCH_INT, 0);
+    }
+    else
+    {
+        sim_gpio_release(BOARD_TOUCH_INT);
+    }
+}
+
+void sim_ft6336_report(sim_touch_event_t event, uint16_t x, uint16_t y)
+{
+    if (sim_ft6336.absent) return;
+    sim_ft6336.regs[FT6X36_REG_NUM_TOUCHES] = event == SimTouchUp ? 0 : 1;
+    set_point(0, event, x, y);
+    signal_report(event != SimTouchUp);
+}
+
+void sim_ft6336_report2(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+    if (sim_ft6336.absent) return;
+    sim_ft6336.regs[FT6X36_REG_NUM_TOUCHES] = 2;
+    set_point(0, SimTouchContact, x0, y0);
+    set_point(1, SimTouchContact, x1, y1);
+    signal_report(true);
+}
+
+void sim_ft6336_set_gesture(uint8_t gesture_id)
+{
+    sim_ft6336.regs[FT6X36_REG_GESTURE_ID] = gesture_id;
+}
+
+bool sim_ft6336_hibernating(void)
+{
+    return hibernating;
+}
+
+uint32_t sim_ft6336_resets(void)
+{
+    return resets;
+}
+
+uint32_t sim_ft6336_reports(void)
+{
+    return reports;
+}
+
+void sim_ft6336_attach(void)
+{
+    memcpy(sim_ft6336.regs, sim_ft6336_defaults, sizeof(sim_ft6336.regs));
+    sim_gpio_watch(BOARD_TOUCH_INT, int_watch, NULL);
+    sim_i2c_attach(I2C_NUM_0, &sim_ft6336);
+}
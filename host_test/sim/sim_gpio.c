@@ -0,0 +1,294 @@
+#include "sim_gpio.h"
+#include "sim_kernel.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WATCH_MAX (2)
+#define STORM_LIMIT (1000)  //Handler runs at one instant before a level interrupt that is never masked counts as a hang
+
+typedef struct
+{
+    gpio_mode_t mode;
+    bool pull_up;
+    bool pull_down;
+    uint8_t out_level;
+    bool driven;
+    uint8_t driven_level;
+    gpio_int_type_t intr_type;
+    bool intr_enabled;
+    bool wakeup;
+    bool edge_pending;          //The status bit latches an edge while the interrupt is masked
+    gpio_isr_t isr;
+    void *isr_arg;
+    uint32_t isr_count;
+    uint64_t storm_us;
+    uint32_t storm_count;
+    sim_event_t event;
+    sim_gpio_watch_cb_t watch[WATCH_MAX];
+    void *watch_ctx[WATCH_MAX];
+    uint8_t level;              //Last evaluated wire level
+    bool seen;                  //level is valid, the first evaluation is not an edge
+} sim_pin_t;
+
+static sim_pin_t pins[GPIO_PIN_COUNT];
+static bool isr_service;
+
+static bool valid(gpio_num_t pin)
+{
+    return pin >= 0 && pin < GPIO_PIN_COUNT;
+}
+
+static bool drives_output(const sim_pin_t *p)
+{
+    switch (p->mode)
+    {
+        case GPIO_MODE_OUTPUT:
+        case GPIO_MODE_INPUT_OUTPUT:
+            return true;
+        case GPIO_MODE_OUTPUT_OD:
+        case GPIO_MODE_INPUT_OUTPUT_OD:
+            return p->out_level == 0;
+        default:
+            return false;
+    }
+}
+
+//Lines without a pull-down idle high, every interrupt line on the board has a pull-up somewhere
+static uint8_t wire_level(const sim_pin_t *p)
+{
+    if (p->mode == GPIO_MODE_OUTPUT || p->mode == GPIO_MODE_INPUT_OUTPUT) return p->out_level;
+    if (drives_output(p)) return 0;
+    if (p->driven) return p->driven_level;
+    return p->pull_down && !p->pull_up ? 0 : 1;
+}
+
+static bool level_active(const sim_pin_t *p)
+{
+    return (p->intr_type == GPIO_INTR_LOW_LEVEL && p->level == 0) || (p->intr_type == GPIO_INTR_HIGH_LEVEL && p->level == 1);
+}
+
+static void dispatch(void *arg);
+
+static void schedule_dispatch(gpio_num_t pin)
+{
+    sim_pin_t *p = &pins[pin];
+    if (!p->intr_enabled || p->isr == NULL || !isr_service) return;
+    if (!p->edge_pending && !level_active(p)) return;
+    if (!p->event.queued) sim_event_schedule(&p->event, sim_now_us(), dispatch, (void *)(intptr_t)pin);
+}
+
+static void dispatch(void *arg)
+{
+    gpio_num_t pin = (gpio_num_t)(intptr_t)arg;
+    sim_pin_t *p = &pins[pin];
+
+    if (!p->intr_enabled || p->isr == NULL) return;
+    if (!p->edge_pending && !level_active(p)) return;
+    p->edge_pending = false;
+
+    if (p->storm_us != sim_now_us())
+    {
+        p->storm_us = sim_now_us();
+        p->storm_count = 0;
+    }
+    if (++p->storm_count > STORM_LIMIT)
+    {
+        fprintf(stderr, "sim: interrupt storm on GPIO%d, the level interrupt is never masked\n", pin);
+        abort();
+    }
+    p->isr_count++;
+    p->isr(p->isr_arg);
+    schedule_dispatch(pin);
+}
+
+//Re-evaluates the wire after any change of the pin or of what drives it
+static void update(gpio_num_t pin)
+{
+    sim_pin_t *p = &pins[pin];
+    uint8_t level = wire_level(p);
+    uint8_t i;
+
+    if (!p->seen)
+    {
+        p->seen = true;
+        p->level = level;
+    }
+    if (level != p->level)
+    {
+        p->level = level;
+        if ((p->intr_type == GPIO_INTR_NEGEDGE && level == 0) || (p->intr_type == GPIO_INTR_POSEDGE && level == 1) ||
+            p->intr_type == GPIO_INTR_ANYEDGE)
+        {
+            p->edge_pending = true;
+        }
+        for (i = 0; i < WATCH_MAX; ++i)
+        {
+            if (p->watch[i] != NULL) p->watch[i](pin, level, p->watch_ctx[i]);
+        }
+    }
+    schedule_dispatch(pin);
+}
+
+void sim_gpio_drive(gpio_num_t pin, int level)
+{
+    pins[pin].driven = true;
+    pins[pin].driven_level = level != 0;
+    update(pin);
+}
+
+void sim_gpio_release(gpio_num_t pin)
+{
+    pins[pin].driven = false;
+    update(pin);
+}
+
+int sim_gpio_get(gpio_num_t pin)
+{
+    return wire_level(&pins[pin]);
+}
+
+bool sim_gpio_is_output(gpio_num_t pin)
+{
+    return drives_output(&pins[pin]);
+}
+
+bool sim_gpio_intr_enabled(gpio_num_t pin)
+{
+    return pins[pin].intr_enabled;
+}
+
+gpio_int_type_t sim_gpio_intr_type(gpio_num_t pin)
+{
+    return pins[pin].intr_type;
+}
+
+bool sim_gpio_wakeup_enabled(gpio_num_t pin)
+{
+    return pins[pin].wakeup;
+}
+
+uint32_t sim_gpio_isr_count(gpio_num_t pin)
+{
+    return pins[pin].isr_count;
+}
+
+void sim_gpio_watch(gpio_num_t pin, sim_gpio_watch_cb_t cb, void *ctx)
+{
+    uint8_t i;
+    for (i = 0; i < WATCH_MAX; ++i)
+    {
+        if (pins[pin].watch[i] != NULL) continue;
+        pins[pin].watch[i] = cb;
+        pins[pin].watch_ctx[i] = ctx;
+        return;
+    }
+    abort();
+}
+
+//Same order as the IDF driver: pulls, direction, then the interrupt type, which also enables or masks the interrupt
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    gpio_num_t pin;
+    for (pin = 0; pin < GPIO_PIN_COUNT; ++pin)
+    {
+        if ((config->pin_bit_mask & (1ULL << pin)) == 0) continue;
+        sim_pin_t *p = &pins[pin];
+        p->pull_up = config->pull_up_en == GPIO_PULLUP_ENABLE;
+        p->pull_down = config->pull_down_en == GPIO_PULLDOWN_ENABLE;
+        p->mode = config->mode;
+        p->intr_type = config->intr_type;
+        p->intr_enabled = config->intr_type != GPIO_INTR_DISABLE;
+        p->edge_pending = false;
+        update(pin);
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (!valid(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pins[gpio_num].out_level = level != 0;
+    update(gpio_num);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (!valid(gpio_num)) return 0;
+    return sim_gpio_get(gpio_num);
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    if (!valid(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pins[gpio_num].mode = mode;
+    update(gpio_num);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (!valid(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pins[gpio_num].intr_type = intr_type;
+    update(gpio_num);
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num)
+{
+    if (!valid(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pins[gpio_num].intr_enabled = true;
+    schedule_dispatch(gpio_num);
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num)
+{
+    if (!valid(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pins[gpio_num].intr_enabled = false;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    if (isr_service) return ESP_ERR_INVALID_STATE;
+    isr_service = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    if (!isr_service) return ESP_ERR_INVALID_STATE;
+    if (!valid(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pins[gpio_num].isr = isr_handler;
+    pins[gpio_num].isr_arg = args;
+    schedule_dispatch(gpio_num);
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    if (!valid(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pins[gpio_num].isr = NULL;
+    return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (!valid(gpio_num)) return ESP_ERR_INVALID_ARG;
+    if (intr_type != GPIO_INTR_LOW_LEVEL && intr_type != GPIO_INTR_HIGH_LEVEL) return ESP_ERR_INVALID_ARG;
+    pins[gpio_num].wakeup = true;
+    return gpio_set_intr_type(gpio_num, intr_type);
+}
+
+esp_err_t gpio_wakeup_disable(gpio_num_t gpio_num)
+{
+    if (!valid(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pins[gpio_num].wakeup = false;
+    return ESP_OK;
+}
+
+esp_err_t gpio_sleep_sel_dis(gpio_num_t gpio_num)
+{
+    return valid(gpio_num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/gpio.h"
+
+//Called from whatever context changed the line, with the new level
+typedef void (*sim_gpio_watch_cb_t)(gpio_num_t pin, int level, void *ctx);
+
+//A device pulls the line to level, until released the line follows it unless the firmware drives it as an output
+void sim_gpio_drive(gpio_num_t pin, int level);
+void sim_gpio_release(gpio_num_t pin);
+//Level on the wire, what both the firmware and the devices see
+int sim_gpio_get(gpio_num_t pin);
+bool sim_gpio_is_output(gpio_num_t pin);
+bool sim_gpio_intr_enabled(gpio_num_t pin);
+gpio_int_type_t sim_gpio_intr_type(gpio_num_t pin);
+bool sim_gpio_wakeup_enabled(gpio_num_t pin);
+//Handler invocations since start
+uint32_t sim_gpio_isr_count(gpio_num_t pin);
+void sim_gpio_watch(gpio_num_t pin, sim_gpio_watch_cb_t cb, void *ctx);
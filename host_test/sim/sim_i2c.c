@@ -0,0 +1,250 @@
+#include "sim_i2c.h"
+#include "freertos/FreeRTOS.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct sim_i2c_bus
+{
+    i2c_port_num_t port;
+    bool created;
+    bool busy;
+    bool sda_held;          //A slave keeps SDA low, every transaction times out until a bus reset
+    sim_i2c_model_t *models;
+    sim_i2c_bus_stats_t stats;
+};
+
+struct sim_i2c_device
+{
+    struct sim_i2c_bus *bus;
+    uint16_t address;
+    uint32_t scl_hz;
+};
+
+static struct sim_i2c_bus buses[I2C_NUM_MAX] = {
+    { .port = I2C_NUM_0 },
+    { .port = I2C_NUM_1 }
+};
+
+void sim_i2c_attach(i2c_port_num_t port, sim_i2c_model_t *model)
+{
+    model->next = buses[port].models;
+    buses[port].models = model;
+}
+
+void sim_i2c_get_bus_stats(i2c_port_num_t port, sim_i2c_bus_stats_t *stats)
+{
+    *stats = buses[port].stats;
+}
+
+void sim_i2c_reset_counters(sim_i2c_model_t *model)
+{
+    model->transactions = 0;
+    model->nacks = 0;
+    model->bytes_written = 0;
+    model->bytes_read = 0;
+    memset(model->reg_writes, 0, sizeof(model->reg_writes));
+    memset(model->reg_reads, 0, sizeof(model->reg_reads));
+}
+
+static void model_write(sim_i2c_model_t *model, uint8_t reg, uint8_t value)
+{
+    model->reg_writes[reg]++;
+    if (model->ops != NULL && model->ops->write != NULL) model->ops->write(model, reg, value);
+    else model->regs[reg] = value;
+}
+
+static uint8_t model_read(sim_i2c_model_t *model, uint8_t reg)
+{
+    model->reg_reads[reg]++;
+    if (model->ops != NULL && model->ops->read != NULL) return model->ops->read(model, reg);
+    return model->regs[reg];
+}
+
+static void script_fire(void *arg)
+{
+    sim_i2c_script_t *script = arg;
+    sim_i2c_model_t *model = script->model;
+    model->regs[script->reg] = script->value;
+    script->used = false;
+    if (model->ops != NULL && model->ops->changed != NULL) model->ops->changed(model, script->reg);
+}
+
+void sim_i2c_script_write(sim_i2c_model_t *model, uint64_t delay_us, uint8_t reg, uint8_t value)
+{
+    uint8_t i;
+    for (i = 0; i < SIM_I2C_SCRIPT_MAX; ++i)
+    {
+        sim_i2c_script_t *script = &model->scripts[i];
+        if (script->used) continue;
+        script->used = true;
+        script->model = model;
+        script->reg = reg;
+        script->value = value;
+        sim_event_schedule(&script->event, sim_now_us() + delay_us, script_fire, script);
+        return;
+    }
+    abort();
+}
+
+uint32_t sim_i2c_transfer_us(uint32_t scl_hz, size_t write_len, size_t read_len)
+{
+    //Address byte per direction, nine clocks per byte, START/STOP worth one clock each
+    uint32_t bits = 2 + (1 + write_len) * 9;
+    if (read_len > 0) bits += 1 + (1 + read_len) * 9;
+    return (uint32_t)(((uint64_t)bits * 1000000 + scl_hz - 1) / scl_hz);
+}
+
+static sim_i2c_model_t *find_model(struct sim_i2c_bus *bus, uint16_t address)
+{
+    sim_i2c_model_t *model;
+    for (model = bus->models; model != NULL; model = model->next)
+    {
+        if (model->address == address) return model;
+    }
+    return NULL;
+}
+
+static void hold_bus(struct sim_i2c_bus *bus)
+{
+    while (bus->busy)
+    {
+        sim_wait_on(bus, SIM_FOREVER);
+    }
+    bus->busy = true;
+}
+
+static void release_bus(struct sim_i2c_bus *bus)
+{
+    bus->busy = false;
+    sim_wake_waiters(bus);
+}
+
+static esp_err_t run_transaction(struct sim_i2c_device *dev, const uint8_t *write_buf, size_t write_len,
+    uint8_t *read_buf, size_t read_len, int timeout_ms)
+{
+    struct sim_i2c_bus *bus = dev->bus;
+    sim_i2c_model_t *model = find_model(bus, dev->address);
+    esp_err_t err = ESP_OK;
+    size_t i;
+
+    hold_bus(bus);
+    bus->stats.transactions++;
+    if (model != NULL && model->hold_sda_next > 0 && !model->absent)
+    {
+        model->hold_sda_next--;
+        bus->sda_held = true;
+    }
+
+    if (bus->sda_held)
+    {
+        //No STOP can be generated, the driver gives up at its deadline
+        uint64_t wait_us = timeout_ms < 0 ? SIM_FOREVER : (uint64_t)timeout_ms * 1000;
+        sim_sleep_us(wait_us);
+        bus->stats.busy_us += wait_us;
+        bus->stats.timeouts++;
+        err = ESP_ERR_TIMEOUT;
+    }
+    else if (model == NULL || model->absent || model->nack_next > 0)
+    {
+        //Address byte only
+        uint32_t us = sim_i2c_transfer_us(dev->scl_hz, 0, 0);
+        sim_sleep_us(us);
+        bus->stats.busy_us += us;
+        bus->stats.nacks++;
+        if (model != NULL)
+        {
+            model->nacks++;
+            if (model->nack_next > 0 && !model->absent) model->nack_next--;
+        }
+        err = ESP_FAIL;
+    }
+    else
+    {
+        uint32_t us = sim_i2c_transfer_us(dev->scl_hz, write_len, read_len) + model->latency_us;
+        sim_sleep_us(us);
+        bus->stats.busy_us += us;
+
+        //Effects land at the STOP, the first written byte sets the register pointer
+        model->transactions++;
+        model->bytes_written += write_len;
+        model->bytes_read += read_len;
+        if (write_len > 0) model->pointer = write_buf[0];
+        for (i = 1; i < write_len; ++i)
+        {
+            model_write(model, model->pointer++, write_buf[i]);
+        }
+        for (i = 0; i < read_len; ++i)
+        {
+            read_buf[i] = model_read(model, model->pointer++);
+        }
+    }
+    release_bus(bus);
+    return err;
+}
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *config, i2c_master_bus_handle_t *ret_bus_handle)
+{
+    if (config->i2c_port >= I2C_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    struct sim_i2c_bus *bus = &buses[config->i2c_port];
+    if (bus->created) return ESP_ERR_INVALID_STATE;
+    bus->created = true;
+    *ret_bus_handle = bus;
+    return ESP_OK;
+}
+
+esp_err_t i2c_del_master_bus(i2c_master_bus_handle_t bus_handle)
+{
+    bus_handle->created = false;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus_handle, const i2c_device_config_t *dev_config,
+    i2c_master_dev_handle_t *ret_handle)
+{
+    struct sim_i2c_device *dev = calloc(1, sizeof(*dev));
+    if (dev == NULL) return ESP_ERR_NO_MEM;
+    dev->bus = bus_handle;
+    dev->address = dev_config->device_address;
+    dev->scl_hz = dev_config->scl_speed_hz;
+    *ret_handle = dev;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t handle)
+{
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer, size_t write_size, int xfer_timeout_ms)
+{
+    return run_transaction(i2c_dev, write_buffer, write_size, NULL, 0, xfer_timeout_ms);
+}
+
+esp_err_t i2c_master_receive(i2c_master_dev_handle_t i2c_dev, uint8_t *read_buffer, size_t read_size, int xfer_timeout_ms)
+{
+    return run_transaction(i2c_dev, NULL, 0, read_buffer, read_size, xfer_timeout_ms);
+}
+
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer, size_t write_size,
+    uint8_t *read_buffer, size_t read_size, int xfer_timeout_ms)
+{
+    return run_transaction(i2c_dev, write_buffer, write_size, read_buffer, read_size, xfer_timeout_ms);
+}
+
+esp_err_t i2c_master_probe(i2c_master_bus_handle_t bus_handle, uint16_t address, int xfer_timeout_ms)
+{
+    struct sim_i2c_device dev = { .bus = bus_handle, .address = address, .scl_hz = 100000 };
+    return run_transaction(&dev, NULL, 0, NULL, 0, xfer_timeout_ms) == ESP_OK ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+//The clear-bus pulses let a slave finish the byte it was sending and release SDA
+esp_err_t i2c_master_bus_reset(i2c_master_bus_handle_t bus_handle)
+{
+    hold_bus(bus_handle);
+    sim_sleep_us(SIM_I2C_BUS_RESET_US);
+    bus_handle->sda_held = false;
+    bus_handle->stats.resets++;
+    release_bus(bus_handle);
+    return ESP_OK;
+}
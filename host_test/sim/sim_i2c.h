@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/i2c_master.h"
+#include "sim_kernel.h"
+
+#define SIM_I2C_REGS (256)
+#define SIM_I2C_SCRIPT_MAX (32)
+#define SIM_I2C_BUS_RESET_US (100)  //Nine SCL pulses and a STOP at 100 kHz
+
+typedef struct sim_i2c_model sim_i2c_model_t;
+
+//Register level behaviour of a slave, NULL hooks fall back to a plain auto-incrementing register file
+typedef struct
+{
+    uint8_t (*read)(sim_i2c_model_t *model, uint8_t reg);
+    void (*write)(sim_i2c_model_t *model, uint8_t reg, uint8_t value);
+    //A register changed by a script, models derive their outputs (INT lines) from it
+    void (*changed)(sim_i2c_model_t *model, uint8_t reg);
+} sim_i2c_ops_t;
+
+typedef struct
+{
+    sim_event_t event;
+    sim_i2c_model_t *model;
+    uint8_t reg;
+    uint8_t value;
+    bool used;
+} sim_i2c_script_t;
+
+struct sim_i2c_model
+{
+    const char *name;
+    uint16_t address;
+    uint8_t regs[SIM_I2C_REGS];
+    const sim_i2c_ops_t *ops;
+    void *ctx;
+
+    //Fault injection, set by tests at any time
+    uint32_t latency_us;            //Clock stretching on every transaction
+    uint16_t nack_next;             //The next n transactions are not acknowledged
+    uint16_t hold_sda_next;         //The next n transactions leave SDA low until a bus reset
+    bool absent;                    //Unpowered, hibernating or booting: nothing acknowledges
+
+    //Traffic seen by the model
+    uint32_t transactions;          //Acknowledged ones
+    uint32_t nacks;
+    uint32_t bytes_written;         //Data bytes, the register pointer included
+    uint32_t bytes_read;
+    uint16_t reg_writes[SIM_I2C_REGS];
+    uint16_t reg_reads[SIM_I2C_REGS];
+
+    sim_i2c_script_t scripts[SIM_I2C_SCRIPT_MAX];
+    struct sim_i2c_model *next;
+    uint8_t pointer;
+};
+
+typedef struct
+{
+    uint32_t transactions;          //Including failed ones
+    uint32_t timeouts;
+    uint32_t nacks;
+    uint32_t resets;
+    uint64_t busy_us;               //Time SCL was clocking or stretched
+} sim_i2c_bus_stats_t;
+
+//Attach before i2c_new_master_bus or after, the model answers at its address on that port
+void sim_i2c_attach(i2c_port_num_t port, sim_i2c_model_t *model);
+void sim_i2c_get_bus_stats(i2c_port_num_t port, sim_i2c_bus_stats_t *stats);
+void sim_i2c_reset_counters(sim_i2c_model_t *model);
+//Changes a register behind the driver's back, as the device itself would at that time
+void sim_i2c_script_write(sim_i2c_model_t *model, uint64_t delay_us, uint8_t reg, uint8_t value);
+//Duration of a transaction with that many bytes after the address, including the START/STOP and ACK bits
+uint32_t sim_i2c_transfer_us(uint32_t scl_hz, size_t write_len, size_t read_len);
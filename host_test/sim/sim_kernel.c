@@ -0,0 +1,634 @@
+#include "sim_kernel.h"
+#include "freertos/FreeRTOS.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_NOTIFY_ENTRIES (configTASK_NOTIFICATION_ARRAY_ENTRIES)
+
+typedef enum
+{
+    TaskReady,
+    TaskRunning,
+    TaskBlocked,
+    TaskDeleted
+} task_state_t;
+
+struct sim_task
+{
+    pthread_t thread;
+    pthread_cond_t cond;
+    char name[configMAX_TASK_NAME_LEN];
+    UBaseType_t priority;
+    UBaseType_t number;
+    task_state_t state;
+    uint64_t ready_seq;             //FIFO order among ready tasks of one priority
+    const void *wait_obj;
+    uint64_t wake_us;
+    bool timed_out;
+    TaskFunction_t fn;
+    void *arg;
+    uint32_t notify_value[SIM_NOTIFY_ENTRIES];
+    bool notify_pending[SIM_NOTIFY_ENTRIES];
+    uint64_t run_us;
+    struct sim_task *next;
+};
+
+struct sim_queue
+{
+    uint8_t *items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+};
+
+//The running task's thread holds this lock, it is only released inside pthread_cond_wait
+static pthread_mutex_t big_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct sim_task *tasks;
+static struct sim_task *current;
+static UBaseType_t task_count;
+static uint64_t now_us = SIM_START_US;
+static uint64_t idle_us;
+static uint64_t ready_seq;
+static uint32_t switches;
+static sim_event_t *events;
+static bool in_isr;
+static uint64_t run_since_us;
+
+static void make_ready(struct sim_task *task)
+{
+    task->state = TaskReady;
+    task->ready_seq = ready_seq++;
+    task->wait_obj = NULL;
+    task->wake_us = SIM_FOREVER;
+}
+
+static void run_due_events(void)
+{
+    bool nested = in_isr;
+    in_isr = true;
+    while (events != NULL && events->at_us <= now_us)
+    {
+        sim_event_t *event = events;
+        events = event->next;
+        event->queued = false;
+        event->fn(event->arg);
+    }
+    in_isr = nested;
+}
+
+static void dump_tasks(void)
+{
+    struct sim_task *task;
+    for (task = tasks; task != NULL; task = task->next)
+    {
+        fprintf(stderr, "  %-16s prio %u state %d wait %p\n", task->name, task->priority, task->state, task->wait_obj);
+    }
+}
+
+static struct sim_task *highest_ready(void)
+{
+    struct sim_task *best = NULL;
+    struct sim_task *task;
+    for (task = tasks; task != NULL; task = task->next)
+    {
+        if (task->state != TaskReady) continue;
+        if (best == NULL || task->priority > best->priority ||
+            (task->priority == best->priority && task->ready_seq < best->ready_seq))
+        {
+            best = task;
+        }
+    }
+    return best;
+}
+
+//Next task to run, virtual time jumps to the next deadline or event while nothing is ready
+static struct sim_task *pick(void)
+{
+    for (;;)
+    {
+        struct sim_task *best;
+        struct sim_task *task;
+        uint64_t next_us = SIM_FOREVER;
+
+        run_due_events();
+        best = highest_ready();
+        if (best != NULL) return best;
+
+        for (task = tasks; task != NULL; task = task->next)
+        {
+            if (task->state == TaskBlocked && task->wake_us < next_us) next_us = task->wake_us;
+        }
+        if (events != NULL && events->at_us < next_us) next_us = events->at_us;
+        if (next_us == SIM_FOREVER)
+        {
+            fprintf(stderr, "sim: every task is blocked forever at %llu us\n", (unsigned long long)now_us);
+            dump_tasks();
+            abort();
+        }
+        if (next_us > now_us)
+        {
+            idle_us += next_us - now_us;
+            now_us = next_us;
+        }
+        for (task = tasks; task != NULL; task = task->next)
+        {
+            if (task->state == TaskBlocked && task->wake_us <= now_us)
+            {
+                make_ready(task);
+                task->timed_out = true;
+            }
+        }
+    }
+}
+
+//Called by the running task after it changed its own state, returns once it runs again
+static void switch_to(struct sim_task *next)
+{
+    struct sim_task *self = current;
+    self->run_us += now_us - run_since_us;
+    run_since_us = now_us;
+    current = next;
+    next->state = TaskRunning;
+    if (next == self) return;
+
+    switches++;
+    pthread_cond_signal(&next->cond);
+    while (current != self)
+    {
+        pthread_cond_wait(&self->cond, &big_lock);
+    }
+}
+
+static void reschedule(void)
+{
+    switch_to(pick());
+}
+
+void sim_yield_if_higher(void)
+{
+    if (in_isr) return;
+    run_due_events();
+    struct sim_task *best = highest_ready();
+    if (best != NULL && best->priority > current->priority)
+    {
+        make_ready(current);
+        reschedule();
+    }
+}
+
+void sim_yield_from_isr(BaseType_t woken)
+{
+    if (woken) sim_yield_if_higher();
+}
+
+bool sim_wait_on(const void *obj, uint64_t deadline_us)
+{
+    struct sim_task *self = current;
+    if (deadline_us <= now_us) return false;
+
+    self->state = TaskBlocked;
+    self->wait_obj = obj;
+    self->wake_us = deadline_us;
+    self->timed_out = false;
+    reschedule();
+    self->wait_obj = NULL;
+    return !self->timed_out;
+}
+
+void sim_wake_waiters(const void *obj)
+{
+    struct sim_task *task;
+    if (obj == NULL) return;
+    for (task = tasks; task != NULL; task = task->next)
+    {
+        if (task->state == TaskBlocked && task->wait_obj == obj) make_ready(task);
+    }
+}
+
+static uint64_t deadline_for(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY) return SIM_FOREVER;
+    return now_us + (uint64_t)ticks * (1000000 / configTICK_RATE_HZ);
+}
+
+static struct sim_task *new_task(const char *name, UBaseType_t priority)
+{
+    struct sim_task *task = calloc(1, sizeof(*task));
+    if (task == NULL) return NULL;
+    pthread_cond_init(&task->cond, NULL);
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    task->priority = priority;
+    task->number = task_count++;
+    task->wake_us = SIM_FOREVER;
+    task->next = tasks;
+    tasks = task;
+    return task;
+}
+
+void sim_init(void)
+{
+    pthread_mutex_lock(&big_lock);
+    current = new_task("test", SIM_TEST_TASK_PRIORITY);
+    current->thread = pthread_self();
+    current->state = TaskRunning;
+    run_since_us = now_us;
+}
+
+uint64_t sim_now_us(void)
+{
+    return now_us;
+}
+
+uint64_t sim_idle_us(void)
+{
+    return idle_us;
+}
+
+uint32_t sim_switch_count(void)
+{
+    return switches;
+}
+
+bool sim_in_isr(void)
+{
+    return in_isr;
+}
+
+void sim_sleep_us(uint64_t us)
+{
+    uint64_t deadline_us = now_us + us;
+    if (us == 0)
+    {
+        make_ready(current);
+        reschedule();
+        return;
+    }
+    while (now_us < deadline_us)
+    {
+        sim_wait_on(NULL, deadline_us);
+    }
+}
+
+void sim_event_schedule(sim_event_t *event, uint64_t at_us, sim_event_fn_t fn, void *arg)
+{
+    sim_event_t **link = &events;
+    sim_event_cancel(event);
+    event->at_us = at_us < now_us ? now_us : at_us;
+    event->fn = fn;
+    event->arg = arg;
+    while (*link != NULL && (*link)->at_us <= event->at_us) link = &(*link)->next;
+    event->next = *link;
+    *link = event;
+    event->queued = true;
+
+    //Due now: the interrupt preempts whatever runs
+    if (event->at_us == now_us && !in_isr && current != NULL) sim_yield_if_higher();
+}
+
+void sim_event_cancel(sim_event_t *event)
+{
+    sim_event_t **link = &events;
+    if (!event->queued) return;
+    while (*link != NULL && *link != event) link = &(*link)->next;
+    if (*link != NULL) *link = event->next;
+    event->queued = false;
+}
+
+static void *task_trampoline(void *arg)
+{
+    struct sim_task *self = arg;
+    pthread_mutex_lock(&big_lock);
+    while (current != self)
+    {
+        pthread_cond_wait(&self->cond, &big_lock);
+    }
+    self->fn(self->arg);
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+    UBaseType_t priority, TaskHandle_t *handle, BaseType_t core_id)
+{
+    struct sim_task *task = new_task(name, priority);
+    if (task == NULL) return pdFAIL;
+    task->fn = fn;
+    task->arg = arg;
+    task->state = TaskBlocked;
+    if (pthread_create(&task->thread, NULL, task_trampoline, task) != 0)
+    {
+        task->state = TaskDeleted;
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    if (handle != NULL) *handle = task;
+    make_ready(task);
+    sim_yield_if_higher();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task != NULL && task != current)
+    {
+        //Its thread stays parked, it is never picked again
+        task->state = TaskDeleted;
+        return;
+    }
+    struct sim_task *self = current;
+    self->state = TaskDeleted;
+    current = pick();
+    current->state = TaskRunning;
+    pthread_cond_signal(&current->cond);
+    pthread_mutex_unlock(&big_lock);
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    sim_sleep_us((uint64_t)ticks * (1000000 / configTICK_RATE_HZ));
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)((now_us - SIM_START_US) / (1000000 / configTICK_RATE_HZ));
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+    return xTaskGetTickCount();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current;
+}
+
+char *pcTaskGetName(TaskHandle_t task)
+{
+    return task != NULL ? task->name : current->name;
+}
+
+//There is no idle task, idle time is kept by the scheduler
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t core_id)
+{
+    return NULL;
+}
+
+configRUN_TIME_COUNTER_TYPE ulTaskGetRunTimeCounter(TaskHandle_t task)
+{
+    if (task == NULL) return idle_us;
+    return task->run_us + (task == current ? now_us - run_since_us : 0);
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t max, configRUN_TIME_COUNTER_TYPE *total_run_time)
+{
+    struct sim_task *task;
+    UBaseType_t n = 0;
+    for (task = tasks; task != NULL; task = task->next)
+    {
+        if (task->state == TaskDeleted) continue;
+        if (n == max) return 0;
+        status[n].xHandle = task;
+        status[n].pcTaskName = task->name;
+        status[n].xTaskNumber = task->number;
+        status[n].eCurrentState = task->state == TaskRunning ? eRunning : task->state == TaskReady ? eReady : eBlocked;
+        status[n].uxCurrentPriority = task->priority;
+        status[n].uxBasePriority = task->priority;
+        status[n].ulRunTimeCounter = ulTaskGetRunTimeCounter(task);
+        status[n].pxStackBase = NULL;
+        status[n].usStackHighWaterMark = 0;
+        status[n].xCoreID = tskNO_AFFINITY;
+        n++;
+    }
+    if (total_run_time != NULL) *total_run_time = now_us - SIM_START_US;
+    return n;
+}
+
+void vTaskList(char *buffer)
+{
+    struct sim_task *task;
+    buffer[0] = '\0';
+    for (task = tasks; task != NULL; task = task->next)
+    {
+        buffer += sprintf(buffer, "%-16s %d %u\n", task->name, task->state, task->priority);
+    }
+}
+
+static bool notify(TaskHandle_t task, UBaseType_t index, uint32_t value, eNotifyAction action, uint32_t *previous)
+{
+    bool stored = true;
+    if (task == NULL || index >= SIM_NOTIFY_ENTRIES)
+    {
+        fprintf(stderr, "sim: notification index %u on %s, %d entries configured\n", index,
+            task != NULL ? task->name : "NULL", SIM_NOTIFY_ENTRIES);
+        abort();
+    }
+    if (previous != NULL) *previous = task->notify_value[index];
+    switch (action)
+    {
+        case eSetBits:
+            task->notify_value[index] |= value;
+            break;
+        case eIncrement:
+            task->notify_value[index]++;
+            break;
+        case eSetValueWithOverwrite:
+            task->notify_value[index] = value;
+            break;
+        case eSetValueWithoutOverwrite:
+            if (task->notify_pending[index]) stored = false;
+            else task->notify_value[index] = value;
+            break;
+        case eNoAction:
+            break;
+    }
+    task->notify_pending[index] = true;
+    if (task->state == TaskBlocked && task->wait_obj == &task->notify_pending[index]) make_ready(task);
+    return stored;
+}
+
+BaseType_t xTaskGenericNotify(TaskHandle_t task, UBaseType_t index, uint32_t value, eNotifyAction action, uint32_t *previous)
+{
+    bool stored = notify(task, index, value, action, previous);
+    sim_yield_if_higher();
+    return stored ? pdPASS : pdFAIL;
+}
+
+BaseType_t xTaskGenericNotifyFromISR(TaskHandle_t task, UBaseType_t index, uint32_t value, eNotifyAction action,
+    uint32_t *previous, BaseType_t *woken)
+{
+    bool stored = notify(task, index, value, action, previous);
+    if (woken != NULL && task->state == TaskReady && task->priority > current->priority) *woken = pdTRUE;
+    return stored ? pdPASS : pdFAIL;
+}
+
+BaseType_t xTaskGenericNotifyWait(UBaseType_t index, uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value,
+    TickType_t ticks)
+{
+    struct sim_task *self = current;
+    uint64_t deadline_us = deadline_for(ticks);
+    BaseType_t res = pdFALSE;
+
+    if (!self->notify_pending[index]) self->notify_value[index] &= ~clear_on_entry;
+    while (!self->notify_pending[index])
+    {
+        if (!sim_wait_on(&self->notify_pending[index], deadline_us)) break;
+    }
+    if (value != NULL) *value = self->notify_value[index];
+    if (self->notify_pending[index])
+    {
+        self->notify_value[index] &= ~clear_on_exit;
+        res = pdTRUE;
+    }
+    self->notify_pending[index] = false;
+    return res;
+}
+
+uint32_t ulTaskGenericNotifyTake(UBaseType_t index, BaseType_t clear_on_exit, TickType_t ticks)
+{
+    struct sim_task *self = current;
+    uint64_t deadline_us = deadline_for(ticks);
+
+    while (self->notify_value[index] == 0)
+    {
+        self->notify_pending[index] = false;
+        if (!sim_wait_on(&self->notify_pending[index], deadline_us)) break;
+    }
+    uint32_t value = self->notify_value[index];
+    if (value != 0)
+    {
+        self->notify_value[index] = clear_on_exit ? 0 : value - 1;
+    }
+    self->notify_pending[index] = false;
+    return value;
+}
+
+uint32_t ulTaskGenericNotifyValueClear(TaskHandle_t task, UBaseType_t index, uint32_t clear)
+{
+    if (task == NULL) task = current;
+    uint32_t value = task->notify_value[index];
+    task->notify_value[index] &= ~clear;
+    return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct sim_queue *queue = calloc(1, sizeof(*queue));
+    if (queue == NULL) return NULL;
+    queue->length = length;
+    queue->item_size = item_size;
+    if (item_size > 0)
+    {
+        queue->items = calloc(length, item_size);
+        if (queue->items == NULL)
+        {
+            free(queue);
+            return NULL;
+        }
+    }
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    free(queue->items);
+    free(queue);
+}
+
+static bool queue_push(QueueHandle_t queue, const void *item)
+{
+    if (queue->count == queue->length) return false;
+    if (queue->item_size > 0)
+    {
+        UBaseType_t slot = (queue->head + queue->count) % queue->length;
+        memcpy(&queue->items[slot * queue->item_size], item, queue->item_size);
+    }
+    queue->count++;
+    sim_wake_waiters(queue);
+    return true;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    uint64_t deadline_us = deadline_for(ticks);
+    while (!queue_push(queue, item))
+    {
+        if (!sim_wait_on(queue, deadline_us)) return errQUEUE_FULL;
+    }
+    sim_yield_if_higher();
+    return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken)
+{
+    if (!queue_push(queue, item)) return errQUEUE_FULL;
+    if (woken != NULL)
+    {
+        struct sim_task *best = highest_ready();
+        if (best != NULL && best->priority > current->priority) *woken = pdTRUE;
+    }
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    uint64_t deadline_us = deadline_for(ticks);
+    while (queue->count == 0)
+    {
+        if (!sim_wait_on(queue, deadline_us)) return pdFALSE;
+    }
+    if (queue->item_size > 0)
+    {
+        memcpy(item, &queue->items[queue->head * queue->item_size], queue->item_size);
+    }
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    sim_wake_waiters(queue);
+    sim_yield_if_higher();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t sem = xQueueCreate(1, 0);
+    if (sem != NULL) sem->count = 1;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    SemaphoreHandle_t sem = xQueueCreate(max, 0);
+    if (sem != NULL) sem->count = initial;
+    return sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    return xQueueReceive(sem, NULL, ticks);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (!queue_push(sem, NULL)) return pdFALSE;
+    sim_yield_if_higher();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken)
+{
+    return xQueueSendFromISR(sem, NULL, woken);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Virtual time starts here so a timestamp of 0 never looks like "now"
+#define SIM_START_US (1000000ULL)
+#define SIM_FOREVER (UINT64_MAX)
+#define SIM_TEST_TASK_PRIORITY (1)
+
+//Callback run in interrupt context at a point in virtual time
+typedef void (*sim_event_fn_t)(void *arg);
+
+//Caller owned so it can be cancelled without a dangling handle
+typedef struct sim_event
+{
+    uint64_t at_us;
+    sim_event_fn_t fn;
+    void *arg;
+    bool queued;
+    struct sim_event *next;
+} sim_event_t;
+
+//Only one task runs at a time and time only moves while every task is blocked, so runs are deterministic.
+//The calling thread becomes the test task
+void sim_init(void);
+uint64_t sim_now_us(void);
+//Total virtual time no task was ready to run
+uint64_t sim_idle_us(void);
+//Blocks the calling task, other tasks and interrupts run meanwhile
+void sim_sleep_us(uint64_t us);
+//Number of times the scheduler handed the CPU to a task
+uint32_t sim_switch_count(void);
+bool sim_in_isr(void);
+
+void sim_event_schedule(sim_event_t *event, uint64_t at_us, sim_event_fn_t fn, void *arg);
+void sim_event_cancel(sim_event_t *event);
+
+//Wait primitives for the other simulated peripherals, obj is any address shared by waiter and waker
+bool sim_wait_on(const void *obj, uint64_t deadline_us);
+void sim_wake_waiters(const void *obj);
+//Runs a higher priority task that became ready, a no-op in interrupt context
+void sim_yield_if_higher(void);
@@ -0,0 +1,167 @@
+#include "sim_lcd.h"
+#include "sim_kernel.h"
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_panel_ops.h"
+#include "esp_lcd_panel_commands.h"
+#include <string.h>
+
+struct esp_lcd_panel_io_t
+{
+    esp_lcd_panel_io_color_trans_done_cb_t on_color_trans_done;
+    void *user_ctx;
+    bool color_busy;
+    const uint16_t *color;      //Read by the DMA until the transfer completes
+    size_t color_size;
+    sim_event_t color_event;
+};
+
+struct esp_lcd_panel_t
+{
+    esp_lcd_panel_io_handle_t io;
+};
+
+static struct esp_lcd_panel_io_t lcd_io;
+static struct esp_lcd_panel_t lcd_panel = { .io = &lcd_io };
+static uint16_t gram[SIM_LCD_GRAM_HEIGHT][SIM_LCD_GRAM_WIDTH];
+static uint16_t caset[2];
+static uint16_t raset[2];
+static sim_lcd_stats_t stats;
+
+uint32_t sim_lcd_transfer_us(uint32_t bytes)
+{
+    return SIM_LCD_TRANS_SETUP_US + (uint32_t)(((uint64_t)bytes * 8 * 1000000 + SIM_LCD_PCLK_HZ - 1) / SIM_LCD_PCLK_HZ);
+}
+
+void sim_lcd_create(esp_lcd_panel_io_handle_t *io, esp_lcd_panel_handle_t *panel)
+{
+    *io = &lcd_io;
+    *panel = &lcd_panel;
+}
+
+void sim_lcd_get_stats(sim_lcd_stats_t *out)
+{
+    *out = stats;
+}
+
+void sim_lcd_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+uint16_t sim_lcd_pixel(int32_t x, int32_t y)
+{
+    return gram[y][x];
+}
+
+static void bus_time(uint32_t bytes)
+{
+    uint32_t us = sim_lcd_transfer_us(bytes);
+    stats.wire_bytes += bytes;
+    stats.busy_us += us;
+    sim_sleep_us(us);
+}
+
+//Like panel_io_spi, a polled transaction first collects every queued color transfer
+static void wait_color_done(esp_lcd_panel_io_handle_t io)
+{
+    while (io->color_busy)
+    {
+        sim_wait_on(io, SIM_FOREVER);
+    }
+}
+
+//RAMWR fills the CASET/RASET window row by row from the DMA buffer as it reads it
+static void write_window(const uint16_t *color, size_t size)
+{
+    size_t count = size / sizeof(uint16_t);
+    int32_t x = caset[0];
+    int32_t y = raset[0];
+    size_t i;
+
+    for (i = 0; i < count && y <= raset[1]; ++i)
+    {
+        if (x < SIM_LCD_GRAM_WIDTH && y < SIM_LCD_GRAM_HEIGHT) gram[y][x] = color[i];
+        if (++x > caset[1])
+        {
+            x = caset[0];
+            y++;
+        }
+    }
+}
+
+static void color_done(void *arg)
+{
+    esp_lcd_panel_io_handle_t io = arg;
+    esp_lcd_panel_io_event_data_t edata;
+
+    write_window(io->color, io->color_size);
+    io->color_busy = false;
+    sim_wake_waiters(io);
+    if (io->on_color_trans_done != NULL) io->on_color_trans_done(io, &edata, io->user_ctx);
+}
+
+esp_err_t esp_lcd_panel_io_tx_param(esp_lcd_panel_io_handle_t io, int lcd_cmd, const void *param, size_t param_size)
+{
+    const uint8_t *p = param;
+
+    wait_color_done(io);
+    stats.commands++;
+    bus_time(1 + param_size);
+    if (lcd_cmd == LCD_CMD_CASET && param_size == 4)
+    {
+        caset[0] = (p[0] << 8) | p[1];
+        caset[1] = (p[2] << 8) | p[3];
+    }
+    else if (lcd_cmd == LCD_CMD_RASET && param_size == 4)
+    {
+        raset[0] = (p[0] << 8) | p[1];
+        raset[1] = (p[2] << 8) | p[3];
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_panel_io_tx_color(esp_lcd_panel_io_handle_t io, int lcd_cmd, const void *color, size_t color_size)
+{
+    uint32_t us = sim_lcd_transfer_us(color_size);
+
+    wait_color_done(io);
+    //The command byte goes out polled, the payload is queued to the DMA
+    bus_time(1);
+    io->color_busy = true;
+    io->color = color;
+    io->color_size = color_size;
+    stats.color_transfers++;
+    stats.color_bytes += color_size;
+    stats.wire_bytes += color_size;
+    stats.busy_us += us;
+    sim_event_schedule(&io->color_event, sim_now_us() + us, color_done, io);
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_panel_io_register_event_callbacks(esp_lcd_panel_io_handle_t io, const esp_lcd_panel_io_callbacks_t *cbs,
+    void *user_ctx)
+{
+    io->on_color_trans_done = cbs->on_color_trans_done;
+    io->user_ctx = user_ctx;
+    return ESP_OK;
+}
+
+//Same sequence as the esp_lcd ST7789 driver, x_end and y_end are exclusive
+esp_err_t esp_lcd_panel_draw_bitmap(esp_lcd_panel_handle_t panel, int x_start, int y_start, int x_end, int y_end,
+    const void *color_data)
+{
+    uint8_t window[4];
+
+    window[0] = (x_start >> 8) & 0xFF;
+    window[1] = x_start & 0xFF;
+    window[2] = ((x_end - 1) >> 8) & 0xFF;
+    window[3] = (x_end - 1) & 0xFF;
+    esp_lcd_panel_io_tx_param(panel->io, LCD_CMD_CASET, window, sizeof(window));
+    window[0] = (y_start >> 8) & 0xFF;
+    window[1] = y_start & 0xFF;
+    window[2] = ((y_end - 1) >> 8) & 0xFF;
+    window[3] = (y_end - 1) & 0xFF;
+    esp_lcd_panel_io_tx_param(panel->io, LCD_CMD_RASET, window, sizeof(window));
+    return esp_lcd_panel_io_tx_color(panel->io, LCD_CMD_RAMWR, color_data,
+        (size_t)(x_end - x_start) * (y_end - y_start) * sizeof(uint16_t));
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_lcd_types.h"
+
+//ST7789 on SPI2 at the pclk_hz st7789_init configures, 240 x 320 frame memory
+#define SIM_LCD_PCLK_HZ (10 * 1000 * 1000)
+#define SIM_LCD_GRAM_WIDTH (240)
+#define SIM_LCD_GRAM_HEIGHT (320)
+#define SIM_LCD_TRANS_SETUP_US (5) //Per SPI transaction: driver, CS and DC handling
+
+typedef struct
+{
+    uint32_t commands;          //tx_param calls, polled and blocking
+    uint32_t color_transfers;   //tx_color calls, DMA and finished from the ISR
+    uint64_t color_bytes;
+    uint64_t wire_bytes;        //Commands, parameters and pixels
+    uint64_t busy_us;           //Time the bus was in use
+} sim_lcd_stats_t;
+
+void sim_lcd_create(esp_lcd_panel_io_handle_t *io, esp_lcd_panel_handle_t *panel);
+void sim_lcd_get_stats(sim_lcd_stats_t *stats);
+void sim_lcd_reset_stats(void);
+//Bus time of one transaction carrying bytes
+uint32_t sim_lcd_transfer_us(uint32_t bytes);
+uint16_t sim_lcd_pixel(int32_t x, int32_t y);
@@ -0,0 +1,54 @@
+#include "esp_log.h"
+#include "esp_err.h"
+#include "sim_kernel.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int level = -1;
+
+static esp_log_level_t get_level(void)
+{
+    if (level < 0)
+    {
+        const char *env = getenv("HOST_TEST_LOG");
+        level = env != NULL ? atoi(env) : ESP_LOG_WARN;
+    }
+    return (esp_log_level_t)level;
+}
+
+void sim_log(esp_log_level_t msg_level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+    va_list args;
+
+    if (msg_level > get_level()) return;
+    printf("%c (%llu) %s: ", letters[msg_level], (unsigned long long)((sim_now_us() - SIM_START_US) / 1000), tag);
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+}
+
+//One level for every tag, tests only use it to silence expected warnings
+void esp_log_level_set(const char *tag, esp_log_level_t new_level)
+{
+    level = new_level;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        default: return "UNKNOWN ERROR";
+    }
+}
@@ -0,0 +1,140 @@
+#include "sim_lvgl.h"
+#include "sim_kernel.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct _lv_display_t
+{
+    int32_t hor_res;
+    int32_t ver_res;
+    lv_display_flush_cb_t flush_cb;
+    void *user_data;
+    uint8_t *buf[2];
+    uint32_t buf_size;
+    uint8_t buf_act;
+    lv_display_render_mode_t render_mode;
+    volatile bool flushing;
+    bool flushing_last;
+    uint32_t frame;
+    uint32_t flush_calls;
+};
+
+lv_display_t *lv_display_create(int32_t hor_res, int32_t ver_res)
+{
+    lv_display_t *disp = calloc(1, sizeof(*disp));
+    disp->hor_res = hor_res;
+    disp->ver_res = ver_res;
+    return disp;
+}
+
+void lv_display_set_buffers(lv_display_t *disp, void *buf1, void *buf2, uint32_t buf_size,
+    lv_display_render_mode_t render_mode)
+{
+    disp->buf[0] = buf1;
+    disp->buf[1] = buf2;
+    disp->buf_size = buf_size;
+    disp->buf_act = 0;
+    disp->render_mode = render_mode;
+}
+
+void lv_display_set_flush_cb(lv_display_t *disp, lv_display_flush_cb_t flush_cb)
+{
+    disp->flush_cb = flush_cb;
+}
+
+void lv_display_set_user_data(lv_display_t *disp, void *user_data)
+{
+    disp->user_data = user_data;
+}
+
+void *lv_display_get_user_data(lv_display_t *disp)
+{
+    return disp->user_data;
+}
+
+void lv_display_flush_ready(lv_display_t *disp)
+{
+    disp->flushing = false;
+    sim_wake_waiters(disp);
+}
+
+bool lv_display_flush_is_last(lv_display_t *disp)
+{
+    return disp->flushing_last;
+}
+
+uint16_t sim_lvgl_pixel(int32_t x, int32_t y, uint32_t frame)
+{
+    return (uint16_t)(x * 7 + y * 251 + frame * 4099);
+}
+
+void sim_lvgl_wait_flushing(lv_display_t *disp)
+{
+    while (disp->flushing)
+    {
+        sim_wait_on(disp, SIM_FOREVER);
+    }
+}
+
+uint32_t sim_lvgl_flush_calls(lv_display_t *disp)
+{
+    return disp->flush_calls;
+}
+
+static void render(lv_display_t *disp, const lv_area_t *area, uint32_t render_us)
+{
+    uint16_t *px = (uint16_t *)disp->buf[disp->buf_act];
+    int32_t x, y;
+
+    sim_sleep_us(render_us);
+    for (y = area->y1; y <= area->y2; ++y)
+    {
+        for (x = area->x1; x <= area->x2; ++x)
+        {
+            if (disp->render_mode == LV_DISPLAY_RENDER_MODE_DIRECT) px[y * disp->hor_res + x] = sim_lvgl_pixel(x, y, disp->frame);
+            else *px++ = sim_lvgl_pixel(x, y, disp->frame);
+        }
+    }
+}
+
+//refr_area_part and draw_buf_flush: a single buffer is only drawn once free, a second one lets the flush overlap
+static void refresh_part(lv_display_t *disp, const lv_area_t *area, bool last, uint32_t render_us)
+{
+    bool double_buffered = disp->buf[1] != NULL;
+
+    if (!double_buffered) sim_lvgl_wait_flushing(disp);
+    render(disp, area, render_us);
+    if (double_buffered) sim_lvgl_wait_flushing(disp);
+
+    disp->flushing = true;
+    disp->flushing_last = last;
+    disp->flush_calls++;
+    disp->flush_cb(disp, area, disp->buf[disp->buf_act]);
+    if (double_buffered && (disp->render_mode != LV_DISPLAY_RENDER_MODE_DIRECT || last)) disp->buf_act ^= 1;
+}
+
+uint32_t sim_lvgl_refresh(lv_display_t *disp, const lv_area_t *areas, uint32_t count, uint32_t render_us)
+{
+    uint32_t i;
+
+    disp->frame++;
+    for (i = 0; i < count; ++i)
+    {
+        const lv_area_t *area = &areas[i];
+        int32_t rows = lv_area_get_height(area);
+
+        //Partial mode renders an area in as many rows as fit the buffer
+        if (disp->render_mode == LV_DISPLAY_RENDER_MODE_PARTIAL)
+        {
+            rows = LV_MIN(rows, (int32_t)(disp->buf_size / sizeof(uint16_t) / lv_area_get_width(area)));
+        }
+
+        lv_area_t part = *area;
+        for (part.y1 = area->y1; part.y1 <= area->y2; part.y1 += rows)
+        {
+            part.y2 = LV_MIN(part.y1 + rows - 1, area->y2);
+            refresh_part(disp, &part, i == count - 1 && part.y2 == area->y2, render_us);
+        }
+    }
+    return disp->frame;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "lvgl.h"
+
+//Value the render pass writes at a screen pixel, so tests can compare the panel with what LVGL drew
+uint16_t sim_lvgl_pixel(int32_t x, int32_t y, uint32_t frame);
+//One display refresh in LVGL 9.1's order. Every area is split into strips that fit the draw buffer, each strip takes
+//render_us of CPU, waits for the flush still using its buffer and is handed to the flush callback.
+//Returns the frame number that was drawn
+uint32_t sim_lvgl_refresh(lv_display_t *disp, const lv_area_t *areas, uint32_t count, uint32_t render_us);
+//Blocks until the flush callback reported the last handed out buffer ready
+void sim_lvgl_wait_flushing(lv_display_t *disp);
+uint32_t sim_lvgl_flush_calls(lv_display_t *disp);
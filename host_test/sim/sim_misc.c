@@ -0,0 +1,79 @@
+//Chip services without behaviour worth modelling: power management locks only count, the heap is malloc
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "sim_kernel.h"
+#include <stdlib.h>
+
+#define SIM_CPU_MHZ (240)
+
+struct esp_pm_lock
+{
+    esp_pm_lock_type_t type;
+    const char *name;
+    int count;
+};
+
+esp_err_t esp_pm_configure(const void *config)
+{
+    return config != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char *name, esp_pm_lock_handle_t *out_handle)
+{
+    struct esp_pm_lock *lock = calloc(1, sizeof(*lock));
+    if (lock == NULL) return ESP_ERR_NO_MEM;
+    lock->type = lock_type;
+    lock->name = name;
+    *out_handle = lock;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle)
+{
+    handle->count++;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle)
+{
+    if (handle->count == 0) return ESP_ERR_INVALID_STATE;
+    handle->count--;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_dump_locks(FILE *stream)
+{
+    return ESP_OK;
+}
+
+int sim_pm_lock_count(esp_pm_lock_handle_t handle)
+{
+    return handle->count;
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup(void)
+{
+    return ESP_OK;
+}
+
+uint32_t esp_cpu_get_cycle_count(void)
+{
+    return (uint32_t)(sim_now_us() * SIM_CPU_MHZ);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    return malloc(size);
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return 256 * 1024;
+}
@@ -0,0 +1,107 @@
+//C models of the PIE kernels in lv_draw_sw_pie_esp32s3.S, one 128-bit Q register access at a time
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define Q_BYTES (16)
+
+typedef struct
+{
+    uint8_t b[Q_BYTES];
+} q_reg_t;
+
+static void check_aligned(const void *addr, const char *insn)
+{
+    if (((uintptr_t)addr & (Q_BYTES - 1)) != 0)
+    {
+        //The hardware silently drops the low address bits, which would write or read the wrong pixels
+        fprintf(stderr, "%s on unaligned address %p\n", insn, addr);
+        abort();
+    }
+}
+
+//ee.vst.128.ip
+static void vst_128_ip(const q_reg_t *q, uint8_t **addr)
+{
+    check_aligned(*addr, "ee.vst.128.ip");
+    memcpy(*addr, q->b, Q_BYTES);
+    *addr += Q_BYTES;
+}
+
+//ee.vld.128.ip
+static void vld_128_ip(q_reg_t *q, const uint8_t **addr)
+{
+    check_aligned(*addr, "ee.vld.128.ip");
+    memcpy(q->b, *addr, Q_BYTES);
+    *addr += Q_BYTES;
+}
+
+//ee.ld.128.usar.ip: loads the aligned block holding addr and latches addr & 15 in SAR_BYTE
+static void ld_128_usar_ip(q_reg_t *q, const uint8_t **addr, uint32_t *sar_byte)
+{
+    const uint8_t *block = (const uint8_t *)((uintptr_t)*addr & ~(uintptr_t)(Q_BYTES - 1));
+    memcpy(q->b, block, Q_BYTES);
+    *sar_byte = (uintptr_t)*addr & (Q_BYTES - 1);
+    *addr += Q_BYTES;
+}
+
+//ee.src.q.qup: 16 bytes of the pair {qy:qx} starting SAR_BYTE bytes into qx, then qx = qy
+static void src_q_qup(q_reg_t *qa, q_reg_t *qx, const q_reg_t *qy, uint32_t sar_byte)
+{
+    uint8_t pair[2 * Q_BYTES];
+    memcpy(pair, qx->b, Q_BYTES);
+    memcpy(pair + Q_BYTES, qy->b, Q_BYTES);
+    memcpy(qa->b, pair + sar_byte, Q_BYTES);
+    *qx = *qy;
+}
+
+void lv_draw_sw_pie_fill16(uint16_t *dest, uint32_t blocks, uint32_t color32)
+{
+    uint8_t *a2 = (uint8_t *)dest;
+    q_reg_t q0;
+    uint32_t i;
+
+    //ee.vldbc.32 broadcast
+    for (i = 0; i < Q_BYTES / sizeof(color32); ++i) memcpy(&q0.b[i * sizeof(color32)], &color32, sizeof(color32));
+    for (i = 0; i < blocks; ++i) vst_128_ip(&q0, &a2);
+}
+
+void lv_draw_sw_pie_copy16(uint16_t *dest, const uint16_t *src, uint32_t blocks)
+{
+    uint8_t *a2 = (uint8_t *)dest;
+    const uint8_t *a3 = (const uint8_t *)src;
+    q_reg_t q0;
+    uint32_t i;
+
+    for (i = 0; i < blocks; ++i)
+    {
+        vld_128_ip(&q0, &a3);
+        vst_128_ip(&q0, &a2);
+    }
+}
+
+void lv_draw_sw_pie_copy16_unaligned(uint16_t *dest, const uint16_t *src, uint32_t blocks)
+{
+    uint8_t *a2 = (uint8_t *)dest;
+    const uint8_t *a3 = (const uint8_t *)src;
+    const uint8_t *end = a3 + blocks * Q_BYTES;
+    q_reg_t q0, q1, q2;
+    uint32_t sar_byte;
+    uint32_t i;
+
+    //With an aligned src the last load would fetch a whole block past the copy, which may not be mapped
+    if (((uintptr_t)src & (Q_BYTES - 1)) == 0)
+    {
+        fprintf(stderr, "lv_draw_sw_pie_copy16_unaligned with aligned src %p reads past %p\n", (const void *)src,
+            (const void *)end);
+        abort();
+    }
+    ld_128_usar_ip(&q0, &a3, &sar_byte);
+    for (i = 0; i < blocks; ++i)
+    {
+        ld_128_usar_ip(&q1, &a3, &sar_byte);
+        src_q_qup(&q2, &q0, &q1, sar_byte);
+        vst_128_ip(&q2, &a2);
+    }
+}
@@ -0,0 +1,122 @@
+#include "esp_timer.h"
+#include "sim_kernel.h"
+#include "freertos/FreeRTOS.h"
+#include <stdlib.h>
+
+#define TIMER_TASK_PRIORITY (22)    //ESP_TIMER_TASK_PRIO on the chip
+
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    bool skip_unhandled;
+    bool active;
+    uint64_t alarm_us;
+    uint64_t period_us;             //0 for one-shot timers
+    struct esp_timer *next;
+};
+
+static struct esp_timer *timers;
+static TaskHandle_t timer_task;
+
+//Callbacks run one after the other in a single high priority task, as with ESP_TIMER_TASK dispatch
+static void timer_task_fn(void *arg)
+{
+    while (1)
+    {
+        struct esp_timer *due = NULL;
+        struct esp_timer *timer;
+        for (timer = timers; timer != NULL; timer = timer->next)
+        {
+            if (timer->active && (due == NULL || timer->alarm_us < due->alarm_us)) due = timer;
+        }
+        if (due == NULL || due->alarm_us > sim_now_us())
+        {
+            sim_wait_on(&timers, due != NULL ? due->alarm_us : SIM_FOREVER);
+            continue;
+        }
+
+        if (due->period_us == 0)
+        {
+            due->active = false;
+        }
+        else if (due->skip_unhandled)
+        {
+            while (due->alarm_us <= sim_now_us()) due->alarm_us += due->period_us;
+        }
+        else
+        {
+            due->alarm_us += due->period_us;
+        }
+        due->callback(due->arg);
+    }
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)sim_now_us();
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle)
+{
+    if (args == NULL || args->callback == NULL || handle == NULL) return ESP_ERR_INVALID_ARG;
+    struct esp_timer *timer = calloc(1, sizeof(*timer));
+    if (timer == NULL) return ESP_ERR_NO_MEM;
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    timer->skip_unhandled = args->skip_unhandled_events;
+    timer->next = timers;
+    timers = timer;
+    if (timer_task == NULL)
+    {
+        xTaskCreate(timer_task_fn, "esp_timer", 4096, NULL, TIMER_TASK_PRIORITY, &timer_task);
+    }
+    *handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us)
+{
+    if (timer == NULL) return ESP_ERR_INVALID_ARG;
+    if (timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = true;
+    timer->alarm_us = sim_now_us() + timeout_us;
+    timer->period_us = period_us;
+    sim_wake_waiters(&timers);
+    sim_yield_if_higher();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    return start(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (timer == NULL) return ESP_ERR_INVALID_ARG;
+    if (!timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    struct esp_timer **link = &timers;
+    if (timer == NULL) return ESP_ERR_INVALID_ARG;
+    if (timer->active) return ESP_ERR_INVALID_STATE;
+    while (*link != NULL && *link != timer) link = &(*link)->next;
+    if (*link != NULL) *link = timer->next;
+    free(timer);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer != NULL && timer->active;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+//240 cycles per microsecond of virtual time, code between two reads takes none
+uint32_t esp_cpu_get_cycle_count(void);
@@ -0,0 +1,9 @@
+#pragma once
+
+#define LCD_CMD_SLPIN (0x10)
+#define LCD_CMD_SLPOUT (0x11)
+#define LCD_CMD_DISPOFF (0x28)
+#define LCD_CMD_DISPON (0x29)
+#define LCD_CMD_CASET (0x2A)
+#define LCD_CMD_RASET (0x2B)
+#define LCD_CMD_RAMWR (0x2C)
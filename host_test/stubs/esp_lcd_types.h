@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdbool.h>
+
+typedef struct esp_lcd_panel_io_t *esp_lcd_panel_io_handle_t;
+typedef struct esp_lcd_panel_t *esp_lcd_panel_handle_t;
+
+typedef struct
+{
+} esp_lcd_panel_io_event_data_t;
+
+//Runs in the SPI ISR, returns whether a higher priority task was woken
+typedef bool (*esp_lcd_panel_io_color_trans_done_cb_t)(esp_lcd_panel_io_handle_t panel_io,
+    esp_lcd_panel_io_event_data_t *edata, void *user_ctx);
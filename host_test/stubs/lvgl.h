@@ -0,0 +1,80 @@
+#pragma once
+
+//The slice of the LVGL 9.1 API the host-built modules use. Areas behave like LVGL's, the display is a test double
+//whose refresh loop is driven by sim_lvgl.h
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LV_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define LV_MAX(a, b) ((a) > (b) ? (a) : (b))
+
+typedef enum
+{
+    LV_RESULT_INVALID = 0,
+    LV_RESULT_OK
+} lv_result_t;
+
+typedef struct
+{
+    int32_t x1;
+    int32_t y1;
+    int32_t x2;
+    int32_t y2;
+} lv_area_t;
+
+typedef enum
+{
+    LV_DISPLAY_RENDER_MODE_PARTIAL,
+    LV_DISPLAY_RENDER_MODE_DIRECT,
+    LV_DISPLAY_RENDER_MODE_FULL
+} lv_display_render_mode_t;
+
+typedef struct _lv_display_t lv_display_t;
+typedef void (*lv_display_flush_cb_t)(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+
+static inline int32_t lv_area_get_width(const lv_area_t *area)
+{
+    return area->x2 - area->x1 + 1;
+}
+
+static inline int32_t lv_area_get_height(const lv_area_t *area)
+{
+    return area->y2 - area->y1 + 1;
+}
+
+static inline uint32_t lv_area_get_size(const lv_area_t *area)
+{
+    return (uint32_t)lv_area_get_width(area) * (uint32_t)lv_area_get_height(area);
+}
+
+static inline void lv_area_set(lv_area_t *area, int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+{
+    area->x1 = x1;
+    area->y1 = y1;
+    area->x2 = x2;
+    area->y2 = y2;
+}
+
+static inline void lv_area_copy(lv_area_t *dest, const lv_area_t *src)
+{
+    *dest = *src;
+}
+
+static inline void lv_area_join(lv_area_t *res, const lv_area_t *a1, const lv_area_t *a2)
+{
+    res->x1 = LV_MIN(a1->x1, a2->x1);
+    res->y1 = LV_MIN(a1->y1, a2->y1);
+    res->x2 = LV_MAX(a1->x2, a2->x2);
+    res->y2 = LV_MAX(a1->y2, a2->y2);
+}
+
+lv_display_t *lv_display_create(int32_t hor_res, int32_t ver_res);
+void lv_display_set_buffers(lv_display_t *disp, void *buf1, void *buf2, uint32_t buf_size,
+    lv_display_render_mode_t render_mode);
+void lv_display_set_flush_cb(lv_display_t *disp, lv_display_flush_cb_t flush_cb);
+void lv_display_set_user_data(lv_display_t *disp, void *user_data);
+void *lv_display_get_user_data(lv_display_t *disp);
+//ISR safe, like the real one
+void lv_display_flush_ready(lv_display_t *disp);
+bool lv_display_flush_is_last(lv_display_t *disp);
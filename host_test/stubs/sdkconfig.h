@@ -0,0 +1,14 @@
+#pragma once
+
+//The options of the project sdkconfig the firmware sources test for
+#define CONFIG_IDF_TARGET "linux"
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_FREERTOS_HZ 1000
+#define CONFIG_FREERTOS_MAX_TASK_NAME_LEN 16
+#define CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES 2
+#define CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS 1
+#define CONFIG_FREERTOS_RUN_TIME_COUNTER_TYPE_U64 1
+#define CONFIG_WATCH_VERIFY_INIT_TABLES 1
+#define CONFIG_XTAL_FREQ 40
+#define CONFIG_PM_ENABLE 1
+#define CONFIG_LV_USE_FREERTOS_TASK_NOTIFY 1
@@ -0,0 +1,141 @@
+//AXP2101 interrupt sequences: VBUS and power key events from the PMU model, one callback per batch
+#include "host_test.h"
+#include "sim_board.h"
+#include "axp2101.h"
+#include "t_watch_s3.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static peripheral_handles_t peripherals;
+static sim_event_t raise_event;
+static uint32_t callbacks;
+static uint32_t last_events;
+static bool vbus_at_callback;
+
+static void event_cb(uint32_t events, void *user_data)
+{
+    callbacks++;
+    last_events = events;
+    vbus_at_callback = axp2101_is_vbus_present();
+}
+
+static void start(void)
+{
+    callbacks = 0;
+    last_events = 0;
+    sim_i2c_reset_counters(&sim_axp2101);
+}
+
+//The worker preempts the test task, a few ticks are plenty for a batch
+static void settle(void)
+{
+    vTaskDelay(pdMS_TO_TICKS(5));
+    CHECK_EQ(gpio_get_level(BOARD_PMU_INT), 1);
+    CHECK(sim_gpio_intr_enabled(BOARD_PMU_INT));
+}
+
+static void test_init_nothing_pending(void)
+{
+    start();
+    CHECK_EQ(axp2101_irq_init(event_cb, NULL), ESP_OK);
+    settle();
+    CHECK_EQ(callbacks, 0);
+    CHECK_EQ(sim_axp2101.transactions, 0);
+    CHECK(!axp2101_is_vbus_present());
+}
+
+static void test_vbus_insert_remove(void)
+{
+    start();
+    sim_axp2101_set_battery_percent(64);
+    sim_axp2101_set_vbus(true);
+    settle();
+    CHECK_EQ(callbacks, 1);
+    CHECK_EQ(last_events, AXP2101_IRQ_VBUS_INSERT);
+    CHECK(vbus_at_callback);
+    CHECK_EQ(axp2101_get_battery_percentage(), 64);
+    CHECK_EQ(sim_axp2101.reg_reads[XPOWERS_AXP2101_STATUS1], 1);
+
+    sim_axp2101_set_vbus(false);
+    settle();
+    CHECK_EQ(callbacks, 2);
+    CHECK_EQ(last_events, AXP2101_IRQ_VBUS_REMOVE);
+    CHECK(!vbus_at_callback);
+}
+
+//A cable bounce leaves both edges pending, the line state decides
+static void test_insert_and_remove_in_one_batch(void)
+{
+    start();
+    sim_axp2101.regs[XPOWERS_AXP2101_STATUS1] |= XPOWERS_AXP2101_STATUS1_VBUS_GOOD;
+    sim_axp2101_raise(AXP2101_IRQ_VBUS_REMOVE | AXP2101_IRQ_VBUS_INSERT);
+    settle();
+    CHECK_EQ(callbacks, 1);
+    CHECK_EQ(last_events, AXP2101_IRQ_VBUS_REMOVE | AXP2101_IRQ_VBUS_INSERT);
+    CHECK(axp2101_is_vbus_present());
+
+    sim_axp2101.regs[XPOWERS_AXP2101_STATUS1] &= ~XPOWERS_AXP2101_STATUS1_VBUS_GOOD;
+    sim_axp2101_raise(AXP2101_IRQ_VBUS_INSERT | AXP2101_IRQ_VBUS_REMOVE);
+    settle();
+    CHECK_EQ(callbacks, 2);
+    CHECK(!axp2101_is_vbus_present());
+}
+
+//Power key events carry no battery change, the percentage is not read
+static void test_pkey(void)
+{
+    start();
+    sim_axp2101_raise(AXP2101_IRQ_PKEY_SHORT);
+    settle();
+    CHECK_EQ(callbacks, 1);
+    CHECK_EQ(last_events, AXP2101_IRQ_PKEY_SHORT);
+    CHECK_EQ(sim_axp2101.reg_reads[XPOWERS_AXP2101_BAT_PERCENT_DATA], 0);
+
+    sim_axp2101_raise(AXP2101_IRQ_PKEY_LONG);
+    settle();
+    CHECK_EQ(callbacks, 2);
+    CHECK_EQ(last_events, AXP2101_IRQ_PKEY_LONG);
+}
+
+static void raise_pkey(void *arg)
+{
+    sim_axp2101_raise(AXP2101_IRQ_PKEY_SHORT);
+}
+
+//A source raised while the status is being read keeps INT low without a new edge, the same batch picks it up
+static void test_raised_during_batch(void)
+{
+    start();
+    sim_axp2101.latency_us = 2000;
+    sim_event_schedule(&raise_event, sim_now_us() + 1000, raise_pkey, NULL);
+    sim_axp2101_raise(AXP2101_IRQ_SOC_NEW);
+    vTaskDelay(pdMS_TO_TICKS(20));
+    sim_axp2101.latency_us = 0;
+    settle();
+    CHECK_EQ(callbacks, 1);
+    CHECK_EQ(last_events, AXP2101_IRQ_SOC_NEW | AXP2101_IRQ_PKEY_SHORT);
+    CHECK_EQ(sim_axp2101.regs[XPOWERS_AXP2101_INTSTS2], 0);
+}
+
+//Status bits of disabled sources neither pull INT nor reach the callback
+static void test_disabled_source(void)
+{
+    start();
+    sim_axp2101_raise(1UL << 0);
+    settle();
+    CHECK_EQ(callbacks, 0);
+    CHECK_EQ(sim_axp2101.transactions, 0);
+    sim_axp2101.regs[XPOWERS_AXP2101_INTSTS1] = 0;
+}
+
+int main(void)
+{
+    sim_board_init(&peripherals);
+    RUN_TEST(test_init_nothing_pending);
+    RUN_TEST(test_vbus_insert_remove);
+    RUN_TEST(test_insert_and_remove_in_one_batch);
+    RUN_TEST(test_pkey);
+    RUN_TEST(test_raised_during_batch);
+    RUN_TEST(test_disabled_source);
+    return 0;
+}
@@ -0,0 +1,146 @@
+//Reference counted AXP2101 rails under overlapping users: one LDO write per real change, ramp waits and on-time
+#include "host_test.h"
+#include "sim_board.h"
+#include "i2c_controller.h"
+#include "axp2101.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define RADIO_RAMP_MS (5)
+
+static peripheral_handles_t peripherals;
+static volatile uint64_t helper_done_us;
+static volatile bool helper_powered_up;
+
+static uint8_t ldos(void)
+{
+    return sim_axp2101.regs[XPOWERS_AXP2101_LDO_ONOFF_CTRL0];
+}
+
+static uint32_t write_us(void)
+{
+    return sim_i2c_transfer_us(I2C_FAST_MODE_HZ, 2, 0);
+}
+
+//RTC, backlight and touch as the bootloader left them, radio and haptics off until someone asks
+static void test_boot_state(void)
+{
+    CHECK_EQ(ldos() & (AXP2101_LDO_ALDO1 | AXP2101_LDO_ALDO2 | AXP2101_LDO_ALDO3),
+        AXP2101_LDO_ALDO1 | AXP2101_LDO_ALDO2 | AXP2101_LDO_ALDO3);
+    CHECK_EQ(ldos() & (AXP2101_LDO_ALDO4 | AXP2101_LDO_BLDO2), 0);
+    CHECK(!sim_drv2605_powered());
+}
+
+//Only the first acquire and the last release reach the PMU
+static void test_overlapping_users(void)
+{
+    bool powered_up;
+    uint32_t switches = sim_axp2101_ldo_switches(AXP2101_LDO_ALDO4);
+    sim_i2c_reset_counters(&sim_axp2101);
+
+    uint64_t start_us = sim_now_us();
+    CHECK_EQ(axp2101_rail_acquire(Axp2101RailRadio, &powered_up), ESP_OK);
+    CHECK(powered_up);
+    CHECK_EQ(sim_now_us() - start_us, write_us() + RADIO_RAMP_MS * 1000);
+    CHECK_EQ(sim_axp2101.transactions, 1);
+    CHECK(ldos() & AXP2101_LDO_ALDO4);
+
+    start_us = sim_now_us();
+    CHECK_EQ(axp2101_rail_acquire(Axp2101RailRadio, &powered_up), ESP_OK);
+    CHECK(!powered_up);
+    CHECK_EQ(sim_now_us(), start_us);
+    CHECK_EQ(axp2101_rail_release(Axp2101RailRadio), ESP_OK);
+    CHECK(ldos() & AXP2101_LDO_ALDO4);
+    CHECK_EQ(sim_axp2101.transactions, 1);
+
+    CHECK_EQ(axp2101_rail_release(Axp2101RailRadio), ESP_OK);
+    CHECK_EQ(ldos() & AXP2101_LDO_ALDO4, 0);
+    CHECK_EQ(sim_axp2101.transactions, 2);
+    CHECK_EQ(sim_axp2101_ldo_switches(AXP2101_LDO_ALDO4) - switches, 2);
+
+    //One release too many is refused and changes nothing
+    CHECK_EQ(axp2101_rail_release(Axp2101RailRadio), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(sim_axp2101.transactions, 2);
+}
+
+//Rails share one register, a change to one leaves the others as they are
+static void test_interleaved_rails(void)
+{
+    const uint8_t others = ldos() & ~(AXP2101_LDO_ALDO4 | AXP2101_LDO_BLDO2);
+    sim_i2c_reset_counters(&sim_axp2101);
+
+    CHECK_EQ(axp2101_rail_acquire(Axp2101RailRadio, NULL), ESP_OK);
+    CHECK_EQ(axp2101_rail_acquire(Axp2101RailHaptic, NULL), ESP_OK);
+    CHECK(sim_drv2605_powered());
+    CHECK_EQ(ldos(), others | AXP2101_LDO_ALDO4 | AXP2101_LDO_BLDO2);
+    CHECK_EQ(axp2101_rail_release(Axp2101RailRadio), ESP_OK);
+    CHECK_EQ(ldos(), others | AXP2101_LDO_BLDO2);
+    CHECK(sim_drv2605_powered());
+    CHECK_EQ(axp2101_rail_release(Axp2101RailHaptic), ESP_OK);
+    CHECK_EQ(ldos(), others);
+    CHECK(!sim_drv2605_powered());
+
+    //Four changes, each one write of the on/off register and no read
+    CHECK_EQ(sim_axp2101.transactions, 4);
+    CHECK_EQ(sim_axp2101.reg_writes[XPOWERS_AXP2101_LDO_ONOFF_CTRL0], 4);
+    CHECK_EQ(sim_axp2101.reg_reads[XPOWERS_AXP2101_LDO_ONOFF_CTRL0], 0);
+}
+
+static void helper_task(void *arg)
+{
+    bool powered_up = true;
+    vTaskDelay(pdMS_TO_TICKS(2));
+    ESP_ERROR_CHECK(axp2101_rail_acquire(Axp2101RailRadio, &powered_up));
+    helper_powered_up = powered_up;
+    helper_done_us = sim_now_us();
+    vTaskDelete(NULL);
+}
+
+//A user that arrives while the rail is still ramping does not get it early
+static void test_second_user_waits_for_ramp(void)
+{
+    helper_done_us = 0;
+    xTaskCreate(helper_task, "rail_user", 4096, NULL, 2, NULL);
+    uint64_t start_us = sim_now_us();
+    CHECK_EQ(axp2101_rail_acquire(Axp2101RailRadio, NULL), ESP_OK);
+    uint64_t ready_us = start_us + write_us() + RADIO_RAMP_MS * 1000;
+    CHECK_EQ(sim_now_us(), ready_us);
+    vTaskDelay(pdMS_TO_TICKS(1));
+    CHECK(helper_done_us != 0);
+    CHECK(!helper_powered_up);
+    CHECK(helper_done_us >= ready_us);
+    CHECK(helper_done_us < ready_us + 1000);
+
+    CHECK_EQ(axp2101_rail_release(Axp2101RailRadio), ESP_OK);
+    CHECK(ldos() & AXP2101_LDO_ALDO4);
+    CHECK_EQ(axp2101_rail_release(Axp2101RailRadio), ESP_OK);
+    CHECK_EQ(ldos() & AXP2101_LDO_ALDO4, 0);
+}
+
+//On-time runs from the write that switched the LDO on to the one that switched it off
+static void test_on_time(void)
+{
+    uint64_t before = axp2101_rail_get_on_time_us(Axp2101RailRadio);
+    uint64_t start_us = sim_now_us();
+    CHECK_EQ(axp2101_rail_acquire(Axp2101RailRadio, NULL), ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(100));
+    CHECK_EQ(axp2101_rail_get_on_time_us(Axp2101RailRadio) - before, sim_now_us() - start_us - write_us());
+    uint64_t release_us = sim_now_us();
+    CHECK_EQ(axp2101_rail_release(Axp2101RailRadio), ESP_OK);
+    CHECK_EQ(axp2101_rail_get_on_time_us(Axp2101RailRadio) - before, release_us - start_us);
+
+    //Frozen while off
+    vTaskDelay(pdMS_TO_TICKS(50));
+    CHECK_EQ(axp2101_rail_get_on_time_us(Axp2101RailRadio) - before, release_us - start_us);
+}
+
+int main(void)
+{
+    sim_board_init(&peripherals);
+    RUN_TEST(test_boot_state);
+    RUN_TEST(test_overlapping_users);
+    RUN_TEST(test_interleaved_rails);
+    RUN_TEST(test_second_user_waits_for_ramp);
+    RUN_TEST(test_on_time);
+    return 0;
+}
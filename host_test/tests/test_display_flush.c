@@ -0,0 +1,147 @@
+//Partial mode flush against the simulated 10 MHz SPI panel: completion driven flush ready versus a blocking flush
+#include "host_test.h"
+#include "sim_lcd.h"
+#include "sim_lvgl.h"
+#include "display_flush.h"
+#include "flush_planner.h"
+#include "power_profile.h"
+#include "t_watch_s3.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_panel_ops.h"
+
+#define STRIP_ROWS (24)
+#define STRIP_BYTES (BOARD_TFT_WIDTH * STRIP_ROWS * 2)
+#define RENDER_US (6000)    //Measured draw time of a busy 240 x 24 strip at 240 MHz
+#define FRAMES (10)
+
+static uint16_t buf1[BOARD_TFT_WIDTH * STRIP_ROWS];
+static uint16_t buf2[BOARD_TFT_WIDTH * STRIP_ROWS];
+static esp_lcd_panel_io_handle_t io;
+static esp_lcd_panel_handle_t panel;
+static lv_display_t *disp;
+static SemaphoreHandle_t blocking_done;
+
+static const lv_area_t full_screen = { 0, 0, BOARD_TFT_WIDTH - 1, BOARD_TFT_HEIGHT - 1 };
+
+//Bus time of one strip: CASET and RASET polled, RAMWR command and its DMA payload
+static uint32_t strip_us(void)
+{
+    return 2 * sim_lcd_transfer_us(5) + sim_lcd_transfer_us(1) + sim_lcd_transfer_us(STRIP_BYTES);
+}
+
+static bool blocking_done_cb(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
+{
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(blocking_done, &woken);
+    return woken == pdTRUE;
+}
+
+//Flush ready only once the strip left the buffer, with nothing rendered meanwhile
+static void blocking_flush_cb(lv_display_t *d, const lv_area_t *area, uint8_t *px_map)
+{
+    esp_lcd_panel_draw_bitmap(panel, area->x1, area->y1 + DISPLAY_FLUSH_ROW_OFFSET, area->x2 + 1,
+        area->y2 + DISPLAY_FLUSH_ROW_OFFSET + 1, px_map);
+    xSemaphoreTake(blocking_done, portMAX_DELAY);
+    lv_display_flush_ready(d);
+}
+
+static void check_panel_shows(uint32_t frame)
+{
+    int32_t x, y;
+    for (y = 0; y < BOARD_TFT_HEIGHT; ++y)
+    {
+        for (x = 0; x < BOARD_TFT_WIDTH; ++x)
+        {
+            CHECK_EQ(sim_lcd_pixel(x, y + DISPLAY_FLUSH_ROW_OFFSET), sim_lvgl_pixel(x, y, frame));
+        }
+    }
+}
+
+//Virtual time for FRAMES full screen refreshes until the last strip is on the panel
+static uint64_t run_frames(uint32_t *last_frame)
+{
+    uint64_t start_us = sim_now_us();
+    uint32_t i;
+    for (i = 0; i < FRAMES; ++i)
+    {
+        *last_frame = sim_lvgl_refresh(disp, &full_screen, 1, RENDER_US);
+    }
+    sim_lvgl_wait_flushing(disp);
+    return sim_now_us() - start_us;
+}
+
+static void test_blocking_vs_async(void)
+{
+    const uint32_t strips = FRAMES * BOARD_TFT_HEIGHT / STRIP_ROWS;
+    uint32_t frame;
+    uint32_t calls;
+
+    const esp_lcd_panel_io_callbacks_t blocking_callbacks = {
+        .on_color_trans_done = blocking_done_cb
+    };
+    blocking_done = xSemaphoreCreateBinary();
+    ESP_ERROR_CHECK(esp_lcd_panel_io_register_event_callbacks(io, &blocking_callbacks, NULL));
+    lv_display_set_flush_cb(disp, blocking_flush_cb);
+    calls = sim_lvgl_flush_calls(disp);
+    uint64_t blocking_us = run_frames(&frame);
+    CHECK_EQ(sim_lvgl_flush_calls(disp) - calls, strips);
+    check_panel_shows(frame);
+
+    ESP_ERROR_CHECK(display_flush_init(disp, panel, io, false));
+    sim_lcd_reset_stats();
+    calls = sim_lvgl_flush_calls(disp);
+    uint64_t async_us = run_frames(&frame);
+    CHECK_EQ(sim_lvgl_flush_calls(disp) - calls, strips);
+    //Rendering into the second buffer never touched the one still on the wire
+    check_panel_shows(frame);
+
+    display_flush_stats_t flush;
+    display_flush_get_stats(&flush);
+    CHECK_EQ(flush.strips, strips);
+    CHECK_EQ(flush.bytes, strips * (STRIP_BYTES + FLUSH_PLANNER_WINDOW_OVERHEAD_BYTES));
+    sim_lcd_stats_t lcd;
+    sim_lcd_get_stats(&lcd);
+    CHECK_EQ(lcd.color_transfers, strips);
+    CHECK_EQ(lcd.color_bytes, (uint64_t)strips * STRIP_BYTES);
+
+    uint32_t blocking_rate = (uint32_t)(strips * 1000000ULL / blocking_us);
+    uint32_t async_rate = (uint32_t)(strips * 1000000ULL / async_us);
+    printf("partial flush, %d us render per strip: blocking %lu strips/s, async %lu strips/s\n", RENDER_US,
+        (unsigned long)blocking_rate, (unsigned long)async_rate);
+
+    //Blocking pays render and bus time back to back, async is bound by the bus alone
+    CHECK_RANGE(blocking_us, (uint64_t)strips * (RENDER_US + strip_us()), (uint64_t)strips * (RENDER_US + strip_us()) + 1000);
+    CHECK_RANGE(async_us, (uint64_t)strips * strip_us(), (uint64_t)strips * strip_us() + RENDER_US + 1000);
+    CHECK(async_rate * 100 >= blocking_rate * 160);
+}
+
+static void test_wait_for_last_transfer(void)
+{
+    const lv_area_t strip = { 0, 0, BOARD_TFT_WIDTH - 1, STRIP_ROWS - 1 };
+    uint64_t start_us = sim_now_us();
+
+    sim_lvgl_refresh(disp, &strip, 1, 0);
+    CHECK(display_flush_wait(100));
+    CHECK_RANGE(sim_now_us() - start_us, strip_us(), strip_us() + 1000);
+
+    //A timeout shorter than the strip gives up
+    sim_lvgl_refresh(disp, &strip, 1, 0);
+    CHECK(!display_flush_wait(2));
+    CHECK(display_flush_wait(100));
+}
+
+int main(void)
+{
+    sim_init();
+    ESP_ERROR_CHECK(power_profile_init());
+    sim_lcd_create(&io, &panel);
+    disp = lv_display_create(BOARD_TFT_WIDTH, BOARD_TFT_HEIGHT);
+    lv_display_set_buffers(disp, buf1, buf2, sizeof(buf1), LV_DISPLAY_RENDER_MODE_PARTIAL);
+    lv_display_set_user_data(disp, panel);
+
+    RUN_TEST(test_blocking_vs_async);
+    RUN_TEST(test_wait_for_last_transfer);
+    return 0;
+}
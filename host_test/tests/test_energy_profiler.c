@@ -0,0 +1,115 @@
+//Energy profiler on the simulated board: report windows, the fuel gauge baseline and task slot reuse
+#include "host_test.h"
+#include "sim_board.h"
+#include "axp2101.h"
+#include "energy_profiler.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include <string.h>
+#include <unistd.h>
+
+#define TASK_BATCH (ENERGY_PROFILER_MAX_TASKS / 2)
+
+static peripheral_handles_t peripherals;
+
+static void set_percent(uint8_t percent)
+{
+    sim_axp2101_set_battery_percent(percent);
+    ESP_ERROR_CHECK(axp2101_request_battery_percentage());
+    vTaskDelay(pdMS_TO_TICKS(5));
+}
+
+//Every logged report closes its window, the next one starts empty
+static void test_log_starts_new_window(void)
+{
+    energy_report_t report;
+    energy_profiler_reset();
+    vTaskDelay(pdMS_TO_TICKS(60 * 1000));
+    energy_profiler_get_report(&report);
+    CHECK_EQ(report.window_s, 60);
+
+    energy_profiler_log_report();
+    vTaskDelay(pdMS_TO_TICKS(10 * 1000));
+    energy_profiler_get_report(&report);
+    CHECK_EQ(report.window_s, 10);
+}
+
+//A 1% step is not a measurement, the baseline keeps running across reports until the drop is large enough
+static void test_gauge_baseline_spans_windows(void)
+{
+    energy_report_t report;
+    set_percent(80);
+    energy_profiler_reset();
+    vTaskDelay(pdMS_TO_TICKS(60 * 1000));
+    set_percent(79);
+    energy_profiler_get_report(&report);
+    CHECK_EQ(report.measured_ua, 0);
+    energy_profiler_log_report();
+
+    vTaskDelay(pdMS_TO_TICKS(60 * 1000));
+    set_percent(78);
+    energy_profiler_get_report(&report);
+    CHECK_EQ(report.window_s, 60);
+    //2% of the battery over the two minutes since the baseline
+    CHECK_RANGE(report.measured_ua, 2ULL * ENERGY_PROFILER_BATTERY_MAH * 10 * 3600 / 121,
+        2ULL * ENERGY_PROFILER_BATTERY_MAH * 10 * 3600 / 120);
+    energy_profiler_log_report();
+
+    //The measurement restarted the baseline
+    vTaskDelay(pdMS_TO_TICKS(60 * 1000));
+    energy_profiler_get_report(&report);
+    CHECK_EQ(report.measured_ua, 0);
+}
+
+static void idle_task(void *arg)
+{
+    vTaskDelay(portMAX_DELAY);
+}
+
+//Tasks come and go for longer than ENERGY_PROFILER_MAX_TASKS slots last, deleted ones hand theirs back
+static void test_deleted_tasks_free_slots(void)
+{
+    TaskHandle_t handles[TASK_BATCH];
+    char text[1024] = { 0 };
+    FILE *capture = tmpfile();
+    int saved = dup(STDOUT_FILENO);
+    uint8_t round, i;
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    fflush(stdout);
+    dup2(fileno(capture), STDOUT_FILENO);
+    for (round = 0; round < 4; ++round)
+    {
+        for (i = 0; i < TASK_BATCH; ++i)
+        {
+            char name[configMAX_TASK_NAME_LEN];
+            snprintf(name, sizeof(name), "short_%u_%u", round, i);
+            CHECK_EQ(xTaskCreate(idle_task, name, 2048, NULL, 1, &handles[i]), pdPASS);
+        }
+        energy_profiler_log_report();
+        for (i = 0; i < TASK_BATCH; ++i)
+        {
+            vTaskDelete(handles[i]);
+        }
+        energy_profiler_log_report();
+    }
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    rewind(capture);
+    fread(text, 1, sizeof(text) - 1, capture);
+    fclose(capture);
+    CHECK(strstr(text, "No slot for task") == NULL);
+}
+
+int main(void)
+{
+    sim_board_init(&peripherals);
+    ESP_ERROR_CHECK(energy_profiler_init());
+    RUN_TEST(test_log_starts_new_window);
+    RUN_TEST(test_gauge_baseline_spans_windows);
+    RUN_TEST(test_deleted_tasks_free_slots);
+    return 0;
+}
@@ -0,0 +1,217 @@
+//Direct mode windows with and without the flush planner, counted on the simulated SPI link
+#include "host_test.h"
+#include "sim_lcd.h"
+#include "sim_lvgl.h"
+#include "display_flush.h"
+#include "flush_planner.h"
+#include "power_profile.h"
+#include "t_watch_s3.h"
+#include "esp_lcd_panel_ops.h"
+
+#define FRAME_PIXELS (BOARD_TFT_WIDTH * BOARD_TFT_HEIGHT)
+#define SETTLE_US (200000)
+#define RANDOM_FRAMES (200)
+
+static uint16_t framebuffer[FRAME_PIXELS];
+static esp_lcd_panel_io_handle_t io;
+static esp_lcd_panel_handle_t panel;
+static lv_display_t *disp;
+static uint32_t rng = 0x2545F491;
+
+//The power label and all four buttons changing at once, as after a theme change
+static const lv_area_t ui_areas[] = {
+    { 90, 0, 149, 15 },
+    { 3, 20, 117, 119 },
+    { 122, 20, 236, 119 },
+    { 3, 124, 117, 223 },
+    { 122, 124, 236, 223 }
+};
+
+//Before planning: every area on its own, one full-width band or one window per row, whichever is cheaper
+static void unplanned_flush_cb(lv_display_t *d, const lv_area_t *area, uint8_t *px_map)
+{
+    uint16_t *fb = (uint16_t *)px_map;
+    int32_t width = lv_area_get_width(area);
+    int32_t height = lv_area_get_height(area);
+    uint32_t band_bytes = height * BOARD_TFT_WIDTH * sizeof(uint16_t) + FLUSH_PLANNER_WINDOW_OVERHEAD_BYTES;
+    uint32_t span_bytes = height * (width * sizeof(uint16_t) + FLUSH_PLANNER_WINDOW_OVERHEAD_BYTES);
+    int32_t y;
+
+    if (width == BOARD_TFT_WIDTH || band_bytes <= span_bytes)
+    {
+        esp_lcd_panel_draw_bitmap(panel, 0, area->y1 + DISPLAY_FLUSH_ROW_OFFSET, BOARD_TFT_WIDTH,
+            area->y2 + DISPLAY_FLUSH_ROW_OFFSET + 1, &fb[area->y1 * BOARD_TFT_WIDTH]);
+    }
+    else
+    {
+        for (y = area->y1; y <= area->y2; ++y)
+        {
+            esp_lcd_panel_draw_bitmap(panel, area->x1, y + DISPLAY_FLUSH_ROW_OFFSET, area->x2 + 1,
+                y + DISPLAY_FLUSH_ROW_OFFSET + 1, &fb[y * BOARD_TFT_WIDTH + area->x1]);
+        }
+    }
+    lv_display_flush_ready(d);
+}
+
+static void check_panel_matches_framebuffer(void)
+{
+    int32_t x, y;
+    for (y = 0; y < BOARD_TFT_HEIGHT; ++y)
+    {
+        for (x = 0; x < BOARD_TFT_WIDTH; ++x)
+        {
+            CHECK_EQ(sim_lcd_pixel(x, y + DISPLAY_FLUSH_ROW_OFFSET), framebuffer[y * BOARD_TFT_WIDTH + x]);
+        }
+    }
+}
+
+static void frame(const lv_area_t *areas, uint32_t count, sim_lcd_stats_t *stats)
+{
+    sim_lcd_reset_stats();
+    sim_lvgl_refresh(disp, areas, count, 0);
+    sim_sleep_us(SETTLE_US);
+    sim_lcd_get_stats(stats);
+}
+
+static void test_ui_frame_bytes(void)
+{
+    sim_lcd_stats_t before;
+    sim_lcd_stats_t after;
+    const uint32_t count = sizeof(ui_areas) / sizeof(ui_areas[0]);
+
+    lv_display_set_flush_cb(disp, unplanned_flush_cb);
+    frame(ui_areas, count, &before);
+    check_panel_matches_framebuffer();
+
+    ESP_ERROR_CHECK(display_flush_init(disp, panel, io, true));
+    frame(ui_areas, count, &after);
+    check_panel_matches_framebuffer();
+    printf("UI frame: %llu B, %lu transfers, %llu us before planning, %llu B, %lu transfers, %llu us after\n",
+        (unsigned long long)before.wire_bytes, (unsigned long)before.color_transfers, (unsigned long long)before.busy_us,
+        (unsigned long long)after.wire_bytes, (unsigned long)after.color_transfers, (unsigned long long)after.busy_us);
+
+    //The buttons of a row share their rows, so two bands replace 400 row windows and their commands
+    CHECK(after.wire_bytes < before.wire_bytes);
+    CHECK(after.color_transfers * 10 < before.color_transfers);
+    CHECK(after.busy_us < before.busy_us);
+
+    display_flush_stats_t flush;
+    display_flush_get_stats(&flush);
+    CHECK_EQ(flush.strips, 3);
+    flush_planner_get_unplanned_bytes();
+}
+
+static uint32_t next_random(uint32_t range)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng % range;
+}
+
+static void random_area(lv_area_t *area)
+{
+    area->x1 = next_random(BOARD_TFT_WIDTH);
+    area->y1 = next_random(BOARD_TFT_HEIGHT);
+    area->x2 = area->x1 + next_random(BOARD_TFT_WIDTH - area->x1);
+    area->y2 = area->y1 + next_random(LV_MIN(60, BOARD_TFT_HEIGHT - area->y1));
+}
+
+static bool covered(const flush_window_t *windows, uint8_t count, int32_t x, int32_t y)
+{
+    uint8_t i;
+    for (i = 0; i < count; ++i)
+    {
+        const lv_area_t *a = &windows[i].area;
+        if (y < a->y1 || y > a->y2) continue;
+        if (windows[i].band || (x >= a->x1 && x <= a->x2)) return true;
+    }
+    return false;
+}
+
+//Up to twice the window slots of random areas: nothing dirty is dropped, the plan is sorted and never costs more
+static void test_random_plans(void)
+{
+    lv_area_t areas[2 * FLUSH_PLANNER_MAX_WINDOWS];
+    const flush_window_t *windows;
+    uint32_t frame_index;
+    uint8_t count, planned, i;
+    int32_t x, y;
+
+    flush_planner_reset();
+    flush_planner_get_unplanned_bytes();
+    flush_planner_get_planned_bytes();
+    for (frame_index = 0; frame_index < RANDOM_FRAMES; ++frame_index)
+    {
+        count = 1 + next_random(sizeof(areas) / sizeof(areas[0]));
+        for (i = 0; i < count; ++i)
+        {
+            random_area(&areas[i]);
+            flush_planner_add(&areas[i]);
+        }
+        planned = flush_planner_plan(&windows);
+        CHECK_RANGE(planned, 1, FLUSH_PLANNER_MAX_WINDOWS);
+
+        for (i = 0; i < count; ++i)
+        {
+            for (y = areas[i].y1; y <= areas[i].y2; ++y)
+            {
+                for (x = areas[i].x1; x <= areas[i].x2; ++x)
+                {
+                    CHECK(covered(windows, planned, x, y));
+                }
+            }
+        }
+        for (i = 1; i < planned; ++i)
+        {
+            CHECK(windows[i - 1].area.y1 <= windows[i].area.y1);
+        }
+        uint32_t unplanned_bytes = flush_planner_get_unplanned_bytes();
+        uint32_t planned_bytes = flush_planner_get_planned_bytes();
+        //Folding overflow areas into the last slot may cost more, the rest only ever merges to save bytes
+        if (count <= FLUSH_PLANNER_MAX_WINDOWS) CHECK(planned_bytes <= unplanned_bytes);
+        flush_planner_reset();
+    }
+}
+
+//The planner's windows reach the panel as drawn, with the flush reported once the last row is out
+static void test_random_frames_on_panel(void)
+{
+    lv_area_t areas[8];
+    uint32_t frame_index;
+    uint8_t count, i;
+
+    for (frame_index = 0; frame_index < 20; ++frame_index)
+    {
+        count = 1 + next_random(sizeof(areas) / sizeof(areas[0]));
+        for (i = 0; i < count; ++i)
+        {
+            random_area(&areas[i]);
+        }
+        sim_lvgl_refresh(disp, areas, count, 0);
+        sim_lvgl_wait_flushing(disp);
+        CHECK(display_flush_wait(0));
+        check_panel_matches_framebuffer();
+    }
+}
+
+int main(void)
+{
+    sim_init();
+    ESP_ERROR_CHECK(power_profile_init());
+    sim_lcd_create(&io, &panel);
+    disp = lv_display_create(BOARD_TFT_WIDTH, BOARD_TFT_HEIGHT);
+    lv_display_set_buffers(disp, framebuffer, NULL, sizeof(framebuffer), LV_DISPLAY_RENDER_MODE_DIRECT);
+    lv_display_set_user_data(disp, panel);
+
+    //Start from a panel that shows the framebuffer
+    const lv_area_t full_screen = { 0, 0, BOARD_TFT_WIDTH - 1, BOARD_TFT_HEIGHT - 1 };
+    lv_display_set_flush_cb(disp, unplanned_flush_cb);
+    sim_lvgl_refresh(disp, &full_screen, 1, 0);
+    sim_sleep_us(SETTLE_US);
+
+    RUN_TEST(test_ui_frame_bytes);
+    RUN_TEST(test_random_plans);
+    RUN_TEST(test_random_frames_on_panel);
+    return 0;
+}
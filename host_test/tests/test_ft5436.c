@@ -0,0 +1,180 @@
+//FT6x36 touch reads against the FT6336 register model: one burst per report, decoded to 12-bit coordinates
+#include "host_test.h"
+#include "sim_board.h"
+#include "i2c_controller.h"
+#include "ft5436.h"
+#include "t_watch_s3.h"
+
+static peripheral_handles_t peripherals;
+
+static void test_one_burst_per_read(void)
+{
+    ft5436_touch_data_t touch;
+    sim_i2c_reset_counters(&sim_ft6336);
+    sim_ft6336_report(SimTouchDown, 120, 200);
+
+    uint64_t start_us = sim_now_us();
+    CHECK(ft5436_read_touch_data(&touch));
+    //Register pointer out, DEVICE_MODE to P2_MISC back, no separate TD_STATUS read
+    CHECK_EQ(sim_now_us() - start_us, sim_i2c_transfer_us(I2C_FAST_MODE_HZ, 1, FT6X36_TOUCH_DATA_SIZE));
+    CHECK_EQ(sim_ft6336.transactions, 1);
+    CHECK_EQ(sim_ft6336.bytes_written, 1);
+    CHECK_EQ(sim_ft6336.bytes_read, FT6X36_TOUCH_DATA_SIZE);
+    CHECK_EQ(sim_ft6336.reg_reads[FT6X36_REG_DEVICE_MODE], 1);
+    CHECK_EQ(sim_ft6336.reg_reads[FT6X36_REG_P2_MISC], 1);
+    CHECK_EQ(sim_ft6336.reg_reads[FT6X36_REG_P2_MISC + 1], 0);
+
+    CHECK_EQ(touch.count, 1);
+    CHECK_EQ(touch.points[0].x, 120);
+    CHECK_EQ(touch.points[0].y, 200);
+    CHECK_EQ(touch.points[0].event, PressDown);
+    CHECK_EQ(touch.points[0].id, 0);
+    CHECK_EQ(touch.points[0].weight, 0x20);
+    CHECK_EQ(touch.points[0].area, 1);
+}
+
+//The high nibble of XH/YH carries everything past 255, the event and ID bits above it do not leak in
+static void test_twelve_bit_coordinates(void)
+{
+    static const uint16_t coords[][2] = {
+        { 0, 0 }, { 255, 256 }, { 239, 319 }, { 0x123, 0x2F0 }, { 0xFFF, 0xFFF }
+    };
+    ft5436_touch_data_t touch;
+    uint8_t i;
+
+    for (i = 0; i < sizeof(coords) / sizeof(coords[0]); ++i)
+    {
+        sim_ft6336_report(SimTouchContact, coords[i][0], coords[i][1]);
+        CHECK(ft5436_read_touch_data(&touch));
+        CHECK_EQ(touch.points[0].x, coords[i][0]);
+        CHECK_EQ(touch.points[0].y, coords[i][1]);
+        CHECK_EQ(touch.points[0].event, Contact);
+    }
+
+    sim_ft6336_report(SimTouchUp, 0x300, 0x140);
+    CHECK(ft5436_read_touch_data(&touch));
+    CHECK_EQ(touch.count, 0);
+    CHECK_EQ(touch.points[0].event, LiftUp);
+    CHECK_EQ(touch.points[0].x, 0x300);
+    CHECK_EQ(touch.points[0].y, 0x140);
+}
+
+static void test_two_points_and_gesture(void)
+{
+    ft5436_touch_data_t touch;
+    sim_ft6336_set_gesture(FT6X36_GEST_ID_ZOOM_IN);
+    sim_ft6336_report2(20, 300, 0x1AB, 0x10);
+    CHECK(ft5436_read_touch_data(&touch));
+    CHECK_EQ(touch.gesture_id, FT6X36_GEST_ID_ZOOM_IN);
+    CHECK_EQ(touch.count, 2);
+    CHECK_EQ(touch.points[0].x, 20);
+    CHECK_EQ(touch.points[0].y, 300);
+    CHECK_EQ(touch.points[0].id, 0);
+    CHECK_EQ(touch.points[1].x, 0x1AB);
+    CHECK_EQ(touch.points[1].y, 0x10);
+    CHECK_EQ(touch.points[1].id, 1);
+    CHECK_EQ(touch.points[1].event, Contact);
+    sim_ft6336_set_gesture(FT6X36_GEST_ID_NO_GESTURE);
+}
+
+//Thresholds go out as one auto-increment burst, the ID and count come back in two bytes
+static void test_gesture_engine_registers(void)
+{
+    const ft5436_gesture_config_t config = {
+        .radian = 12,
+        .offset_left_right = 30,
+        .offset_up_down = 31,
+        .distance_left_right = 40,
+        .distance_up_down = 41,
+        .distance_zoom = 60
+    };
+    uint8_t gesture_id, count;
+
+    sim_i2c_reset_counters(&sim_ft6336);
+    CHECK_EQ(ft5436_configure_gestures(&config), ESP_OK);
+    CHECK_EQ(sim_ft6336.transactions, 1);
+    CHECK_EQ(sim_ft6336.bytes_written, 1 + 6);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_RADIAN_VALUE], 12);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_OFFSET_LEFT_RIGHT], 30);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_OFFSET_UP_DOWN], 31);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_DISTANCE_LEFT_RIGHT], 40);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_DISTANCE_UP_DOWN], 41);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_DISTANCE_ZOOM], 60);
+
+    sim_ft6336_report2(50, 50, 150, 150);
+    sim_ft6336_set_gesture(FT6X36_GEST_ID_ZOOM_OUT);
+    sim_i2c_reset_counters(&sim_ft6336);
+    uint64_t start_us = sim_now_us();
+    CHECK_EQ(ft5436_read_gesture(&gesture_id, &count), ESP_OK);
+    CHECK_EQ(sim_now_us() - start_us, sim_i2c_transfer_us(I2C_FAST_MODE_HZ, 1, 2));
+    CHECK_EQ(sim_ft6336.bytes_read, 2);
+    CHECK_EQ(gesture_id, FT6X36_GEST_ID_ZOOM_OUT);
+    CHECK_EQ(count, 2);
+    sim_ft6336_set_gesture(FT6X36_GEST_ID_NO_GESTURE);
+}
+
+//TD_STATUS reads 0x0F while the controller has no valid data, and a failed read is no touch either
+static void test_invalid_count_and_failed_read(void)
+{
+    ft5436_touch_data_t touch;
+    sim_ft6336_report(SimTouchDown, 10, 10);
+    sim_ft6336.regs[FT6X36_REG_NUM_TOUCHES] = 0x0F;
+    CHECK(ft5436_read_touch_data(&touch));
+    CHECK_EQ(touch.count, 0);
+
+    sim_ft6336_report(SimTouchDown, 10, 10);
+    sim_ft6336.nack_next = I2C_RETRY_MAX + 1;
+    CHECK(!ft5436_read_touch_data(&touch));
+    CHECK_EQ(touch.count, 0);
+    CHECK_EQ(sim_ft6336.nack_next, 0);
+
+    CHECK(ft5436_read_touch_data(&touch));
+    CHECK_EQ(touch.count, 1);
+}
+
+//Both points are rotated the same way, each point keeps its own coordinates
+static void test_rotation(void)
+{
+    ft5436_touch_data_t touch;
+    ft5436_set_touch_width(BOARD_TFT_WIDTH);
+    ft5436_set_touch_height(BOARD_TFT_HEIGHT);
+    sim_ft6336_report2(10, 20, 200, 230);
+
+    ft5436_set_rotation(1);
+    CHECK(ft5436_read_touch_data(&touch));
+    CHECK_EQ(touch.points[0].x, 20);
+    CHECK_EQ(touch.points[0].y, BOARD_TFT_WIDTH - 10 - 1);
+    CHECK_EQ(touch.points[1].x, 230);
+    CHECK_EQ(touch.points[1].y, BOARD_TFT_WIDTH - 200 - 1);
+
+    ft5436_set_rotation(2);
+    CHECK(ft5436_read_touch_data(&touch));
+    CHECK_EQ(touch.points[0].x, BOARD_TFT_WIDTH - 10 - 1);
+    CHECK_EQ(touch.points[0].y, BOARD_TFT_HEIGHT - 20 - 1);
+    CHECK_EQ(touch.points[1].x, BOARD_TFT_WIDTH - 200 - 1);
+    CHECK_EQ(touch.points[1].y, BOARD_TFT_HEIGHT - 230 - 1);
+
+    ft5436_set_rotation(3);
+    CHECK(ft5436_read_touch_data(&touch));
+    CHECK_EQ(touch.points[0].x, BOARD_TFT_HEIGHT - 20 - 1);
+    CHECK_EQ(touch.points[0].y, 10);
+    CHECK_EQ(touch.points[1].x, BOARD_TFT_HEIGHT - 230 - 1);
+    CHECK_EQ(touch.points[1].y, 200);
+
+    ft5436_set_rotation(0);
+    CHECK(ft5436_read_touch_data(&touch));
+    CHECK_EQ(touch.points[0].x, 10);
+    CHECK_EQ(touch.points[1].y, 230);
+}
+
+int main(void)
+{
+    sim_board_init(&peripherals);
+    RUN_TEST(test_one_burst_per_read);
+    RUN_TEST(test_twelve_bit_coordinates);
+    RUN_TEST(test_two_points_and_gesture);
+    RUN_TEST(test_gesture_engine_registers);
+    RUN_TEST(test_invalid_count_and_failed_read);
+    RUN_TEST(test_rotation);
+    return 0;
+}
@@ -0,0 +1,178 @@
+//Haptic pattern engine against the DRV2605 model: pattern timing from the play log, priorities, dropping and power-down
+#include "host_test.h"
+#include "sim_board.h"
+#include "haptics.h"
+#include "drv2605.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+//Bus time around a start or a stop: the slots, GO and at most one poll in flight
+#define BUS_SLACK_US (2000)
+//Longer than the alarm, the longest pattern
+#define ALARM_WAIT_MS (3000)
+
+static peripheral_handles_t peripherals;
+
+static const sim_drv2605_play_t *last_play(void)
+{
+    return sim_drv2605_play(sim_drv2605_play_count() - 1);
+}
+
+static uint32_t play_ms(const sim_drv2605_play_t *play)
+{
+    return (uint32_t)((play->end_us - play->start_us) / 1000);
+}
+
+//Until the engine has powered the chip down again, so every test starts from the same state
+static void wait_idle(void)
+{
+    while (sim_drv2605_powered()) vTaskDelay(pdMS_TO_TICKS(HAPTICS_POLL_MS));
+}
+
+//The caller only pushes, the pattern starts in the haptics task
+static void test_play_is_one_push(void)
+{
+    uint8_t plays = sim_drv2605_play_count();
+    uint64_t start_us = sim_now_us();
+    CHECK_EQ(haptics_play(HapticPatternClick, HapticPriorityUi), ESP_OK);
+    CHECK_EQ(sim_now_us(), start_us);
+    CHECK_EQ(haptics_play(HapticPatternCount, HapticPriorityUi), ESP_ERR_INVALID_ARG);
+
+    vTaskDelay(pdMS_TO_TICKS(200));
+    CHECK_EQ(sim_drv2605_play_count() - plays, 1);
+    const sim_drv2605_play_t *play = last_play();
+    CHECK_EQ(play->sequence[0], 1);
+    CHECK_EQ(play->sequence[1], DRV2605_WAVESEQ_END);
+    CHECK_EQ(play->library, 1);
+    CHECK(!play->stopped);
+    CHECK_EQ(play_ms(play), sim_drv2605_effect_ms(1));
+    //Rail on, configuration and GO
+    CHECK(play->start_us - start_us < 2 * BUS_SLACK_US);
+    wait_idle();
+}
+
+//Wait slots are part of the sequence, the model's duration matches the eight slots
+static void test_pattern_with_waits(void)
+{
+    CHECK_EQ(haptics_play(HapticPatternAlarm, HapticPriorityAlarm), ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(ALARM_WAIT_MS));
+    const sim_drv2605_play_t *play = last_play();
+    CHECK_EQ(play->sequence[0], 47);
+    CHECK_EQ(play->sequence[1], DRV2605_WAIT_MS(150));
+    CHECK_EQ(play->sequence[7], DRV2605_WAIT_MS(500));
+    CHECK(!play->stopped);
+    CHECK_EQ(play_ms(play), 3 * sim_drv2605_effect_ms(47) + 3 * 150 + sim_drv2605_effect_ms(14) + 500);
+    wait_idle();
+}
+
+//Equal priorities play in order, the next one within a poll period of the end of the last
+static void test_back_to_back(void)
+{
+    uint8_t first = sim_drv2605_play_count();
+    CHECK_EQ(haptics_play(HapticPatternNotify, HapticPriorityNotification), ESP_OK);
+    CHECK_EQ(haptics_play(HapticPatternCharge, HapticPriorityNotification), ESP_OK);
+    CHECK_EQ(haptics_play(HapticPatternDoubleClick, HapticPriorityNotification), ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(1500));
+
+    CHECK_EQ(sim_drv2605_play_count() - first, 3);
+    const uint8_t expected[] = { 24, 52, 10 };
+    uint8_t i;
+    for (i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i)
+    {
+        const sim_drv2605_play_t *play = sim_drv2605_play(first + i);
+        CHECK_EQ(play->sequence[0], expected[i]);
+        CHECK(!play->stopped);
+        CHECK_EQ(play_ms(play), sim_drv2605_sequence_ms(play->sequence));
+        if (i > 0)
+        {
+            uint64_t gap_us = play->start_us - sim_drv2605_play(first + i - 1)->end_us;
+            CHECK(gap_us <= HAPTICS_POLL_MS * 1000 + BUS_SLACK_US);
+        }
+    }
+    CHECK_EQ(play_ms(sim_drv2605_play(first)), 30 + 100 + 30);
+    wait_idle();
+}
+
+//A higher priority stops the one playing at once, a lower one waits for it
+static void test_priority(void)
+{
+    uint8_t first = sim_drv2605_play_count();
+    CHECK_EQ(haptics_play(HapticPatternCharge, HapticPriorityNotification), ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(100));
+    uint64_t alarm_us = sim_now_us();
+    CHECK_EQ(haptics_play(HapticPatternAlarm, HapticPriorityAlarm), ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(50));
+    CHECK_EQ(haptics_play(HapticPatternClick, HapticPriorityUi), ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(ALARM_WAIT_MS));
+
+    CHECK_EQ(sim_drv2605_play_count() - first, 3);
+    const sim_drv2605_play_t *charge = sim_drv2605_play(first);
+    const sim_drv2605_play_t *alarm = sim_drv2605_play(first + 1);
+    const sim_drv2605_play_t *click = sim_drv2605_play(first + 2);
+    CHECK(charge->stopped);
+    CHECK(charge->end_us - alarm_us < BUS_SLACK_US);
+    CHECK(alarm->start_us - charge->end_us < BUS_SLACK_US);
+    CHECK(!alarm->stopped);
+    CHECK_EQ(click->sequence[0], 1);
+    CHECK(click->start_us >= alarm->end_us);
+    CHECK(click->start_us - alarm->end_us <= HAPTICS_POLL_MS * 1000 + BUS_SLACK_US);
+    wait_idle();
+}
+
+//With HAPTICS_PENDING_MAX waiting, a higher priority request pushes out the newest low priority one
+static void test_pending_full(void)
+{
+    uint8_t first = sim_drv2605_play_count();
+    uint8_t i;
+    CHECK_EQ(haptics_play(HapticPatternCharge, HapticPriorityAlarm), ESP_OK);
+    for (i = 0; i < HAPTICS_PENDING_MAX + 1; ++i)
+    {
+        CHECK_EQ(haptics_play(HapticPatternClick, HapticPriorityUi), ESP_OK);
+    }
+    CHECK_EQ(haptics_play(HapticPatternNotify, HapticPriorityNotification), ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(1500));
+
+    CHECK_EQ(sim_drv2605_play_count() - first, 1 + HAPTICS_PENDING_MAX);
+    CHECK_EQ(sim_drv2605_play(first)->sequence[0], 52);
+    CHECK_EQ(sim_drv2605_play(first + 1)->sequence[0], 24);
+    for (i = 2; i < 1 + HAPTICS_PENDING_MAX; ++i)
+    {
+        CHECK_EQ(sim_drv2605_play(first + i)->sequence[0], 1);
+    }
+    wait_idle();
+}
+
+//The rail goes off HAPTICS_POWER_DOWN_MS after the last pattern, the next pattern brings it back
+static void test_power_down(void)
+{
+    uint32_t power_ups = sim_drv2605_power_ups();
+    CHECK_EQ(haptics_play(HapticPatternClick, HapticPriorityUi), ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    CHECK(sim_drv2605_powered());
+    CHECK_EQ(sim_drv2605_power_ups() - power_ups, 1);
+
+    uint64_t end_us = last_play()->end_us;
+    while (sim_drv2605_powered()) vTaskDelay(1);
+    uint64_t off_us = sim_now_us();
+    CHECK(off_us - end_us >= HAPTICS_POWER_DOWN_MS * 1000);
+    CHECK(off_us - end_us <= HAPTICS_POWER_DOWN_MS * 1000 + HAPTICS_POLL_MS * 1000 + BUS_SLACK_US);
+
+    CHECK_EQ(haptics_play(HapticPatternClick, HapticPriorityUi), ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(200));
+    CHECK_EQ(sim_drv2605_power_ups() - power_ups, 2);
+    CHECK(!last_play()->stopped);
+    wait_idle();
+}
+
+int main(void)
+{
+    sim_board_init(&peripherals);
+    ESP_ERROR_CHECK(haptics_init());
+    RUN_TEST(test_play_is_one_push);
+    RUN_TEST(test_pattern_with_waits);
+    RUN_TEST(test_back_to_back);
+    RUN_TEST(test_priority);
+    RUN_TEST(test_pending_full);
+    RUN_TEST(test_power_down);
+    return 0;
+}
@@ -0,0 +1,196 @@
+//Shadow register cache: transactions on the simulated bus for cached, volatile and committed registers
+#include "host_test.h"
+#include "sim_board.h"
+#include "i2c_controller.h"
+#include "axp2101.h"
+#include "drv2605.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static peripheral_handles_t peripherals;
+static i2c_reg_cache_t cache;
+
+static const i2c_reg_range_t volatile_regs[] = {
+    { XPOWERS_AXP2101_BAT_PERCENT_DATA, XPOWERS_AXP2101_BAT_PERCENT_DATA }
+};
+
+//A second cache on the AXP2101's general purpose data buffers, which nothing else in the firmware uses
+static void start(void)
+{
+    i2c_cache_init(&cache, peripherals.axp2101_handle, volatile_regs, sizeof(volatile_regs) / sizeof(volatile_regs[0]));
+    sim_i2c_reset_counters(&sim_axp2101);
+}
+
+static void test_reads(void)
+{
+    uint8_t value;
+    start();
+    sim_axp2101.regs[XPOWERS_AXP2101_DATA_BUFFER1] = 0x5A;
+
+    CHECK_EQ(i2c_cache_read(&cache, XPOWERS_AXP2101_DATA_BUFFER1, &value), ESP_OK);
+    CHECK_EQ(value, 0x5A);
+    CHECK_EQ(i2c_cache_read(&cache, XPOWERS_AXP2101_DATA_BUFFER1, &value), ESP_OK);
+    CHECK_EQ(i2c_cache_read(&cache, XPOWERS_AXP2101_DATA_BUFFER1, &value), ESP_OK);
+    CHECK_EQ(value, 0x5A);
+    CHECK_EQ(sim_axp2101.transactions, 1);
+    CHECK_EQ(cache.bus_reads, 1);
+
+    //Volatile registers always go to the wire and see the device's changes
+    CHECK_EQ(i2c_cache_read(&cache, XPOWERS_AXP2101_BAT_PERCENT_DATA, &value), ESP_OK);
+    sim_axp2101_set_battery_percent(55);
+    CHECK_EQ(i2c_cache_read(&cache, XPOWERS_AXP2101_BAT_PERCENT_DATA, &value), ESP_OK);
+    CHECK_EQ(value, 55);
+    CHECK_EQ(sim_axp2101.transactions, 3);
+
+    i2c_cache_invalidate(&cache);
+    CHECK_EQ(i2c_cache_read(&cache, XPOWERS_AXP2101_DATA_BUFFER1, &value), ESP_OK);
+    CHECK_EQ(sim_axp2101.transactions, 4);
+}
+
+static void test_writes_and_commit(void)
+{
+    uint8_t value;
+    start();
+
+    //Nothing on the wire until the commit, then one burst for the run of four
+    CHECK_EQ(i2c_cache_write(&cache, XPOWERS_AXP2101_DATA_BUFFER1, 1), ESP_OK);
+    CHECK_EQ(i2c_cache_write(&cache, XPOWERS_AXP2101_DATA_BUFFER2, 2), ESP_OK);
+    CHECK_EQ(i2c_cache_write(&cache, XPOWERS_AXP2101_DATA_BUFFER4, 4), ESP_OK);
+    CHECK_EQ(i2c_cache_write(&cache, XPOWERS_AXP2101_DATA_BUFFER3, 3), ESP_OK);
+    CHECK_EQ(i2c_cache_write(&cache, XPOWERS_AXP2101_DATA_BUFFER1, 5), ESP_OK);
+    CHECK_EQ(sim_axp2101.transactions, 0);
+    CHECK_EQ(i2c_cache_commit(&cache), ESP_OK);
+    CHECK_EQ(sim_axp2101.transactions, 1);
+    CHECK_EQ(sim_axp2101.bytes_written, 1 + XPOWERS_AXP2101_DATA_BUFFER_SIZE);
+    CHECK_EQ(sim_axp2101.regs[XPOWERS_AXP2101_DATA_BUFFER1], 5);
+    CHECK_EQ(sim_axp2101.regs[XPOWERS_AXP2101_DATA_BUFFER4], 4);
+
+    //Unchanged values and a second commit cost nothing
+    CHECK_EQ(i2c_cache_write(&cache, XPOWERS_AXP2101_DATA_BUFFER2, 2), ESP_OK);
+    CHECK_EQ(i2c_cache_commit(&cache), ESP_OK);
+    CHECK_EQ(sim_axp2101.transactions, 1);
+
+    //Two separate runs, two bursts
+    CHECK_EQ(i2c_cache_write(&cache, XPOWERS_AXP2101_DATA_BUFFER1, 6), ESP_OK);
+    CHECK_EQ(i2c_cache_write(&cache, XPOWERS_AXP2101_DATA_BUFFER3, 7), ESP_OK);
+    CHECK_EQ(i2c_cache_commit(&cache), ESP_OK);
+    CHECK_EQ(sim_axp2101.transactions, 3);
+    CHECK_EQ(cache.bus_writes, 3);
+
+    //Read-modify-write of a known register needs no read
+    CHECK_EQ(i2c_cache_update_bits(&cache, XPOWERS_AXP2101_DATA_BUFFER2, 0xF0, 0xA0), ESP_OK);
+    CHECK_EQ(i2c_cache_commit(&cache), ESP_OK);
+    CHECK_EQ(sim_axp2101.transactions, 4);
+    CHECK_EQ(sim_axp2101.regs[XPOWERS_AXP2101_DATA_BUFFER2], 0xA2);
+    CHECK_EQ(sim_axp2101.reg_reads[XPOWERS_AXP2101_DATA_BUFFER2], 0);
+    CHECK_EQ(cache.bus_reads, 0);
+
+    //Volatile writes are not deferred
+    CHECK_EQ(i2c_cache_write(&cache, XPOWERS_AXP2101_BAT_PERCENT_DATA, 90), ESP_OK);
+    CHECK_EQ(sim_axp2101.transactions, 5);
+    CHECK_EQ(i2c_cache_read(&cache, XPOWERS_AXP2101_DATA_BUFFER3, &value), ESP_OK);
+    CHECK_EQ(value, 7);
+    CHECK_EQ(sim_axp2101.transactions, 5);
+}
+
+//A failed commit leaves the registers unknown, they are read back before the next change is trusted
+static void test_failed_commit(void)
+{
+    uint8_t value;
+    start();
+    CHECK_EQ(i2c_cache_write(&cache, XPOWERS_AXP2101_DATA_BUFFER1, 0x11), ESP_OK);
+    CHECK_EQ(i2c_cache_write(&cache, XPOWERS_AXP2101_DATA_BUFFER2, 0x22), ESP_OK);
+    CHECK_EQ(i2c_cache_commit(&cache), ESP_OK);
+
+    CHECK_EQ(i2c_cache_write(&cache, XPOWERS_AXP2101_DATA_BUFFER1, 0x33), ESP_OK);
+    sim_axp2101.nack_next = I2C_RETRY_MAX + 1;
+    CHECK_EQ(i2c_cache_commit(&cache), ESP_FAIL);
+    CHECK_EQ(sim_axp2101.regs[XPOWERS_AXP2101_DATA_BUFFER1], 0x11);
+
+    sim_i2c_reset_counters(&sim_axp2101);
+    CHECK_EQ(i2c_cache_read(&cache, XPOWERS_AXP2101_DATA_BUFFER1, &value), ESP_OK);
+    CHECK_EQ(value, 0x11);
+    CHECK_EQ(sim_axp2101.transactions, 1);
+    //The register outside the failed burst is still known
+    CHECK_EQ(i2c_cache_read(&cache, XPOWERS_AXP2101_DATA_BUFFER2, &value), ESP_OK);
+    CHECK_EQ(sim_axp2101.transactions, 1);
+}
+
+//After a power loss every known register is written again, in as few bursts as the map allows
+static void test_restore(void)
+{
+    start();
+    CHECK_EQ(i2c_cache_write(&cache, XPOWERS_AXP2101_DATA_BUFFER1, 0x44), ESP_OK);
+    CHECK_EQ(i2c_cache_write(&cache, XPOWERS_AXP2101_DATA_BUFFER2, 0x55), ESP_OK);
+    CHECK_EQ(i2c_cache_commit(&cache), ESP_OK);
+    sim_axp2101.regs[XPOWERS_AXP2101_DATA_BUFFER1] = 0;
+    sim_axp2101.regs[XPOWERS_AXP2101_DATA_BUFFER2] = 0;
+
+    sim_i2c_reset_counters(&sim_axp2101);
+    i2c_cache_restore(&cache);
+    CHECK_EQ(i2c_cache_commit(&cache), ESP_OK);
+    CHECK_EQ(sim_axp2101.transactions, 1);
+    CHECK_EQ(sim_axp2101.regs[XPOWERS_AXP2101_DATA_BUFFER1], 0x44);
+    CHECK_EQ(sim_axp2101.regs[XPOWERS_AXP2101_DATA_BUFFER2], 0x55);
+}
+
+//The haptic driver: configuration and sequence once per power-up, GO alone for a repeated effect
+static void test_drv2605_transactions(void)
+{
+    const uint8_t click[DRV2605_WAVESEQ_COUNT] = { 1 };
+    const uint8_t buzz[DRV2605_WAVESEQ_COUNT] = { 47 };
+    bool playing;
+
+    sim_i2c_reset_counters(&sim_drv2605);
+    CHECK_EQ(drv2605_load_sequence(click), ESP_OK);
+    CHECK_EQ(sim_drv2605.transactions, 0);
+
+    //MODE on its own, LIBRARY and the eight slots as one burst, then GO
+    CHECK_EQ(drv2605_go(), ESP_OK);
+    CHECK_EQ(sim_drv2605.transactions, 3);
+    CHECK_EQ(sim_drv2605.regs[DRV2605_REG_LIBRARY], 1);
+    CHECK_EQ(sim_drv2605.regs[DRV2605_REG_WAVESEQ1], 1);
+    vTaskDelay(pdMS_TO_TICKS(sim_drv2605_effect_ms(1) + 10));
+    CHECK_EQ(drv2605_is_playing(&playing), ESP_OK);
+    CHECK(!playing);
+    CHECK_EQ(sim_drv2605.transactions, 4);
+
+    sim_i2c_reset_counters(&sim_drv2605);
+    CHECK_EQ(drv2605_load_sequence(click), ESP_OK);
+    CHECK_EQ(drv2605_go(), ESP_OK);
+    CHECK_EQ(sim_drv2605.transactions, 1);
+    CHECK_EQ(sim_drv2605.reg_writes[DRV2605_REG_GO], 1);
+
+    //A different effect changes one slot
+    vTaskDelay(pdMS_TO_TICKS(sim_drv2605_effect_ms(1) + 10));
+    sim_i2c_reset_counters(&sim_drv2605);
+    CHECK_EQ(drv2605_load_sequence(buzz), ESP_OK);
+    CHECK_EQ(sim_drv2605.transactions, 1);
+    CHECK_EQ(sim_drv2605.bytes_written, 2);
+    CHECK_EQ(drv2605_go(), ESP_OK);
+    CHECK_EQ(sim_drv2605.transactions, 2);
+    CHECK_EQ(drv2605_stop(), ESP_OK);
+
+    //The chip forgets everything with its rail, the cache puts it back
+    CHECK_EQ(drv2605_power_down(), ESP_OK);
+    CHECK(!sim_drv2605_powered());
+    sim_i2c_reset_counters(&sim_drv2605);
+    CHECK_EQ(drv2605_load_sequence(buzz), ESP_OK);
+    CHECK_EQ(drv2605_go(), ESP_OK);
+    CHECK_EQ(sim_drv2605.transactions, 3);
+    CHECK_EQ(sim_drv2605.regs[DRV2605_REG_WAVESEQ1], 47);
+    CHECK_EQ(sim_drv2605.regs[DRV2605_REG_MODE], DRV2605_MODE_INTTRIG);
+    CHECK_EQ(drv2605_stop(), ESP_OK);
+    CHECK_EQ(drv2605_power_down(), ESP_OK);
+}
+
+int main(void)
+{
+    sim_board_init(&peripherals);
+    RUN_TEST(test_reads);
+    RUN_TEST(test_writes_and_commit);
+    RUN_TEST(test_failed_commit);
+    RUN_TEST(test_restore);
+    RUN_TEST(test_drv2605_transactions);
+    return 0;
+}
@@ -0,0 +1,219 @@
+//Per-bus I2C job queues: a slow device holds up its own bus only, jobs on one bus finish in order
+#include "host_test.h"
+#include "sim_board.h"
+#include "i2c_controller.h"
+#include "axp2101.h"
+#include "ft5436.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+#define JOBS_MAX (16)
+#define SLOW_US (5000)      //Clock stretching of a PMU busy with an ADC conversion
+
+typedef struct
+{
+    esp_err_t err;
+    uint8_t data[I2C_BURST_MAX];
+    size_t len;
+    uint64_t done_us;
+    const char *task;
+    bool done;
+} job_result_t;
+
+static peripheral_handles_t peripherals;
+static job_result_t results[JOBS_MAX];
+static uint8_t order[JOBS_MAX];
+static uint8_t done_count;
+static sim_event_t isr_event;
+
+static void job_cb(esp_err_t err, const uint8_t *data, size_t len, void *user_data)
+{
+    job_result_t *result = (job_result_t *)user_data;
+    result->err = err;
+    result->len = len;
+    if (data != NULL) memcpy(result->data, data, len);
+    result->done_us = sim_now_us();
+    result->task = pcTaskGetName(NULL);
+    result->done = true;
+    order[done_count++] = (uint8_t)(result - results);
+}
+
+static void reset_results(void)
+{
+    memset(results, 0, sizeof(results));
+    done_count = 0;
+}
+
+static void wait_done(uint8_t count)
+{
+    while (done_count < count) vTaskDelay(1);
+}
+
+//A touch read submitted after a slow PMU read completes in its own bus time, not behind the PMU
+static void test_slow_device_other_bus(void)
+{
+    reset_results();
+    sim_axp2101.latency_us = SLOW_US;
+    sim_ft6336_report(SimTouchDown, 10, 10);
+
+    uint64_t start_us = sim_now_us();
+    CHECK_EQ(i2c_submit_read(peripherals.axp2101_handle, XPOWERS_AXP2101_BAT_PERCENT_DATA, 1, job_cb, &results[0]), ESP_OK);
+    CHECK_EQ(i2c_submit_read(peripherals.ft5436_handle, FT6X36_REG_DEVICE_MODE, FT6X36_TOUCH_DATA_SIZE, job_cb,
+        &results[1]), ESP_OK);
+    //Nothing runs in the caller
+    CHECK(!results[0].done && !results[1].done);
+    wait_done(2);
+
+    CHECK_EQ(order[0], 1);
+    CHECK_EQ(results[1].err, ESP_OK);
+    CHECK_EQ(results[1].len, FT6X36_TOUCH_DATA_SIZE);
+    CHECK_EQ(results[1].data[FT6X36_REG_NUM_TOUCHES], 1);
+    CHECK_EQ(results[1].done_us - start_us, sim_i2c_transfer_us(I2C_FAST_MODE_HZ, 1, FT6X36_TOUCH_DATA_SIZE));
+    CHECK(strcmp(results[1].task, "i2c_touch") == 0);
+
+    CHECK_EQ(results[0].err, ESP_OK);
+    CHECK_EQ(results[0].data[0], sim_axp2101.regs[XPOWERS_AXP2101_BAT_PERCENT_DATA]);
+    CHECK_EQ(results[0].done_us - start_us, sim_i2c_transfer_us(I2C_FAST_MODE_HZ, 1, 1) + SLOW_US);
+    CHECK(strcmp(results[0].task, "i2c_system") == 0);
+    sim_axp2101.latency_us = 0;
+    sim_ft6336_report(SimTouchUp, 10, 10);
+}
+
+//Jobs on one bus run one after another in submission order, each callback right after its transaction
+static void test_same_bus_fifo(void)
+{
+    const uint8_t value = 0x3C;
+    uint8_t i;
+    reset_results();
+    sim_axp2101.regs[XPOWERS_AXP2101_DATA_BUFFER1] = 0;
+    sim_axp2101.latency_us = SLOW_US;
+
+    uint64_t start_us = sim_now_us();
+    for (i = 0; i < 4; ++i)
+    {
+        if (i == 2)
+        {
+            CHECK_EQ(i2c_submit_write(peripherals.axp2101_handle, XPOWERS_AXP2101_DATA_BUFFER1, &value, 1, job_cb,
+                &results[i]), ESP_OK);
+        }
+        else
+        {
+            CHECK_EQ(i2c_submit_read(peripherals.axp2101_handle, XPOWERS_AXP2101_DATA_BUFFER1, 1, job_cb, &results[i]), ESP_OK);
+        }
+    }
+    wait_done(4);
+
+    uint64_t read_us = sim_i2c_transfer_us(I2C_FAST_MODE_HZ, 1, 1) + SLOW_US;
+    uint64_t write_us = sim_i2c_transfer_us(I2C_FAST_MODE_HZ, 2, 0) + SLOW_US;
+    for (i = 0; i < 4; ++i)
+    {
+        CHECK_EQ(order[i], i);
+        CHECK_EQ(results[i].err, ESP_OK);
+    }
+    CHECK_EQ(results[0].done_us - start_us, read_us);
+    CHECK_EQ(results[1].done_us - start_us, 2 * read_us);
+    CHECK_EQ(results[2].done_us - start_us, 2 * read_us + write_us);
+    CHECK_EQ(results[3].done_us - start_us, 3 * read_us + write_us);
+    //Only the read after the write sees it
+    CHECK_EQ(results[1].data[0], results[0].data[0]);
+    CHECK_EQ(results[3].data[0], value);
+    sim_axp2101.latency_us = 0;
+}
+
+//Write data is copied at submission, the caller's buffer may go away
+static void test_write_copies_data(void)
+{
+    uint8_t data[4] = { 1, 2, 3, 4 };
+    reset_results();
+    sim_axp2101.latency_us = SLOW_US;
+    CHECK_EQ(i2c_submit_read(peripherals.axp2101_handle, XPOWERS_AXP2101_DATA_BUFFER1, 1, NULL, NULL), ESP_OK);
+    CHECK_EQ(i2c_submit_write(peripherals.axp2101_handle, XPOWERS_AXP2101_DATA_BUFFER1, data, sizeof(data), job_cb,
+        &results[0]), ESP_OK);
+    memset(data, 0xEE, sizeof(data));
+    wait_done(1);
+    CHECK_EQ(results[0].err, ESP_OK);
+    CHECK_EQ(sim_axp2101.regs[XPOWERS_AXP2101_DATA_BUFFER1], 1);
+    CHECK_EQ(sim_axp2101.regs[XPOWERS_AXP2101_DATA_BUFFER4], 4);
+    sim_axp2101.latency_us = 0;
+}
+
+//The worker takes the first job at once, I2C_JOB_QUEUE_LEN more wait, the next one is refused without blocking
+static void test_queue_full(void)
+{
+    uint8_t i;
+    reset_results();
+    sim_axp2101.latency_us = SLOW_US;
+
+    uint64_t start_us = sim_now_us();
+    for (i = 0; i < I2C_JOB_QUEUE_LEN + 1; ++i)
+    {
+        CHECK_EQ(i2c_submit_read(peripherals.axp2101_handle, XPOWERS_AXP2101_BAT_PERCENT_DATA, 1, job_cb, &results[i]), ESP_OK);
+    }
+    CHECK_EQ(i2c_submit_read(peripherals.axp2101_handle, XPOWERS_AXP2101_BAT_PERCENT_DATA, 1, job_cb, &results[i]),
+        ESP_ERR_NO_MEM);
+    CHECK_EQ(sim_now_us(), start_us);
+    //The touch bus has its own queue
+    CHECK_EQ(i2c_submit_read(peripherals.ft5436_handle, FT6X36_REG_DEVICE_MODE, 2, job_cb, &results[JOBS_MAX - 1]), ESP_OK);
+
+    wait_done(I2C_JOB_QUEUE_LEN + 2);
+    CHECK(!results[I2C_JOB_QUEUE_LEN + 1].done);
+    sim_axp2101.latency_us = 0;
+}
+
+static void test_invalid_jobs(void)
+{
+    uint8_t data[I2C_BURST_MAX + 1] = { 0 };
+    CHECK_EQ(i2c_submit_read(peripherals.axp2101_handle, 0, 0, job_cb, NULL), ESP_ERR_INVALID_SIZE);
+    CHECK_EQ(i2c_submit_read(peripherals.axp2101_handle, 0, I2C_BURST_MAX + 1, job_cb, NULL), ESP_ERR_INVALID_SIZE);
+    CHECK_EQ(i2c_submit_write(peripherals.axp2101_handle, 0, data, sizeof(data), job_cb, NULL), ESP_ERR_INVALID_SIZE);
+    CHECK_EQ(i2c_submit_read((i2c_master_dev_handle_t)&results, 0, 1, job_cb, NULL), ESP_ERR_NOT_FOUND);
+}
+
+//A failed transaction still completes, with the error
+static void test_failed_job(void)
+{
+    reset_results();
+    sim_axp2101.nack_next = I2C_RETRY_MAX + 1;
+    CHECK_EQ(i2c_submit_read(peripherals.axp2101_handle, XPOWERS_AXP2101_BAT_PERCENT_DATA, 1, job_cb, &results[0]), ESP_OK);
+    wait_done(1);
+    CHECK_EQ(results[0].err, ESP_FAIL);
+}
+
+static void touch_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    esp_err_t err = i2c_submit_read_from_isr(peripherals.ft5436_handle, FT6X36_REG_DEVICE_MODE, FT6X36_TOUCH_DATA_SIZE,
+        job_cb, &results[0], &woken);
+    CHECK_EQ(err, ESP_OK);
+    portYIELD_FROM_ISR(woken);
+}
+
+//Straight from the interrupt into the bus worker, no task of its own
+static void test_submit_from_isr(void)
+{
+    reset_results();
+    sim_ft6336_report(SimTouchDown, 0x1F0, 0x0A0);
+    uint64_t irq_us = sim_now_us() + 1000;
+    sim_event_schedule(&isr_event, irq_us, touch_isr, NULL);
+    wait_done(1);
+    CHECK_EQ(results[0].err, ESP_OK);
+    CHECK_EQ(results[0].done_us - irq_us, sim_i2c_transfer_us(I2C_FAST_MODE_HZ, 1, FT6X36_TOUCH_DATA_SIZE));
+    CHECK_EQ(results[0].data[FT6X36_REG_P1_XH] & FT6X36_MSB_MASK, 0x1);
+    CHECK_EQ(results[0].data[FT6X36_REG_P1_XL], 0xF0);
+    CHECK(strcmp(results[0].task, "i2c_touch") == 0);
+    sim_ft6336_report(SimTouchUp, 0, 0);
+}
+
+int main(void)
+{
+    sim_board_init(&peripherals);
+    RUN_TEST(test_slow_device_other_bus);
+    RUN_TEST(test_same_bus_fifo);
+    RUN_TEST(test_write_copies_data);
+    RUN_TEST(test_queue_full);
+    RUN_TEST(test_invalid_jobs);
+    RUN_TEST(test_failed_job);
+    RUN_TEST(test_submit_from_isr);
+    return 0;
+}
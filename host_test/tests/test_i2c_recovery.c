@@ -0,0 +1,165 @@
+//Fault injection on the simulated buses: every failure ends within its bound, a held SDA line is cleared and counted
+#include "host_test.h"
+#include "sim_board.h"
+#include "i2c_controller.h"
+#include "axp2101.h"
+#include "ft5436.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static peripheral_handles_t peripherals;
+static volatile bool job_done;
+static volatile esp_err_t job_err;
+
+//Address byte only, the slave did not acknowledge
+static uint32_t nack_us(void)
+{
+    return sim_i2c_transfer_us(I2C_FAST_MODE_HZ, 0, 0);
+}
+
+static uint32_t read_us(void)
+{
+    return sim_i2c_transfer_us(I2C_FAST_MODE_HZ, 1, 1);
+}
+
+static void stats_delta(const i2c_device_stats_t *before, i2c_device_stats_t *delta)
+{
+    i2c_device_stats_t after;
+    ESP_ERROR_CHECK(i2c_get_device_stats(peripherals.axp2101_handle, &after));
+    delta->transactions = after.transactions - before->transactions;
+    delta->errors = after.errors - before->errors;
+    delta->retries = after.retries - before->retries;
+    delta->recoveries = after.recoveries - before->recoveries;
+    delta->failures = after.failures - before->failures;
+}
+
+//Each retry waits twice as long as the one before
+static void test_nack_backoff(void)
+{
+    i2c_device_stats_t before;
+    i2c_device_stats_t delta;
+    uint8_t value;
+
+    ESP_ERROR_CHECK(i2c_get_device_stats(peripherals.axp2101_handle, &before));
+    sim_axp2101.nack_next = 2;
+    uint64_t start_us = sim_now_us();
+    CHECK_EQ(i2c_read_register(peripherals.axp2101_handle, XPOWERS_AXP2101_IC_TYPE, &value), ESP_OK);
+    CHECK_EQ(sim_now_us() - start_us, 2 * nack_us() + I2C_RETRY_BACKOFF_MS * 1000 + 2 * I2C_RETRY_BACKOFF_MS * 1000 +
+        read_us());
+    stats_delta(&before, &delta);
+    CHECK_EQ(delta.transactions, 3);
+    CHECK_EQ(delta.errors, 2);
+    CHECK_EQ(delta.retries, 2);
+    CHECK_EQ(delta.recoveries, 0);
+    CHECK_EQ(delta.failures, 0);
+}
+
+//SDA held through every attempt: the attempts split one deadline, so the caller gets the timeout
+//no later than the deadline plus the last bus clear
+static void test_worst_case_bound(void)
+{
+    i2c_device_stats_t before;
+    i2c_device_stats_t delta;
+    sim_i2c_bus_stats_t bus_before;
+    sim_i2c_bus_stats_t bus_after;
+    uint8_t value;
+
+    ESP_ERROR_CHECK(i2c_get_device_stats(peripherals.axp2101_handle, &before));
+    sim_i2c_get_bus_stats(I2C_NUM_1, &bus_before);
+    sim_axp2101.hold_sda_next = I2C_RETRY_MAX + 1;
+    uint64_t start_us = sim_now_us();
+    CHECK_EQ(i2c_read_register(peripherals.axp2101_handle, XPOWERS_AXP2101_IC_TYPE, &value), ESP_ERR_TIMEOUT);
+    uint64_t stall_us = sim_now_us() - start_us;
+    printf("worst case stall with SDA held: %llu us\n", (unsigned long long)stall_us);
+    CHECK(stall_us <= I2C_DEFAULT_TIMEOUT_MS * 1000 + SIM_I2C_BUS_RESET_US);
+
+    stats_delta(&before, &delta);
+    CHECK_EQ(delta.errors, I2C_RETRY_MAX + 1);
+    CHECK_EQ(delta.recoveries, I2C_RETRY_MAX + 1);
+    CHECK_EQ(delta.failures, 1);
+    sim_i2c_get_bus_stats(I2C_NUM_1, &bus_after);
+    CHECK_EQ(bus_after.resets - bus_before.resets, I2C_RETRY_MAX + 1);
+    CHECK_EQ(bus_after.timeouts - bus_before.timeouts, I2C_RETRY_MAX + 1);
+
+    //The last clear freed the bus, the next transaction is a normal one
+    start_us = sim_now_us();
+    CHECK_EQ(i2c_read_register(peripherals.axp2101_handle, XPOWERS_AXP2101_IC_TYPE, &value), ESP_OK);
+    CHECK_EQ(sim_now_us() - start_us, read_us());
+    CHECK_EQ(value, XPOWERS_AXP2101_CHIP_ID);
+
+    i2c_device_stats_t stats;
+    ESP_ERROR_CHECK(i2c_get_device_stats(peripherals.axp2101_handle, &stats));
+    CHECK(stats.latency_max_us >= I2C_DEFAULT_TIMEOUT_MS / (I2C_RETRY_MAX + 1) * 1000);
+}
+
+//A shorter deadline gives each attempt a shorter share
+static void test_device_timeout(void)
+{
+    uint8_t value;
+    i2c_set_device_timeout(peripherals.axp2101_handle, 5);
+    sim_axp2101.hold_sda_next = 1;
+    uint64_t start_us = sim_now_us();
+    CHECK_EQ(i2c_read_register(peripherals.axp2101_handle, XPOWERS_AXP2101_IC_TYPE, &value), ESP_OK);
+    CHECK_EQ(sim_now_us() - start_us, 5 / (I2C_RETRY_MAX + 1) * 1000 + SIM_I2C_BUS_RESET_US + I2C_RETRY_BACKOFF_MS * 1000 + read_us());
+    i2c_set_device_timeout(peripherals.axp2101_handle, I2C_DEFAULT_TIMEOUT_MS);
+}
+
+//The PMU stalls its own bus only, the touch controller keeps its read time throughout
+static void job_cb(esp_err_t err, const uint8_t *data, size_t len, void *user_data)
+{
+    job_err = err;
+    job_done = true;
+}
+
+static void test_stall_stays_on_its_bus(void)
+{
+    ft5436_touch_data_t touch;
+    uint32_t reads = 0;
+
+    job_done = false;
+    sim_axp2101.hold_sda_next = I2C_RETRY_MAX + 1;
+    CHECK_EQ(i2c_submit_read(peripherals.axp2101_handle, XPOWERS_AXP2101_IC_TYPE, 1, job_cb, NULL), ESP_OK);
+    sim_ft6336_report(SimTouchContact, 100, 100);
+    while (!job_done)
+    {
+        uint64_t start_us = sim_now_us();
+        CHECK(ft5436_read_touch_data(&touch));
+        CHECK_EQ(sim_now_us() - start_us, sim_i2c_transfer_us(I2C_FAST_MODE_HZ, 1, FT6X36_TOUCH_DATA_SIZE));
+        CHECK_EQ(touch.points[0].x, 100);
+        reads++;
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    CHECK_EQ(job_err, ESP_ERR_TIMEOUT);
+    CHECK(reads >= 3);
+    sim_ft6336_report(SimTouchUp, 100, 100);
+}
+
+//A device that is gone fails fast, no bus clear for a NACK
+static void test_absent_device(void)
+{
+    i2c_device_stats_t before;
+    i2c_device_stats_t delta;
+    uint8_t value;
+
+    ESP_ERROR_CHECK(i2c_get_device_stats(peripherals.axp2101_handle, &before));
+    sim_axp2101.absent = true;
+    uint64_t start_us = sim_now_us();
+    CHECK_EQ(i2c_read_register(peripherals.axp2101_handle, XPOWERS_AXP2101_IC_TYPE, &value), ESP_FAIL);
+    CHECK_EQ(sim_now_us() - start_us, (I2C_RETRY_MAX + 1) * nack_us() + (1 + 2) * I2C_RETRY_BACKOFF_MS * 1000);
+    sim_axp2101.absent = false;
+    stats_delta(&before, &delta);
+    CHECK_EQ(delta.recoveries, 0);
+    CHECK_EQ(delta.failures, 1);
+}
+
+int main(void)
+{
+    sim_board_init(&peripherals);
+    RUN_TEST(test_nack_backoff);
+    RUN_TEST(test_worst_case_bound);
+    RUN_TEST(test_device_timeout);
+    RUN_TEST(test_stall_stays_on_its_bus);
+    RUN_TEST(test_absent_device);
+    return 0;
+}
@@ -0,0 +1,131 @@
+//The simulated buses and device models themselves, with the real I2C controller and drivers on top
+#include "host_test.h"
+#include "sim_board.h"
+#include "i2c_controller.h"
+#include "axp2101.h"
+#include "ft5436.h"
+#include "drv2605.h"
+#include "t_watch_s3.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static peripheral_handles_t peripherals;
+
+static void test_init_tables_reach_devices(void)
+{
+    CHECK_EQ(sim_axp2101.regs[XPOWERS_AXP2101_INTEN1], AXP2101_IRQ_ENABLED & 0xFF);
+    CHECK_EQ(sim_axp2101.regs[XPOWERS_AXP2101_INTEN2], (AXP2101_IRQ_ENABLED >> 8) & 0xFF);
+    CHECK_EQ(sim_axp2101.regs[XPOWERS_AXP2101_INTEN3], (AXP2101_IRQ_ENABLED >> 16) & 0xFF);
+    CHECK_EQ(sim_axp2101.regs[XPOWERS_AXP2101_ADC_CHANNEL_CTRL], 0x1D);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_THRESHHOLD], FT6X36_DEFAULT_THRESHOLD);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_INTERRUPT_MODE], FT6X36_INT_MODE_TRIGGER);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_TOUCHRATE_ACTIVE], 0x0E);
+    CHECK_EQ(sim_ft6336.nacks, 0);
+    CHECK_EQ(sim_axp2101.nacks, 0);
+    //The haptic rail stays off until the first effect, so the driver never touches the chip
+    CHECK(!sim_drv2605_powered());
+    CHECK_EQ(sim_drv2605.transactions + sim_drv2605.nacks, 0);
+    //Boot left no interrupt pending
+    CHECK_EQ(gpio_get_level(BOARD_PMU_INT), 1);
+}
+
+static void test_transaction_time(void)
+{
+    uint8_t value;
+    uint64_t start_us = sim_now_us();
+    CHECK_EQ(i2c_read_register(peripherals.axp2101_handle, XPOWERS_AXP2101_BAT_PERCENT_DATA, &value), ESP_OK);
+    CHECK_EQ(sim_now_us() - start_us, sim_i2c_transfer_us(I2C_FAST_MODE_HZ, 1, 1));
+    CHECK_EQ(value, 80);
+
+    sim_axp2101.latency_us = 500;
+    start_us = sim_now_us();
+    CHECK_EQ(i2c_read_register(peripherals.axp2101_handle, XPOWERS_AXP2101_BAT_PERCENT_DATA, &value), ESP_OK);
+    CHECK_EQ(sim_now_us() - start_us, sim_i2c_transfer_us(I2C_FAST_MODE_HZ, 1, 1) + 500);
+    sim_axp2101.latency_us = 0;
+}
+
+static void test_nack_is_retried(void)
+{
+    i2c_device_stats_t before;
+    i2c_device_stats_t after;
+    uint8_t value;
+
+    ESP_ERROR_CHECK(i2c_get_device_stats(peripherals.axp2101_handle, &before));
+    sim_axp2101.nack_next = 1;
+    CHECK_EQ(i2c_read_register(peripherals.axp2101_handle, XPOWERS_AXP2101_IC_TYPE, &value), ESP_OK);
+    CHECK_EQ(value, XPOWERS_AXP2101_CHIP_ID);
+    ESP_ERROR_CHECK(i2c_get_device_stats(peripherals.axp2101_handle, &after));
+    CHECK_EQ(after.errors - before.errors, 1);
+    CHECK_EQ(after.retries - before.retries, 1);
+    CHECK_EQ(after.failures, before.failures);
+
+    sim_axp2101.nack_next = I2C_RETRY_MAX + 1;
+    CHECK_EQ(i2c_read_register(peripherals.axp2101_handle, XPOWERS_AXP2101_IC_TYPE, &value), ESP_FAIL);
+    ESP_ERROR_CHECK(i2c_get_device_stats(peripherals.axp2101_handle, &after));
+    CHECK_EQ(after.failures - before.failures, 1);
+    CHECK_EQ(sim_axp2101.nack_next, 0);
+}
+
+static void test_held_sda_is_cleared(void)
+{
+    sim_i2c_bus_stats_t before;
+    sim_i2c_bus_stats_t after;
+    uint8_t value;
+
+    sim_i2c_get_bus_stats(I2C_NUM_1, &before);
+    sim_axp2101.hold_sda_next = 1;
+    uint64_t start_us = sim_now_us();
+    CHECK_EQ(i2c_read_register(peripherals.axp2101_handle, XPOWERS_AXP2101_IC_TYPE, &value), ESP_OK);
+    sim_i2c_get_bus_stats(I2C_NUM_1, &after);
+    CHECK_EQ(after.resets - before.resets, 1);
+    CHECK_EQ(after.timeouts - before.timeouts, 1);
+    //A third of the deadline, the clear-bus pulses, the backoff and the good transaction, all inside the deadline
+    CHECK(sim_now_us() - start_us >= I2C_DEFAULT_TIMEOUT_MS / (I2C_RETRY_MAX + 1) * 1000);
+    CHECK(sim_now_us() - start_us < I2C_DEFAULT_TIMEOUT_MS * 1000);
+}
+
+static void test_scripted_register_change(void)
+{
+    uint8_t value;
+    sim_i2c_script_write(&sim_axp2101, 5000, XPOWERS_AXP2101_BAT_PERCENT_DATA, 42);
+    CHECK_EQ(i2c_read_register(peripherals.axp2101_handle, XPOWERS_AXP2101_BAT_PERCENT_DATA, &value), ESP_OK);
+    CHECK_EQ(value, 80);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    CHECK_EQ(i2c_read_register(peripherals.axp2101_handle, XPOWERS_AXP2101_BAT_PERCENT_DATA, &value), ESP_OK);
+    CHECK_EQ(value, 42);
+
+    //A scripted status bit pulls INT low like a real event
+    sim_i2c_script_write(&sim_axp2101, 1000, XPOWERS_AXP2101_INTSTS2, AXP2101_IRQ_PKEY_SHORT >> 8);
+    CHECK_EQ(gpio_get_level(BOARD_PMU_INT), 1);
+    vTaskDelay(pdMS_TO_TICKS(2));
+    CHECK_EQ(gpio_get_level(BOARD_PMU_INT), 0);
+    CHECK_EQ(i2c_write_register(peripherals.axp2101_handle, XPOWERS_AXP2101_INTSTS2, AXP2101_IRQ_PKEY_SHORT >> 8), ESP_OK);
+    CHECK_EQ(gpio_get_level(BOARD_PMU_INT), 1);
+}
+
+static void test_haptic_rail_powers_drv2605(void)
+{
+    uint8_t value;
+    CHECK_EQ(i2c_read_register(peripherals.drv2605_handle, DRV2605_REG_STATUS, &value), ESP_FAIL);
+
+    ESP_ERROR_CHECK(axp2101_rail_acquire(Axp2101RailHaptic, NULL));
+    CHECK(sim_drv2605_powered());
+    CHECK_EQ(i2c_read_register(peripherals.drv2605_handle, DRV2605_REG_STATUS, &value), ESP_OK);
+    CHECK_EQ(value >> 5, DRV2605L_CHIP_ID);
+
+    ESP_ERROR_CHECK(axp2101_rail_release(Axp2101RailHaptic));
+    CHECK(!sim_drv2605_powered());
+    CHECK_EQ(sim_axp2101_ldo_switches(AXP2101_LDO_BLDO2), 2);
+}
+
+int main(void)
+{
+    sim_board_init(&peripherals);
+    RUN_TEST(test_init_tables_reach_devices);
+    RUN_TEST(test_transaction_time);
+    RUN_TEST(test_nack_is_retried);
+    RUN_TEST(test_held_sda_is_cleared);
+    RUN_TEST(test_scripted_register_change);
+    RUN_TEST(test_haptic_rail_powers_drv2605);
+    return 0;
+}
@@ -0,0 +1,162 @@
+//LVGL task events on their own notification index, next to LVGL's lv_thread_sync_wait on index 0
+#include "host_test.h"
+#include "lvgl_notify.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define LVGL_TASK_PRIORITY (2)
+#define LVGL_TIMER_PERIOD_MS (1000)
+#define IDLE_SECONDS (10)
+
+static TaskHandle_t lvgl_task;
+static volatile bool done;
+static volatile uint64_t sync_returned_us;
+static volatile uint32_t sync_value;
+static volatile uint64_t wait_returned_us;
+static volatile uint32_t wait_bits;
+static volatile bool wait_woken;
+static volatile uint32_t wakeups;
+static volatile uint32_t bits_seen;
+static sim_event_t isr_event;
+
+static void touch_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    lvgl_notify_from_isr((uint32_t)(uintptr_t)arg, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+//Charger and power key status read in one I2C job, both bits are set before the LVGL task runs
+static void burst_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    lvgl_notify_from_isr(LVGL_NOTIFY_TIMER, &woken);
+    lvgl_notify_from_isr(LVGL_NOTIFY_WAKE, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void start_lvgl_task(TaskFunction_t fn)
+{
+    done = false;
+    xTaskCreatePinnedToCore(fn, "lvgl", 4096, NULL, LVGL_TASK_PRIORITY, &lvgl_task, 1);
+    lvgl_notify_init(lvgl_task);
+}
+
+static void stop_lvgl_task(void)
+{
+    while (!done) vTaskDelay(1);
+    lvgl_notify_init(NULL);
+}
+
+//Rendering with a draw unit blocks in lv_thread_sync_wait, the events that arrive meanwhile wait for the next loop
+static void sync_then_wait_task(void *arg)
+{
+    uint32_t bits;
+    sync_value = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    sync_returned_us = sim_now_us();
+    wait_woken = lvgl_notify_wait(LVGL_TIMER_PERIOD_MS, &bits);
+    wait_bits = bits;
+    wait_returned_us = sim_now_us();
+
+    //A draw unit finishing while the task waits for events is not an event
+    wait_woken = lvgl_notify_wait(LVGL_TIMER_PERIOD_MS, &bits);
+    wait_bits = bits;
+    wait_returned_us = sim_now_us();
+    done = true;
+    vTaskDelete(NULL);
+}
+
+static void test_events_do_not_end_lvgl_sync(void)
+{
+    start_lvgl_task(sync_then_wait_task);
+    vTaskDelay(pdMS_TO_TICKS(1));
+    sim_event_schedule(&isr_event, sim_now_us() + 1000, touch_isr, (void *)(uintptr_t)LVGL_NOTIFY_TOUCH);
+    lvgl_notify(LVGL_NOTIFY_TIMER);
+    vTaskDelay(pdMS_TO_TICKS(5));
+    CHECK_EQ(sync_returned_us, 0);
+
+    //The draw unit signals the end of its task
+    uint64_t give_us = sim_now_us();
+    xTaskNotifyGive(lvgl_task);
+    vTaskDelay(pdMS_TO_TICKS(1));
+    CHECK_EQ(sync_value, 1);
+    CHECK_EQ(sync_returned_us, give_us);
+    //Nothing was lost, both events are there once the task asks
+    CHECK(wait_woken);
+    CHECK_EQ(wait_bits, LVGL_NOTIFY_TOUCH | LVGL_NOTIFY_TIMER);
+    CHECK_EQ(wait_returned_us, give_us);
+
+    vTaskDelay(pdMS_TO_TICKS(10));
+    xTaskNotifyGive(lvgl_task);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    CHECK(!done);
+    stop_lvgl_task();
+    CHECK(!wait_woken);
+    CHECK_EQ(wait_bits, 0);
+    CHECK_EQ(wait_returned_us, give_us + LVGL_TIMER_PERIOD_MS * 1000);
+}
+
+//lvgl_port_task with only the one second UI timer left: one wakeup per period, none in between
+static void idle_task(void *arg)
+{
+    uint32_t bits;
+    uint64_t end_us = sim_now_us() + IDLE_SECONDS * 1000000ULL;
+    lvgl_notify_get_wakeups();
+    while (sim_now_us() < end_us)
+    {
+        lvgl_notify_wait(LVGL_TIMER_PERIOD_MS, &bits);
+        bits_seen |= bits;
+    }
+    wakeups = lvgl_notify_get_wakeups();
+    done = true;
+    vTaskDelete(NULL);
+}
+
+static void test_idle_wakeups(void)
+{
+    bits_seen = 0;
+    start_lvgl_task(idle_task);
+    stop_lvgl_task();
+    CHECK_EQ(wakeups, IDLE_SECONDS);
+    CHECK_EQ(bits_seen, 0);
+}
+
+//Screen off: no timer at all, only events wake the task and a burst of them costs one wakeup
+static void event_task(void *arg)
+{
+    uint32_t bits;
+    lvgl_notify_get_wakeups();
+    while ((bits_seen & LVGL_NOTIFY_WAKE) == 0)
+    {
+        lvgl_notify_wait(portMAX_DELAY, &bits);
+        bits_seen |= bits;
+    }
+    wakeups = lvgl_notify_get_wakeups();
+    done = true;
+    vTaskDelete(NULL);
+}
+
+static void test_event_wakeups(void)
+{
+    bits_seen = 0;
+    start_lvgl_task(event_task);
+    vTaskDelay(pdMS_TO_TICKS(100));
+
+    lvgl_notify(LVGL_NOTIFY_PMU);
+    vTaskDelay(pdMS_TO_TICKS(100));
+    CHECK_EQ(bits_seen, LVGL_NOTIFY_PMU);
+
+    sim_event_schedule(&isr_event, sim_now_us() + 1000, burst_isr, NULL);
+    stop_lvgl_task();
+    CHECK_EQ(bits_seen, LVGL_NOTIFY_PMU | LVGL_NOTIFY_TIMER | LVGL_NOTIFY_WAKE);
+    CHECK_EQ(wakeups, 2);
+}
+
+int main(void)
+{
+    sim_init();
+    RUN_TEST(test_events_do_not_end_lvgl_sync);
+    RUN_TEST(test_idle_wakeups);
+    RUN_TEST(test_event_wakeups);
+    return 0;
+}
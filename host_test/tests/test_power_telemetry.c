@@ -0,0 +1,151 @@
+//Power telemetry against the PMU model: ADC decoding, sample period per charge state, history averaging and the log line
+#include "host_test.h"
+#include "sim_board.h"
+#include "axp2101.h"
+#include "power_telemetry.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include <string.h>
+#include <unistd.h>
+
+#define TEMP_RAW_32C (7074)
+#define TEMP_RAW_MINUS_0C5 (7724)
+
+static peripheral_handles_t peripherals;
+
+static uint32_t adc_reads(void)
+{
+    return sim_axp2101.reg_reads[XPOWERS_AXP2101_ADC_DATA_RELUST0];
+}
+
+static void sample(void)
+{
+    power_telemetry_sample_now();
+    vTaskDelay(pdMS_TO_TICKS(5));
+}
+
+static void test_adc_decoding(void)
+{
+    power_sample_t latest;
+    CHECK_EQ(power_telemetry_get_latest(&latest), ESP_OK);
+    CHECK_EQ(latest.battery_mv, 3900);
+    CHECK_EQ(latest.system_mv, 3850);
+    CHECK_EQ(latest.vbus_mv, 0);
+    CHECK_EQ(latest.die_temp_dc, 320);
+    CHECK_EQ(latest.flags, 0);
+
+    sim_axp2101_set_adc(4012, 5010, 4950, TEMP_RAW_MINUS_0C5);
+    sample();
+    CHECK_EQ(power_telemetry_get_latest(&latest), ESP_OK);
+    CHECK_EQ(latest.battery_mv, 4012);
+    CHECK_EQ(latest.system_mv, 4950);
+    //No VBUS_GOOD, the reading is leakage
+    CHECK_EQ(latest.vbus_mv, 0);
+    CHECK_EQ(latest.die_temp_dc, -5);
+}
+
+//Every minute on battery, every ten seconds while charging
+static void test_period_follows_vbus(void)
+{
+    uint32_t reads = adc_reads();
+    vTaskDelay(pdMS_TO_TICKS(3 * POWER_TELEMETRY_PERIOD_BATTERY_MS + 5));
+    CHECK_EQ(adc_reads() - reads, 3);
+
+    sim_axp2101_set_vbus(true);
+    vTaskDelay(pdMS_TO_TICKS(5));
+    CHECK(axp2101_is_vbus_present());
+    sample();
+    reads = adc_reads();
+    vTaskDelay(pdMS_TO_TICKS(6 * POWER_TELEMETRY_PERIOD_CHARGING_MS));
+    CHECK_EQ(adc_reads() - reads, 6);
+
+    power_sample_t latest;
+    CHECK_EQ(power_telemetry_get_latest(&latest), ESP_OK);
+    CHECK_EQ(latest.vbus_mv, 5010);
+    CHECK_EQ(latest.flags, POWER_TELEMETRY_FLAG_VBUS);
+
+    sim_axp2101_set_vbus(false);
+    vTaskDelay(pdMS_TO_TICKS(5));
+    sample();
+    reads = adc_reads();
+    vTaskDelay(pdMS_TO_TICKS(POWER_TELEMETRY_PERIOD_BATTERY_MS - 5));
+    CHECK_EQ(adc_reads() - reads, 0);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    CHECK_EQ(adc_reads() - reads, 1);
+}
+
+//One entry per POWER_TELEMETRY_DOWNSAMPLE samples, averaged, with a flag seen in any of them
+static void test_history_averaging(void)
+{
+    power_sample_t history[POWER_TELEMETRY_HISTORY_SIZE];
+    size_t before = power_telemetry_get_history(history, POWER_TELEMETRY_HISTORY_SIZE);
+    uint32_t i;
+
+    //Finish the entry in progress so the next one starts clean
+    while (power_telemetry_get_history(history, POWER_TELEMETRY_HISTORY_SIZE) == before) sample();
+    before++;
+
+    for (i = 0; i < POWER_TELEMETRY_DOWNSAMPLE; ++i)
+    {
+        sim_axp2101_set_adc(3700 + 10 * i, 5000, 3600, TEMP_RAW_32C);
+        if (i == 1)
+        {
+            sim_axp2101_set_vbus(true);
+            vTaskDelay(pdMS_TO_TICKS(5));
+        }
+        if (i == 2)
+        {
+            sim_axp2101_set_vbus(false);
+            vTaskDelay(pdMS_TO_TICKS(5));
+        }
+        sample();
+    }
+    CHECK_EQ(power_telemetry_get_history(history, POWER_TELEMETRY_HISTORY_SIZE), before + 1);
+    const power_sample_t *entry = &history[before];
+    CHECK_EQ(entry->battery_mv, 3720);
+    CHECK_EQ(entry->vbus_mv, 5000 / POWER_TELEMETRY_DOWNSAMPLE);
+    CHECK_EQ(entry->die_temp_dc, 320);
+    CHECK_EQ(entry->flags, POWER_TELEMETRY_FLAG_VBUS);
+    CHECK_EQ(entry->time_s, sim_now_us() / 1000000);
+
+    //A shorter copy keeps the newest entries
+    CHECK_EQ(power_telemetry_get_history(history, 1), 1);
+    CHECK_EQ(history[0].battery_mv, entry->battery_mv);
+}
+
+//Temperatures just below zero keep their sign in the debug line
+static void test_log_below_zero(void)
+{
+    char text[512] = { 0 };
+    FILE *capture = tmpfile();
+    int saved = dup(STDOUT_FILENO);
+
+    esp_log_level_set("*", ESP_LOG_DEBUG);
+    sim_axp2101_set_adc(3700, 0, 3600, TEMP_RAW_MINUS_0C5);
+    fflush(stdout);
+    dup2(fileno(capture), STDOUT_FILENO);
+    sample();
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    rewind(capture);
+    fread(text, 1, sizeof(text) - 1, capture);
+    fclose(capture);
+    CHECK(strstr(text, "die -0.5 C") != NULL);
+}
+
+int main(void)
+{
+    sim_board_init(&peripherals);
+    ESP_ERROR_CHECK(axp2101_irq_init(NULL, NULL));
+    ESP_ERROR_CHECK(power_telemetry_init());
+    vTaskDelay(pdMS_TO_TICKS(5));
+    RUN_TEST(test_adc_decoding);
+    RUN_TEST(test_period_follows_vbus);
+    RUN_TEST(test_history_averaging);
+    RUN_TEST(test_log_below_zero);
+    return 0;
+}
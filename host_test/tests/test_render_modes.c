@@ -0,0 +1,141 @@
+//Partial strips versus the direct mode framebuffer: render passes, bytes on the SPI link and RAM for typical updates
+#include "host_test.h"
+#include "sim_lcd.h"
+#include "sim_lvgl.h"
+#include "display_flush.h"
+#include "power_profile.h"
+#include "t_watch_s3.h"
+
+#define STRIP_PIXELS (BOARD_TFT_WIDTH * BOARD_TFT_HEIGHT / 10)
+#define FRAME_PIXELS (BOARD_TFT_WIDTH * BOARD_TFT_HEIGHT)
+#define RENDER_US (2000)    //Walking the widget tree once, per render pass
+#define WINDOW_COMMAND_BYTES (11) //CASET and RASET with their parameters, RAMWR
+
+typedef struct
+{
+    const char *name;
+    lv_area_t area;
+    uint32_t partial_passes;
+} scenario_t;
+
+//Layout of the screen graphics_init builds: the power label on top, two rows of two buttons
+static const scenario_t scenarios[] = {
+    { "full screen", { 0, 0, BOARD_TFT_WIDTH - 1, BOARD_TFT_HEIGHT - 1 }, 10 },
+    { "power label", { 90, 0, 149, 15 }, 1 },
+    { "one button", { 3, 20, 117, 119 }, 2 }
+};
+
+typedef struct
+{
+    uint32_t passes;
+    uint64_t wire_bytes;
+    uint64_t time_us;
+} result_t;
+
+static uint16_t strip1[STRIP_PIXELS];
+static uint16_t strip2[STRIP_PIXELS];
+static uint16_t framebuffer[FRAME_PIXELS];
+static esp_lcd_panel_io_handle_t io;
+static esp_lcd_panel_handle_t panel;
+static result_t partial_results[sizeof(scenarios) / sizeof(scenarios[0])];
+static result_t direct_results[sizeof(scenarios) / sizeof(scenarios[0])];
+
+static uint32_t run(lv_display_t *disp, const lv_area_t *area, result_t *result)
+{
+    sim_lcd_stats_t lcd;
+    uint32_t calls = sim_lvgl_flush_calls(disp);
+    uint64_t start_us = sim_now_us();
+
+    sim_lcd_reset_stats();
+    uint32_t frame = sim_lvgl_refresh(disp, area, 1, RENDER_US);
+    sim_lvgl_wait_flushing(disp);
+    sim_lcd_get_stats(&lcd);
+    result->passes = sim_lvgl_flush_calls(disp) - calls;
+    result->wire_bytes = lcd.wire_bytes;
+    result->time_us = sim_now_us() - start_us;
+    return frame;
+}
+
+static void test_partial_mode(void)
+{
+    lv_display_t *disp = lv_display_create(BOARD_TFT_WIDTH, BOARD_TFT_HEIGHT);
+    lv_display_set_buffers(disp, strip1, strip2, sizeof(strip1), LV_DISPLAY_RENDER_MODE_PARTIAL);
+    ESP_ERROR_CHECK(display_flush_init(disp, panel, io, false));
+    uint8_t i;
+    int32_t x, y;
+
+    for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i)
+    {
+        const lv_area_t *area = &scenarios[i].area;
+        uint32_t frame = run(disp, area, &partial_results[i]);
+
+        //A strip holds as many rows of the area as fit, each one walks the widgets again
+        CHECK_EQ(partial_results[i].passes, scenarios[i].partial_passes);
+        CHECK_EQ(partial_results[i].wire_bytes,
+            lv_area_get_size(area) * sizeof(uint16_t) + partial_results[i].passes * WINDOW_COMMAND_BYTES);
+        for (y = area->y1; y <= area->y2; ++y)
+        {
+            for (x = area->x1; x <= area->x2; ++x)
+            {
+                CHECK_EQ(sim_lcd_pixel(x, y + DISPLAY_FLUSH_ROW_OFFSET), sim_lvgl_pixel(x, y, frame));
+            }
+        }
+    }
+}
+
+static void test_direct_mode(void)
+{
+    lv_display_t *disp = lv_display_create(BOARD_TFT_WIDTH, BOARD_TFT_HEIGHT);
+    lv_display_set_buffers(disp, framebuffer, NULL, sizeof(framebuffer), LV_DISPLAY_RENDER_MODE_DIRECT);
+    ESP_ERROR_CHECK(display_flush_init(disp, panel, io, true));
+    uint8_t i;
+    int32_t x, y;
+
+    for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i)
+    {
+        const lv_area_t *area = &scenarios[i].area;
+        run(disp, area, &direct_results[i]);
+
+        //One pass whatever the size, and never more bytes than the strips plus per-row window commands
+        CHECK_EQ(direct_results[i].passes, 1);
+        CHECK(direct_results[i].wire_bytes <= partial_results[i].wire_bytes +
+            lv_area_get_height(area) * WINDOW_COMMAND_BYTES);
+        //Whatever the planner sent around the area came from the same framebuffer
+        for (y = 0; y < BOARD_TFT_HEIGHT; ++y)
+        {
+            for (x = 0; x < BOARD_TFT_WIDTH; ++x)
+            {
+                CHECK_EQ(sim_lcd_pixel(x, y + DISPLAY_FLUSH_ROW_OFFSET), framebuffer[y * BOARD_TFT_WIDTH + x]);
+            }
+        }
+    }
+
+    //A full frame of RGB565 is five times the two strips
+    CHECK_EQ(sizeof(framebuffer), 5 * (sizeof(strip1) + sizeof(strip2)));
+}
+
+static void report(void)
+{
+    uint8_t i;
+    printf("RAM: partial 2 x %u B strips, direct %u B framebuffer\n", (unsigned)sizeof(strip1),
+        (unsigned)sizeof(framebuffer));
+    for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i)
+    {
+        printf("%-12s partial %2lu passes %6llu B %6llu us | direct %lu pass %6llu B %6llu us\n", scenarios[i].name,
+            (unsigned long)partial_results[i].passes, (unsigned long long)partial_results[i].wire_bytes,
+            (unsigned long long)partial_results[i].time_us, (unsigned long)direct_results[i].passes,
+            (unsigned long long)direct_results[i].wire_bytes, (unsigned long long)direct_results[i].time_us);
+    }
+}
+
+int main(void)
+{
+    sim_init();
+    ESP_ERROR_CHECK(power_profile_init());
+    sim_lcd_create(&io, &panel);
+
+    RUN_TEST(test_partial_mode);
+    RUN_TEST(test_direct_mode);
+    report();
+    return 0;
+}
@@ -0,0 +1,178 @@
+//Recorded drags through the predictive touch filter: lag at the display, jitter at rest, overshoot and clamping
+#include "host_test.h"
+#include "touch_filter.h"
+#include "t_watch_s3.h"
+#include <math.h>
+
+#define REPORT_MS (14)
+#define PREDICT_MS (25)
+
+static int64_t stream_us = SIM_START_US;
+static uint32_t rng = 0x9E3779B9;
+
+static ft5436_point_t update(int64_t after_ms, float x, float y)
+{
+    ft5436_point_t out;
+    stream_us += after_ms * 1000;
+    const touch_sample_t sample = {
+        .time_us = stream_us,
+        .x = (uint16_t)lroundf(x),
+        .y = (uint16_t)lroundf(y),
+        .pressed = true
+    };
+    touch_filter_update(&sample, &out);
+    return out;
+}
+
+//-1, 0 or 1 px of report noise
+static int32_t jitter(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (int32_t)(rng % 3) - 1;
+}
+
+static void start(void)
+{
+    const touch_filter_config_t config = TOUCH_FILTER_DEFAULT_CONFIG();
+    touch_filter_init(&config, BOARD_TFT_WIDTH, BOARD_TFT_HEIGHT);
+}
+
+static void test_first_sample_passes_through(void)
+{
+    start();
+    ft5436_point_t out = update(0, 37, 141);
+    CHECK_EQ(out.x, 37);
+    CHECK_EQ(out.y, 141);
+
+    //A new press does not inherit the previous one's motion
+    update(REPORT_MS, 60, 141);
+    update(REPORT_MS, 90, 141);
+    touch_filter_reset();
+    out = update(500, 200, 20);
+    CHECK_EQ(out.x, 200);
+    CHECK_EQ(out.y, 20);
+    out = update(REPORT_MS, 200, 20);
+    CHECK_EQ(out.x, 200);
+    CHECK_EQ(out.y, 20);
+}
+
+//A steady drag with report noise: by the time the frame is on the panel the raw point is PREDICT_MS behind the finger
+static void test_drag_lag(void)
+{
+    const float speed = 0.4f;   //px/ms, a relaxed scroll
+    float raw_error = 0.0f;
+    float filtered_error = 0.0f;
+    uint32_t i;
+
+    start();
+    for (i = 0; i < 30; ++i)
+    {
+        float x = 20.0f + speed * REPORT_MS * i;
+        ft5436_point_t out = update(i == 0 ? 0 : REPORT_MS, x + jitter(), 120 + jitter());
+        if (i < 10) continue;
+        //Where the finger is once the frame shows
+        float shown_x = x + speed * PREDICT_MS;
+        raw_error += fabsf(shown_x - x);
+        filtered_error += fabsf(shown_x - out.x);
+        CHECK_RANGE(out.y, 118, 122);
+    }
+    printf("drag at %.1f px/ms: mean error at display %.1f px raw, %.1f px filtered\n", speed, raw_error / 20,
+        filtered_error / 20);
+    CHECK(filtered_error * 3 < raw_error);
+}
+
+//Small noise while the finger rests does not move the output
+static void test_still_jitter(void)
+{
+    ft5436_point_t first;
+    ft5436_point_t out;
+    uint32_t i;
+
+    start();
+    first = update(0, 120, 120);
+    for (i = 0; i < 50; ++i)
+    {
+        out = update(REPORT_MS, 120 + jitter(), 120 + jitter());
+        CHECK_RANGE(out.x, 118, 122);
+        CHECK_RANGE(out.y, 118, 122);
+    }
+    //Held on one value for the last reports, no wandering
+    ft5436_point_t held = out;
+    uint32_t changes = 0;
+    for (i = 0; i < 50; ++i)
+    {
+        out = update(REPORT_MS, 120 + jitter(), 120 + jitter());
+        if (out.x != held.x || out.y != held.y) changes++;
+        held = out;
+    }
+    CHECK(changes <= 2);
+    CHECK_EQ(first.x, 120);
+}
+
+//A flick is extrapolated by at most max_predict_px and never past the panel
+static void test_flick_clamped(void)
+{
+    const touch_filter_config_t config = TOUCH_FILTER_DEFAULT_CONFIG();
+    ft5436_point_t out;
+    uint32_t i;
+
+    start();
+    for (i = 0; i < 8; ++i)
+    {
+        float x = 20.0f + 3.0f * REPORT_MS * i;
+        out = update(i == 0 ? 0 : REPORT_MS, x, 100);
+        CHECK(out.x <= x + config.max_predict_px + 1);
+        CHECK(out.x < BOARD_TFT_WIDTH);
+    }
+    for (i = 0; i < 5; ++i)
+    {
+        out = update(REPORT_MS, BOARD_TFT_WIDTH - 1, 100);
+        CHECK_EQ(out.x, BOARD_TFT_WIDTH - 1);
+    }
+
+    //Towards the origin: clamped at 0 instead of wrapping around
+    start();
+    for (i = 0; i < 8; ++i)
+    {
+        out = update(i == 0 ? 0 : REPORT_MS, 100, 100.0f - 14.0f * i);
+        CHECK(out.y <= 100);
+    }
+    CHECK_EQ(out.y, 0);
+}
+
+//When the finger stops, the prediction runs ahead for a moment and then settles on the finger
+static void test_stop_settles(void)
+{
+    const touch_filter_config_t config = TOUCH_FILTER_DEFAULT_CONFIG();
+    ft5436_point_t out;
+    uint32_t i;
+    uint16_t overshoot = 0;
+
+    start();
+    for (i = 0; i < 15; ++i)
+    {
+        update(i == 0 ? 0 : REPORT_MS, 20 + 7 * i, 120);
+    }
+    const uint16_t end_x = 20 + 7 * 14;
+    for (i = 0; i < 30; ++i)
+    {
+        out = update(REPORT_MS, end_x, 120);
+        if (out.x > end_x && out.x - end_x > overshoot) overshoot = out.x - end_x;
+    }
+    printf("stop after 0.5 px/ms: %u px overshoot, settled at %u for %u\n", overshoot, out.x, end_x);
+    CHECK(overshoot <= config.max_predict_px);
+    CHECK_RANGE(out.x, end_x - 2, end_x + 2);
+}
+
+int main(void)
+{
+    sim_init();
+    RUN_TEST(test_first_sample_passes_through);
+    RUN_TEST(test_drag_lag);
+    RUN_TEST(test_still_jitter);
+    RUN_TEST(test_flick_clamped);
+    RUN_TEST(test_stop_settles);
+    return 0;
+}
@@ -0,0 +1,316 @@
+//Recorded touch streams replayed through the sample ring and the software gesture recognizer
+#include "host_test.h"
+#include "touch_gesture.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define GESTURES_MAX (128)
+#define REPORT_MS (14)      //FT6336 active report period with TOUCHRATE_ACTIVE 0x0E
+
+static touch_gesture_t gestures[GESTURES_MAX];
+static uint8_t gesture_count;
+static int64_t stream_us;
+
+static void gesture_cb(const touch_gesture_t *gesture, void *user_data)
+{
+    CHECK(gesture_count < GESTURES_MAX);
+    gestures[gesture_count++] = *gesture;
+}
+
+static void start(const touch_gesture_config_t *config)
+{
+    touch_gesture_init(config, gesture_cb, NULL);
+    gesture_count = 0;
+}
+
+static void start_default(void)
+{
+    const touch_gesture_config_t config = TOUCH_GESTURE_DEFAULT_CONFIG();
+    start(&config);
+}
+
+static void feed(int64_t after_ms, uint16_t x, uint16_t y, bool pressed, uint8_t gesture_id)
+{
+    stream_us += after_ms * 1000;
+    const touch_sample_t sample = {
+        .time_us = stream_us,
+        .x = x,
+        .y = y,
+        .pressed = pressed,
+        .gesture_id = gesture_id
+    };
+    touch_gesture_feed(&sample);
+}
+
+//A straight line from one point to another, one report per REPORT_MS, then the release
+static void stroke(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint16_t reports)
+{
+    uint16_t i;
+    for (i = 0; i <= reports; ++i)
+    {
+        feed(i == 0 ? 0 : REPORT_MS, x0 + ((int32_t)x1 - x0) * i / reports, y0 + ((int32_t)y1 - y0) * i / reports,
+            true, FT6X36_GEST_ID_NO_GESTURE);
+    }
+    feed(REPORT_MS, 0, 0, false, FT6X36_GEST_ID_NO_GESTURE);
+}
+
+static void test_tap_and_double_tap(void)
+{
+    start_default();
+    feed(0, 100, 100, true, 0);
+    feed(REPORT_MS, 102, 101, true, 0);
+    feed(REPORT_MS, 0, 0, false, 0);
+    CHECK_EQ(gesture_count, 1);
+    CHECK_EQ(gestures[0].type, Tap);
+    //The release carries no coordinates, the tap is where the finger was last seen
+    CHECK_EQ(gestures[0].point.x, 102);
+    CHECK_EQ(gestures[0].point.y, 101);
+    CHECK_EQ(gestures[0].samples, 3);
+
+    feed(200, 104, 99, true, 0);
+    feed(REPORT_MS, 0, 0, false, 0);
+    //The first tap is already out, the second one only counts as the double tap
+    CHECK_EQ(gesture_count, 2);
+    CHECK_EQ(gestures[1].type, DoubleTap);
+
+    //Too late for a double tap
+    feed(400, 100, 100, true, 0);
+    feed(REPORT_MS, 0, 0, false, 0);
+    feed(400, 100, 100, true, 0);
+    feed(REPORT_MS, 0, 0, false, 0);
+    CHECK_EQ(gesture_count, 4);
+    CHECK_EQ(gestures[2].type, Tap);
+    CHECK_EQ(gestures[3].type, Tap);
+
+    //Held too long for a tap, released before a long press
+    feed(1000, 100, 100, true, 0);
+    feed(400, 100, 100, true, 0);
+    feed(REPORT_MS, 0, 0, false, 0);
+    CHECK_EQ(gesture_count, 4);
+}
+
+//Long press is found without new reports, the controller sends none while the finger rests
+static void test_long_press(void)
+{
+    start_default();
+    feed(1000, 50, 60, true, 0);
+    touch_gesture_process(stream_us + 599 * 1000);
+    CHECK_EQ(gesture_count, 0);
+    touch_gesture_process(stream_us + 600 * 1000);
+    CHECK_EQ(gesture_count, 1);
+    CHECK_EQ(gestures[0].type, LongPress);
+    CHECK_EQ(gestures[0].point.x, 50);
+    touch_gesture_process(stream_us + 2000 * 1000);
+    feed(2000, 0, 0, false, 0);
+    //Once, and no tap on release
+    CHECK_EQ(gesture_count, 1);
+}
+
+static void test_drag_and_swipes(void)
+{
+    static const struct
+    {
+        uint16_t x0, y0, x1, y1;
+        touch_swipe_dir_t direction;
+    } swipes[] = {
+        { 200, 120, 40, 125, SwipeLeft },
+        { 40, 120, 200, 110, SwipeRight },
+        { 120, 200, 125, 40, SwipeUp },
+        { 120, 40, 118, 200, SwipeDown }
+    };
+    uint8_t i;
+
+    for (i = 0; i < sizeof(swipes) / sizeof(swipes[0]); ++i)
+    {
+        start_default();
+        feed(1000, 0, 0, false, 0);
+        stroke(swipes[i].x0, swipes[i].y0, swipes[i].x1, swipes[i].y1, 8);
+        CHECK(gesture_count >= 4);
+        CHECK_EQ(gestures[0].type, DragStart);
+        CHECK_EQ(gestures[0].point.x, swipes[i].x0);
+        CHECK_EQ(gestures[0].point.y, swipes[i].y0);
+        CHECK_EQ(gestures[1].type, DragMove);
+        CHECK_EQ(gestures[gesture_count - 2].type, Swipe);
+        CHECK_EQ(gestures[gesture_count - 2].direction, swipes[i].direction);
+        CHECK_EQ(gestures[gesture_count - 1].type, DragEnd);
+        CHECK_EQ(gestures[gesture_count - 1].point.x, swipes[i].x1);
+        CHECK_EQ(gestures[gesture_count - 1].point.y, swipes[i].y1);
+        //160 px in 8 reports of 14 ms
+        int32_t v = abs(gestures[gesture_count - 2].vx) > abs(gestures[gesture_count - 2].vy) ?
+            gestures[gesture_count - 2].vx : gestures[gesture_count - 2].vy;
+        CHECK_RANGE(abs(v), 160 * 1000 / (8 * REPORT_MS) - 100, 160 * 1000 / (8 * REPORT_MS) + 100);
+    }
+
+    //Same distance, slow: a drag without a swipe
+    start_default();
+    feed(1000, 0, 0, false, 0);
+    stroke(40, 120, 200, 120, 80);
+    CHECK_EQ(gestures[gesture_count - 1].type, DragEnd);
+    CHECK(gestures[gesture_count - 2].type != Swipe);
+
+    //Fast but short
+    start_default();
+    feed(1000, 0, 0, false, 0);
+    stroke(100, 120, 130, 120, 2);
+    CHECK_EQ(gestures[gesture_count - 1].type, DragEnd);
+    CHECK(gestures[gesture_count - 2].type != Swipe);
+}
+
+//The controller's ID turns up a few reports into the stroke and repeats until release
+static void hw_stroke(uint16_t x0, uint16_t x1, uint16_t reports, uint16_t id_from, uint8_t gesture_id)
+{
+    uint16_t i;
+    for (i = 0; i <= reports; ++i)
+    {
+        feed(i == 0 ? 0 : REPORT_MS, x0 + ((int32_t)x1 - x0) * i / reports, 120, true,
+            i >= id_from ? gesture_id : FT6X36_GEST_ID_NO_GESTURE);
+    }
+    feed(REPORT_MS, 0, 0, false, FT6X36_GEST_ID_NO_GESTURE);
+}
+
+static void test_hw_gestures(void)
+{
+    static const struct
+    {
+        uint8_t gesture_id;
+        ft5436_event_t type;
+        touch_swipe_dir_t direction;
+    } ids[] = {
+        { FT6X36_GEST_ID_MOVE_UP, Swipe, SwipeUp },
+        { FT6X36_GEST_ID_MOVE_DOWN, Swipe, SwipeDown },
+        { FT6X36_GEST_ID_MOVE_LEFT, Swipe, SwipeLeft },
+        { FT6X36_GEST_ID_MOVE_RIGHT, Swipe, SwipeRight },
+        { FT6X36_GEST_ID_ZOOM_IN, ZoomIn, SwipeNone },
+        { FT6X36_GEST_ID_ZOOM_OUT, ZoomOut, SwipeNone }
+    };
+    touch_gesture_config_t config = TOUCH_GESTURE_DEFAULT_CONFIG();
+    config.hw_gestures = true;
+    uint8_t i, j, found;
+
+    for (i = 0; i < sizeof(ids) / sizeof(ids[0]); ++i)
+    {
+        start(&config);
+        feed(1000, 0, 0, false, 0);
+        hw_stroke(200, 40, 8, 3, ids[i].gesture_id);
+        //Reported once, on the report that carried the ID, and never guessed from the coordinates
+        found = 0;
+        for (j = 0; j < gesture_count; ++j)
+        {
+            if (gestures[j].type != ids[i].type) continue;
+            found++;
+            CHECK_EQ(gestures[j].direction, ids[i].direction);
+            CHECK_EQ(gestures[j].samples, 4);
+            CHECK_EQ(gestures[j].point.x, 200 - 160 * 3 / 8);
+        }
+        CHECK_EQ(found, 1);
+        CHECK_EQ(gestures[gesture_count - 1].type, DragEnd);
+        if (ids[i].type != Swipe)
+        {
+            for (j = 0; j < gesture_count; ++j) CHECK(gestures[j].type != Swipe);
+        }
+    }
+
+    //A hardware gesture on a short touch is no tap
+    start(&config);
+    feed(1000, 0, 0, false, 0);
+    feed(0, 100, 100, true, FT6X36_GEST_ID_ZOOM_OUT);
+    feed(REPORT_MS, 0, 0, false, 0);
+    CHECK_EQ(gesture_count, 1);
+    CHECK_EQ(gestures[0].type, ZoomOut);
+
+    //Without the engine the same stroke is only a swipe at release, after every report of it
+    start_default();
+    feed(1000, 0, 0, false, 0);
+    hw_stroke(200, 40, 8, 3, FT6X36_GEST_ID_MOVE_LEFT);
+    CHECK_EQ(gestures[gesture_count - 2].type, Swipe);
+    CHECK_EQ(gestures[gesture_count - 2].samples, 10);
+}
+
+//Samples pushed from another task, as the indev read callback does, come out complete and in order
+static volatile bool producer_done;
+
+static void producer_task(void *arg)
+{
+    uint16_t i;
+    for (i = 0; i < 200; ++i)
+    {
+        touch_sample_t sample = {
+            .time_us = i,
+            .x = i,
+            .y = 200 - i,
+            .pressed = true
+        };
+        while (!touch_ring_push(&sample)) vTaskDelay(1);
+        if (i % 7 == 0) vTaskDelay(1);
+    }
+    producer_done = true;
+    vTaskDelete(NULL);
+}
+
+static void test_ring_order(void)
+{
+    touch_sample_t sample;
+    uint16_t expected = 0;
+    uint32_t dropped = touch_ring_dropped();
+
+    xTaskCreatePinnedToCore(producer_task, "touch", 2048, NULL, 2, NULL, 0);
+    while (expected < 200)
+    {
+        if (!touch_ring_pop(&sample))
+        {
+            CHECK(!producer_done);
+            vTaskDelay(1);
+            continue;
+        }
+        CHECK_EQ(sample.time_us, expected);
+        CHECK_EQ(sample.x, expected);
+        CHECK_EQ(sample.y, 200 - expected);
+        expected++;
+    }
+    CHECK(!touch_ring_pop(&sample));
+    CHECK_EQ(expected, 200);
+
+    //A full ring drops the newest sample and counts it
+    for (expected = 0; expected < TOUCH_RING_SIZE; ++expected)
+    {
+        sample.time_us = expected;
+        CHECK(touch_ring_push(&sample));
+    }
+    CHECK(!touch_ring_push(&sample));
+    CHECK_EQ(touch_ring_dropped() - dropped, 1);
+    for (expected = 0; expected < TOUCH_RING_SIZE; ++expected)
+    {
+        CHECK(touch_ring_pop(&sample));
+        CHECK_EQ(sample.time_us, expected);
+    }
+    CHECK(!touch_ring_pop(&sample));
+}
+
+//The LVGL task drains the ring in one go and the gestures come out as if fed one by one
+static void test_process_drains_ring(void)
+{
+    touch_sample_t sample = { .pressed = true, .x = 100, .y = 100 };
+    start_default();
+    sample.time_us = stream_us + 1000000;
+    CHECK(touch_ring_push(&sample));
+    sample.time_us += REPORT_MS * 1000;
+    sample.pressed = false;
+    CHECK(touch_ring_push(&sample));
+    touch_gesture_process(sample.time_us);
+    CHECK_EQ(gesture_count, 1);
+    CHECK_EQ(gestures[0].type, Tap);
+    CHECK(!touch_ring_pop(&sample));
+    stream_us = sample.time_us;
+}
+
+int main(void)
+{
+    sim_init();
+    RUN_TEST(test_tap_and_double_tap);
+    RUN_TEST(test_long_press);
+    RUN_TEST(test_drag_and_swipes);
+    RUN_TEST(test_hw_gestures);
+    RUN_TEST(test_ring_order);
+    RUN_TEST(test_process_drains_ring);
+    return 0;
+}
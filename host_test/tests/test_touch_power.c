@@ -0,0 +1,170 @@
+//Touch controller power states against the FT6336 model, which reloads its power-on defaults when it leaves hibernate.
+//Built with TOUCH_POWER_HIBERNATE_ON_SCREEN_OFF=1, see CMakeLists.txt
+#include "host_test.h"
+#include "sim_board.h"
+#include "ft5436.h"
+#include "touch_power.h"
+#include "t_watch_s3.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static peripheral_handles_t peripherals;
+static const ft5436_gesture_config_t gesture_config = {
+    .radian = 12,
+    .offset_left_right = 30,
+    .offset_up_down = 30,
+    .distance_left_right = 40,
+    .distance_up_down = 40,
+    .distance_zoom = 60
+};
+
+//Everything ft5436_init, ft5436_configure_gestures and touch_power_init wrote, for the given report rate
+static void check_configured(uint8_t rate)
+{
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_THRESHHOLD], FT6X36_DEFAULT_THRESHOLD);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_INTERRUPT_MODE], FT6X36_INT_MODE_TRIGGER);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_RADIAN_VALUE], gesture_config.radian);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_DISTANCE_ZOOM], gesture_config.distance_zoom);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_CTRL], FT6X36_CTRL_AUTO_MONITOR);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_TIME_ENTER_MONITOR], TOUCH_POWER_MONITOR_ENTER_S);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_TOUCHRATE_MONITOR], TOUCH_POWER_MONITOR_PERIOD_MS);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_TOUCHRATE_ACTIVE], rate);
+}
+
+//Transitions run in the touch bus worker, this covers one including a hibernate wake (reset pulse, boot, reconfigure)
+static void settle(void)
+{
+    vTaskDelay(pdMS_TO_TICKS(200));
+}
+
+static void test_init(void)
+{
+    CHECK_EQ(ft5436_configure_gestures(&gesture_config), ESP_OK);
+    CHECK_EQ(touch_power_init(), ESP_OK);
+    CHECK_EQ(touch_power_get_state(), TouchPowerActive);
+    check_configured(TOUCH_POWER_RATE_NORMAL);
+}
+
+//Only the registers that differ between two states go on the wire
+static void test_transitions(void)
+{
+    uint32_t transitions = touch_power_get_transitions();
+    sim_i2c_reset_counters(&sim_ft6336);
+
+    //The setter only queues the transition
+    touch_power_set_dragging(true);
+    CHECK_EQ(sim_ft6336.transactions, 0);
+    settle();
+    CHECK_EQ(touch_power_get_state(), TouchPowerDrag);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_TOUCHRATE_ACTIVE], TOUCH_POWER_RATE_DRAG);
+    touch_power_set_dragging(false);
+    settle();
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_TOUCHRATE_ACTIVE], TOUCH_POWER_RATE_NORMAL);
+    CHECK_EQ(sim_ft6336.transactions, 2);
+    CHECK_EQ(sim_ft6336.reg_writes[FT6X36_REG_POWER_MODE], 0);
+
+    touch_power_set_ui_idle(true);
+    settle();
+    CHECK_EQ(touch_power_get_state(), TouchPowerMonitor);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_POWER_MODE], FT6X36_PMODE_MONITOR);
+    touch_power_set_ui_idle(true);
+    settle();
+    touch_power_set_ui_idle(false);
+    settle();
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_POWER_MODE], FT6X36_PMODE_ACTIVE);
+    //The rate did not change, so it is not written again
+    CHECK_EQ(sim_ft6336.reg_writes[FT6X36_REG_TOUCHRATE_ACTIVE], 2);
+    CHECK_EQ(sim_ft6336.transactions, 4);
+    CHECK_EQ(touch_power_get_transitions() - transitions, 4);
+
+    //Changes made before the worker gets to them cost one transition to where they ended up
+    touch_power_set_dragging(true);
+    touch_power_set_ui_idle(true);
+    touch_power_set_ui_idle(false);
+    settle();
+    CHECK_EQ(touch_power_get_state(), TouchPowerDrag);
+    CHECK_EQ(touch_power_get_transitions() - transitions, 5);
+    CHECK_EQ(sim_ft6336.reg_writes[FT6X36_REG_POWER_MODE], 2);
+    touch_power_set_dragging(false);
+    settle();
+}
+
+static void test_hibernate_restores_config(void)
+{
+    uint32_t resets = sim_ft6336_resets();
+    touch_power_set_dragging(true);
+    settle();
+    touch_power_set_display_on(false);
+    settle();
+    CHECK_EQ(touch_power_get_state(), TouchPowerHibernate);
+    CHECK(sim_ft6336_hibernating());
+
+    touch_power_set_dragging(false);
+
+    settle();
+    touch_power_set_display_on(true);
+    settle();
+    CHECK_EQ(touch_power_get_state(), TouchPowerActive);
+    CHECK(!sim_ft6336_hibernating());
+    CHECK_EQ(sim_ft6336_resets() - resets, 1);
+    check_configured(TOUCH_POWER_RATE_NORMAL);
+
+    //Trigger mode again: one INT pulse per report instead of INT held low while touched
+    uint32_t reports = sim_ft6336_reports();
+    sim_ft6336_report(SimTouchDown, 100, 100);
+    CHECK_EQ(sim_ft6336_reports() - reports, 1);
+    CHECK_EQ(gpio_get_level(BOARD_TOUCH_INT), 0);
+    vTaskDelay(pdMS_TO_TICKS(1));
+    CHECK_EQ(gpio_get_level(BOARD_TOUCH_INT), 1);
+    sim_ft6336_report(SimTouchUp, 100, 100);
+    vTaskDelay(pdMS_TO_TICKS(1));
+
+    //Woken straight into a drag, the drag rate is written even though it was the last one set before hibernate
+    touch_power_set_dragging(true);
+    settle();
+    touch_power_set_display_on(false);
+    settle();
+    touch_power_set_display_on(true);
+    settle();
+    CHECK_EQ(touch_power_get_state(), TouchPowerDrag);
+    CHECK_EQ(sim_ft6336_resets() - resets, 2);
+    check_configured(TOUCH_POWER_RATE_DRAG);
+    touch_power_set_dragging(false);
+    settle();
+}
+
+//A controller that does not answer after the pulse stays in hibernate and is woken again on the next change
+static void test_failed_wake_is_retried(void)
+{
+    uint32_t resets = sim_ft6336_resets();
+    touch_power_set_display_on(false);
+    settle();
+    CHECK_EQ(touch_power_get_state(), TouchPowerHibernate);
+
+    sim_ft6336_power(false);
+    touch_power_set_display_on(true);
+    settle();
+    CHECK_EQ(touch_power_get_state(), TouchPowerHibernate);
+
+    sim_ft6336_power(true);
+    vTaskDelay(pdMS_TO_TICKS(50));
+    touch_power_set_ui_idle(true);
+    settle();
+    CHECK_EQ(touch_power_get_state(), TouchPowerMonitor);
+    CHECK_EQ(sim_ft6336.regs[FT6X36_REG_POWER_MODE], FT6X36_PMODE_MONITOR);
+    CHECK(sim_ft6336_resets() - resets >= 1);
+    //The report rate follows on the way back to active
+    touch_power_set_ui_idle(false);
+    settle();
+    check_configured(TOUCH_POWER_RATE_NORMAL);
+}
+
+int main(void)
+{
+    sim_board_init(&peripherals);
+    RUN_TEST(test_init);
+    RUN_TEST(test_transitions);
+    RUN_TEST(test_hibernate_restores_config);
+    RUN_TEST(test_failed_wake_is_retried);
+    return 0;
+}
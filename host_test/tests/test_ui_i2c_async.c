@@ -0,0 +1,131 @@
+//The LVGL task's I2C work (touch reads, touch power transitions, backlight rail) queued to the bus workers: frames keep
+//their period while the transfers, a rail ramp and a stalled touch bus run behind them
+#include "host_test.h"
+#include "sim_board.h"
+#include "i2c_controller.h"
+#include "axp2101.h"
+#include "ft5436.h"
+#include "touch_power.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define LVGL_TASK_PRIORITY (2)
+#define FRAME_MS (16)
+#define FRAMES (120)
+#define STALL_FRAME (50)
+#define TOUCH_LATENCY_US (1000)
+#define PMU_LATENCY_US (500)
+
+static peripheral_handles_t peripherals;
+static volatile bool done;
+static uint64_t frame_start_us[FRAMES];
+static uint64_t section_us[FRAMES];
+static volatile uint32_t touch_requested;
+static volatile uint32_t touch_ok;
+static volatile uint32_t touch_failed;
+static ft5436_touch_data_t touch_last;
+static volatile uint32_t backlight_on;
+static volatile esp_err_t backlight_err;
+
+static void touch_done(bool ok, const ft5436_touch_data_t *data, void *user_data)
+{
+    if (ok)
+    {
+        touch_last = *data;
+        touch_ok++;
+    }
+    else
+    {
+        touch_failed++;
+    }
+}
+
+static void backlight_done(esp_err_t err, void *user_data)
+{
+    if (err != ESP_OK) backlight_err = err;
+    backlight_on++;
+}
+
+//What lvgl_port_task, the indev read and screen_off/screen_on issue around a frame, with the render itself taking no time
+static void frame_task(void *arg)
+{
+    for (uint32_t i = 0; i < FRAMES; i++)
+    {
+        frame_start_us[i] = sim_now_us();
+        touch_power_set_ui_idle((i / 20) % 2);
+        if (i % 8 == 0) touch_power_set_dragging((i / 8) % 2 == 0);
+        if (i == STALL_FRAME) sim_ft6336.hold_sda_next = 1;
+        if (ft5436_request_touch_data(touch_done, NULL) == ESP_OK) touch_requested++;
+        if (i % 30 == 10) CHECK_EQ(axp2101_rail_release_async(Axp2101RailBacklight), ESP_OK);
+        if (i % 30 == 20) CHECK_EQ(axp2101_rail_acquire_async(Axp2101RailBacklight, backlight_done, NULL), ESP_OK);
+        section_us[i] = sim_now_us() - frame_start_us[i];
+        vTaskDelay(pdMS_TO_TICKS(FRAME_MS));
+    }
+    done = true;
+    vTaskDelete(NULL);
+}
+
+static void test_frames_keep_period(void)
+{
+    sim_i2c_bus_stats_t before;
+    sim_i2c_bus_stats_t after;
+    uint32_t switches = sim_axp2101_ldo_switches(AXP2101_LDO_ALDO2);
+    uint32_t transitions = touch_power_get_transitions();
+    sim_i2c_get_bus_stats(I2C_NUM_0, &before);
+    sim_ft6336.latency_us = TOUCH_LATENCY_US;
+    sim_axp2101.latency_us = PMU_LATENCY_US;
+    sim_ft6336_report(SimTouchDown, 120, 80);
+
+    xTaskCreatePinnedToCore(frame_task, "lvgl", 4096, NULL, LVGL_TASK_PRIORITY, NULL, 1);
+    while (!done) vTaskDelay(1);
+    vTaskDelay(pdMS_TO_TICKS(100));
+    sim_ft6336.latency_us = 0;
+    sim_axp2101.latency_us = 0;
+
+    for (uint32_t i = 0; i < FRAMES; i++)
+    {
+        CHECK_EQ(section_us[i], 0);
+        CHECK_EQ(frame_start_us[i] - frame_start_us[0], (uint64_t)i * FRAME_MS * 1000);
+    }
+
+    //The stall happened, and every request was carried out behind the frames
+    sim_i2c_get_bus_stats(I2C_NUM_0, &after);
+    CHECK(after.resets > before.resets);
+    CHECK_EQ(touch_requested, FRAMES);
+    CHECK_EQ(touch_ok + touch_failed, FRAMES);
+    CHECK(touch_ok >= FRAMES - 1);
+    CHECK_EQ(touch_last.count, 1);
+    CHECK_EQ(touch_last.points[0].x, 120);
+    CHECK_EQ(touch_last.points[0].y, 80);
+
+    CHECK_EQ(backlight_on, FRAMES / 30);
+    CHECK_EQ(backlight_err, ESP_OK);
+    CHECK_EQ(sim_axp2101_ldo_switches(AXP2101_LDO_ALDO2) - switches, 2 * (FRAMES / 30));
+    CHECK(sim_axp2101.regs[XPOWERS_AXP2101_LDO_ONOFF_CTRL0] & AXP2101_LDO_ALDO2);
+
+    CHECK(touch_power_get_transitions() > transitions);
+    CHECK_EQ(touch_power_get_state(), TouchPowerDrag);
+    sim_ft6336_report(SimTouchUp, 120, 80);
+}
+
+//The blocking read it replaces holds the caller for the whole transfer
+static void test_blocking_read_costs_the_transfer(void)
+{
+    ft5436_touch_data_t touch;
+    sim_ft6336.latency_us = TOUCH_LATENCY_US;
+    uint64_t start_us = sim_now_us();
+    CHECK(ft5436_read_touch_data(&touch));
+    CHECK(sim_now_us() - start_us > TOUCH_LATENCY_US);
+    sim_ft6336.latency_us = 0;
+}
+
+int main(void)
+{
+    sim_board_init(&peripherals);
+    //As graphics_init leaves them
+    CHECK_EQ(axp2101_rail_acquire(Axp2101RailBacklight, NULL), ESP_OK);
+    CHECK_EQ(touch_power_init(), ESP_OK);
+    RUN_TEST(test_frames_keep_period);
+    RUN_TEST(test_blocking_read_costs_the_transfer);
+    return 0;
+}
@@ -5,6 +5,10 @@
 #include "ft5436.h"
 #include "drv2605.h"
 #include "graphics.h"
+#include "power_telemetry.h"
+#include "power_profile.h"
+#include "energy_profiler.h"
+#include "haptics.h"
 #include "freertos/FreeRTOS.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
@@ -27,26 +31,21 @@ static void log_tasks()
 static void init_task(void *pv_parameters)
 {
     i2c_controller_init(&peripherals);
+    ESP_ERROR_CHECK(power_telemetry_init());
+    ESP_ERROR_CHECK(energy_profiler_init());
+    ESP_ERROR_CHECK(haptics_init());
     st7789_init(&peripherals);
     graphics_init(&peripherals);
+    //Touch and PMU interrupt handlers are in place, light sleep can use them as wake-up sources
+    ESP_ERROR_CHECK(power_profile_start());
 
     vTaskDelete(NULL);
 }
 
 void app_main(void)
 {   
-    esp_pm_config_t pm_config = 
-    {
-        .max_freq_mhz = 80,
-        .min_freq_mhz = 80,
-        .light_sleep_enable = true
-    };
-    /*
-    ESP_ERROR_CHECK(esp_pm_configure(&pm_config));
-    ESP_ERROR_CHECK(gpio_sleep_sel_dis(BOARD_TOUCH_INT));
-    ESP_ERROR_CHECK(gpio_wakeup_enable(BOARD_TOUCH_INT, GPIO_INTR_LOW_LEVEL));
-    ESP_ERROR_CHECK(esp_sleep_enable_ext0_wakeup(BOARD_TOUCH_INT, 0));
-    */
+    //Locks first, the drivers take them from their first transaction on
+    ESP_ERROR_CHECK(power_profile_init());
 
     xTaskCreatePinnedToCore(init_task, "fInitTask", INIT_TASK_STACK_SIZE, NULL, INIT_TASK_PRIORITY, NULL, 1);
     vTaskDelete(NULL);
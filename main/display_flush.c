@@ -0,0 +1,133 @@
+#include "display_flush.h"
+#include "flush_planner.h"
+#include "power_profile.h"
+#include "t_watch_s3.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_panel_ops.h"
+#include "esp_timer.h"
+
+static bool direct_mode;
+static volatile uint32_t flush_strip_count;
+static volatile uint32_t flush_byte_count;
+static volatile uint16_t flush_pending;
+
+//Called from the SPI ISR once the pixel payload of a transfer has left the DMA buffer.
+//lv_display_flush_ready and the PM lock bookkeeping live in flash, so the ISR is not in IRAM (SPI_MASTER_ISR_IN_IRAM off)
+static bool flush_done_cb(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
+{
+    if (--flush_pending == 0)
+    {
+        power_profile_release(PowerClientFlush);
+        lv_display_flush_ready((lv_display_t *)user_ctx);
+    }
+    return false;
+}
+
+//px_map is the whole framebuffer, areas are collected and sent as planned windows once the frame is complete
+static void flush_direct_cb(lv_display_t * disp, const lv_area_t * area, uint8_t * px_map)
+{
+    esp_lcd_panel_handle_t panel_handle = lv_display_get_user_data(disp);
+    uint16_t *fb = (uint16_t *)px_map;
+    const flush_window_t *windows;
+    uint8_t window_cnt;
+    uint16_t transfers = 0;
+    uint8_t i;
+    int32_t y;
+
+    flush_planner_add(area);
+    if (!lv_display_flush_is_last(disp))
+    {
+        //Nothing is on the wire yet, LVGL can keep drawing into the framebuffer
+        lv_display_flush_ready(disp);
+        return;
+    }
+
+    window_cnt = flush_planner_plan(&windows);
+    for (i = 0; i < window_cnt; ++i)
+    {
+        transfers += windows[i].transfers;
+    }
+    flush_pending = transfers;
+    flush_strip_count += window_cnt;
+    //Held until the last transfer completes, the CPU may drop to the minimum clock but not sleep meanwhile
+    power_profile_acquire(PowerClientFlush);
+
+    for (i = 0; i < window_cnt; ++i)
+    {
+        const lv_area_t *win = &windows[i].area;
+        if (windows[i].band)
+        {
+            esp_lcd_panel_draw_bitmap(panel_handle, 0, win->y1 + DISPLAY_FLUSH_ROW_OFFSET,
+                BOARD_TFT_WIDTH, win->y2 + DISPLAY_FLUSH_ROW_OFFSET + 1, &fb[win->y1 * BOARD_TFT_WIDTH]);
+        }
+        else
+        {
+            for (y = win->y1; y <= win->y2; ++y)
+            {
+                esp_lcd_panel_draw_bitmap(panel_handle, win->x1, y + DISPLAY_FLUSH_ROW_OFFSET,
+                    win->x2 + 1, y + DISPLAY_FLUSH_ROW_OFFSET + 1, &fb[y * BOARD_TFT_WIDTH + win->x1]);
+            }
+        }
+    }
+    flush_planner_reset();
+}
+
+//check px_map for color order
+static void flush_partial_cb(lv_display_t * disp, const lv_area_t * area, uint8_t * px_map)
+{
+    esp_lcd_panel_handle_t panel_handle = lv_display_get_user_data(disp);
+    int offsetx1 = area->x1;
+    int offsetx2 = area->x2;
+    int offsety1 = area->y1 + DISPLAY_FLUSH_ROW_OFFSET;
+    int offsety2 = area->y2 + DISPLAY_FLUSH_ROW_OFFSET;
+
+    //Flush ready is signalled by flush_done_cb so LVGL renders into the other buffer meanwhile
+    flush_pending = 1;
+    flush_strip_count++;
+    power_profile_acquire(PowerClientFlush);
+    flush_byte_count += lv_area_get_size(area) * sizeof(uint16_t) + FLUSH_PLANNER_WINDOW_OVERHEAD_BYTES;
+    esp_lcd_panel_draw_bitmap(panel_handle, offsetx1, offsety1, offsetx2 + 1, offsety2 + 1, px_map);
+}
+
+esp_err_t display_flush_init(lv_display_t *disp, esp_lcd_panel_handle_t panel, esp_lcd_panel_io_handle_t io, bool direct)
+{
+    direct_mode = direct;
+    flush_pending = 0;
+    flush_planner_reset();
+    lv_display_set_flush_cb(disp, direct ? flush_direct_cb : flush_partial_cb);
+    lv_display_set_user_data(disp, panel);
+
+    const esp_lcd_panel_io_callbacks_t io_callbacks = {
+        .on_color_trans_done = flush_done_cb
+    };
+    return esp_lcd_panel_io_register_event_callbacks(io, &io_callbacks, disp);
+}
+
+bool display_flush_wait(uint32_t timeout_ms)
+{
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (flush_pending != 0)
+    {
+        if (esp_timer_get_time() >= deadline_us) return false;
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+void display_flush_get_stats(display_flush_stats_t *stats)
+{
+    stats->strips = flush_strip_count;
+    flush_strip_count = 0;
+    //The planner knows the window shapes, partial areas are counted as they are sent
+    if (direct_mode)
+    {
+        stats->bytes = flush_planner_get_planned_bytes();
+    }
+    else
+    {
+        stats->bytes = flush_byte_count;
+    }
+    flush_byte_count = 0;
+}
@@ -0,0 +1,195 @@
+#include "lvgl.h"
+#include "lv_draw_sw_pie.h"
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+
+#define PIE_MIN_WIDTH (16)              //Narrower rows are cheaper in plain C than the alignment prologue
+#define PIE_BLOCK_PIXELS (8)            //One 128-bit Q register holds 8 RGB565 pixels
+#define SELFTEST_WIDTH (240)
+#define SELFTEST_HEIGHT (24)
+
+//The host build links C models of the assembly kernels and sets this to test the wrappers around them
+#ifndef LV_DRAW_SW_PIE_KERNELS
+#define LV_DRAW_SW_PIE_KERNELS CONFIG_IDF_TARGET_ESP32S3
+#endif
+
+static const char *TAG = "draw_sw_pie";
+
+#if LV_DRAW_SW_PIE_KERNELS
+void lv_draw_sw_pie_fill16(uint16_t *dest, uint32_t blocks, uint32_t color32);
+void lv_draw_sw_pie_copy16(uint16_t *dest, const uint16_t *src, uint32_t blocks);
+void lv_draw_sw_pie_copy16_unaligned(uint16_t *dest, const uint16_t *src, uint32_t blocks);
+#endif
+
+static inline uint16_t *row_at(uint16_t *buf, int32_t stride, int32_t y)
+{
+    return (uint16_t *)((uint8_t *)buf + y * stride);
+}
+
+static inline const uint16_t *const_row_at(const uint16_t *buf, int32_t stride, int32_t y)
+{
+    return (const uint16_t *)((const uint8_t *)buf + y * stride);
+}
+
+void lv_draw_sw_pie_fill_rgb565_ref(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride, uint16_t color)
+{
+    int32_t x, y;
+    for (y = 0; y < h; ++y)
+    {
+        uint16_t *row = row_at(dest, dest_stride, y);
+        for (x = 0; x < w; ++x) row[x] = color;
+    }
+}
+
+void lv_draw_sw_pie_copy_rgb565_ref(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride,
+    const uint16_t *src, int32_t src_stride)
+{
+    int32_t x, y;
+    for (y = 0; y < h; ++y)
+    {
+        uint16_t *d = row_at(dest, dest_stride, y);
+        const uint16_t *s = const_row_at(src, src_stride, y);
+        for (x = 0; x < w; ++x) d[x] = s[x];
+    }
+}
+
+lv_result_t lv_draw_sw_pie_fill_rgb565(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride, uint16_t color)
+{
+#if LV_DRAW_SW_PIE_KERNELS
+    if (w < PIE_MIN_WIDTH) return LV_RESULT_INVALID;
+
+    uint32_t color32 = color | ((uint32_t)color << 16);
+    int32_t y;
+    for (y = 0; y < h; ++y)
+    {
+        uint16_t *row = row_at(dest, dest_stride, y);
+        int32_t left = w;
+
+        while (((uintptr_t)row & 15) != 0 && left > 0)
+        {
+            *row++ = color;
+            left--;
+        }
+        uint32_t blocks = left / PIE_BLOCK_PIXELS;
+        if (blocks > 0)
+        {
+            lv_draw_sw_pie_fill16(row, blocks, color32);
+            row += blocks * PIE_BLOCK_PIXELS;
+            left -= blocks * PIE_BLOCK_PIXELS;
+        }
+        while (left-- > 0) *row++ = color;
+    }
+    return LV_RESULT_OK;
+#else
+    return LV_RESULT_INVALID;
+#endif
+}
+
+lv_result_t lv_draw_sw_pie_copy_rgb565(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride,
+    const uint16_t *src, int32_t src_stride)
+{
+#if LV_DRAW_SW_PIE_KERNELS
+    if (w < PIE_MIN_WIDTH) return LV_RESULT_INVALID;
+
+    int32_t y;
+    for (y = 0; y < h; ++y)
+    {
+        uint16_t *d = row_at(dest, dest_stride, y);
+        const uint16_t *s = const_row_at(src, src_stride, y);
+        int32_t left = w;
+
+        while (((uintptr_t)d & 15) != 0 && left > 0)
+        {
+            *d++ = *s++;
+            left--;
+        }
+        uint32_t blocks = left / PIE_BLOCK_PIXELS;
+        if (blocks > 0)
+        {
+            if (((uintptr_t)s & 15) == 0) lv_draw_sw_pie_copy16(d, s, blocks);
+            else lv_draw_sw_pie_copy16_unaligned(d, s, blocks);
+            d += blocks * PIE_BLOCK_PIXELS;
+            s += blocks * PIE_BLOCK_PIXELS;
+            left -= blocks * PIE_BLOCK_PIXELS;
+        }
+        while (left-- > 0) *d++ = *s++;
+    }
+    return LV_RESULT_OK;
+#else
+    return LV_RESULT_INVALID;
+#endif
+}
+
+static void fill_pattern(uint16_t *buf, uint32_t count, uint16_t seed)
+{
+    uint32_t i;
+    for (i = 0; i < count; ++i) buf[i] = (uint16_t)(seed + i * 0x9E37U);
+}
+
+static bool check_result(const char *name, const uint16_t *expected, const uint16_t *actual, uint32_t count,
+    uint32_t ref_cycles, uint32_t fast_cycles, lv_result_t res)
+{
+    if (res != LV_RESULT_OK)
+    {
+        ESP_LOGI(TAG, "%s: not accelerated on this target", name);
+        return true;
+    }
+    if (memcmp(expected, actual, count * sizeof(uint16_t)) != 0)
+    {
+        ESP_LOGE(TAG, "%s: MISMATCH with the reference", name);
+        return false;
+    }
+    ESP_LOGI(TAG, "%s: bit-exact, ref %" PRIu32 " cycles, fast %" PRIu32 " cycles", name, ref_cycles, fast_cycles);
+    return true;
+}
+
+bool lv_draw_sw_pie_selftest(void)
+{
+    //One extra column on each side so the kernels run with unaligned starts and strides
+    const int32_t stride = (SELFTEST_WIDTH + 2) * sizeof(uint16_t);
+    const uint32_t count = (SELFTEST_WIDTH + 2) * SELFTEST_HEIGHT;
+    uint16_t *expected = heap_caps_malloc(count * sizeof(uint16_t), MALLOC_CAP_INTERNAL);
+    uint16_t *actual = heap_caps_malloc(count * sizeof(uint16_t), MALLOC_CAP_INTERNAL);
+    uint16_t *src = heap_caps_malloc(count * sizeof(uint16_t), MALLOC_CAP_INTERNAL);
+    uint32_t start, ref_cycles, fast_cycles;
+    lv_result_t res;
+    bool ok = false;
+
+    if (expected == NULL || actual == NULL || src == NULL)
+    {
+        ESP_LOGE(TAG, "Not enough memory for selftest");
+        goto cleanup;
+    }
+    fill_pattern(src, count, 0x1234);
+
+    fill_pattern(expected, count, 0xBEEF);
+    fill_pattern(actual, count, 0xBEEF);
+    start = esp_cpu_get_cycle_count();
+    lv_draw_sw_pie_fill_rgb565_ref(expected + 1, SELFTEST_WIDTH, SELFTEST_HEIGHT, stride, 0xF81F);
+    ref_cycles = esp_cpu_get_cycle_count() - start;
+    start = esp_cpu_get_cycle_count();
+    res = lv_draw_sw_pie_fill_rgb565(actual + 1, SELFTEST_WIDTH, SELFTEST_HEIGHT, stride, 0xF81F);
+    fast_cycles = esp_cpu_get_cycle_count() - start;
+    ok = check_result("fill", expected, actual, count, ref_cycles, fast_cycles, res);
+
+    fill_pattern(expected, count, 0xBEEF);
+    fill_pattern(actual, count, 0xBEEF);
+    start = esp_cpu_get_cycle_count();
+    lv_draw_sw_pie_copy_rgb565_ref(expected + 1, SELFTEST_WIDTH, SELFTEST_HEIGHT, stride, src + 2, stride);
+    ref_cycles = esp_cpu_get_cycle_count() - start;
+    start = esp_cpu_get_cycle_count();
+    res = lv_draw_sw_pie_copy_rgb565(actual + 1, SELFTEST_WIDTH, SELFTEST_HEIGHT, stride, src + 2, stride);
+    fast_cycles = esp_cpu_get_cycle_count() - start;
+    ok &= check_result("copy", expected, actual, count, ref_cycles, fast_cycles, res);
+
+cleanup:
+    heap_caps_free(expected);
+    heap_caps_free(actual);
+    heap_caps_free(src);
+    return ok;
+}
\ No newline at end of file
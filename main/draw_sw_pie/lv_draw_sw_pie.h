@@ -0,0 +1,36 @@
+#pragma once
+
+/*
+ * Custom draw-SW assembly backend (LV_DRAW_SW_ASM_CUSTOM) for the ESP32-S3.
+ * Included by LVGL's RGB565 blend routines, so it must not pull in any ESP-IDF headers.
+ *
+ * Only the opaque fill and the opaque RGB565 copy have kernels. Blends with an opacity or a mask
+ * stay on LVGL's C path: its packed 5-bit channel mix rounds in a way the PIE 16-bit multiplies
+ * do not reproduce bit-exactly. There is no byte-swap kernel either, the panel is set to
+ * little-endian RGB565 so the flush path never swaps.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+
+#define LV_DRAW_SW_COLOR_BLEND_TO_RGB565(dsc) \
+    lv_draw_sw_pie_fill_rgb565((uint16_t *)(dsc)->dest_buf, (dsc)->dest_w, (dsc)->dest_h, \
+        (dsc)->dest_stride, lv_color_to_u16((dsc)->color))
+
+#define LV_DRAW_SW_RGB565_BLEND_NORMAL_TO_RGB565(dsc) \
+    lv_draw_sw_pie_copy_rgb565((uint16_t *)(dsc)->dest_buf, (dsc)->dest_w, (dsc)->dest_h, \
+        (dsc)->dest_stride, (const uint16_t *)(dsc)->src_buf, (dsc)->src_stride)
+
+//Strides are in bytes as in LVGL's blend descriptors
+lv_result_t lv_draw_sw_pie_fill_rgb565(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride, uint16_t color);
+lv_result_t lv_draw_sw_pie_copy_rgb565(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride,
+    const uint16_t *src, int32_t src_stride);
+
+//Scalar reference implementations, bit-exact with LVGL's C paths
+void lv_draw_sw_pie_fill_rgb565_ref(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride, uint16_t color);
+void lv_draw_sw_pie_copy_rgb565_ref(uint16_t *dest, int32_t w, int32_t h, int32_t dest_stride,
+    const uint16_t *src, int32_t src_stride);
+
+//Compares every kernel against its reference and logs cycle counts for one display strip, false on a mismatch
+bool lv_draw_sw_pie_selftest(void);
\ No newline at end of file
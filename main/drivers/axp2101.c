@@ -3,38 +3,347 @@
 
 #include "axp2101.h"
 #include "i2c_controller.h"
+#include "t_watch_s3.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
 #include <esp_log.h>
+#include <esp_check.h>
+#include <string.h>
+#include <assert.h>
 
 static const char *TAG = "axp2101";
 static i2c_master_dev_handle_t dev_handle;
+static i2c_reg_cache_t reg_cache;
+static volatile uint8_t battery_percentage;
+static volatile bool vbus_present;
+static axp2101_event_cb_t event_cb = NULL;
+static void *event_user_data = NULL;
+static axp2101_adc_cb_t adc_cb = NULL;
+static void *adc_user_data = NULL;
+static SemaphoreHandle_t rail_mutex;
+static uint8_t rail_refs[Axp2101RailCount];
+static int64_t rail_on_since_us[Axp2101RailCount];     //0 while off
+static uint64_t rail_on_total_us[Axp2101RailCount];
+static int64_t rail_ready_us[Axp2101RailCount];        //End of the ramp after the last switch-on
+static axp2101_rail_cb_t rail_cb[Axp2101RailCount];     //Of the queued acquire, one per rail
+static void *rail_cb_user_data[Axp2101RailCount];
+
+typedef struct
+{
+    const char *name;
+    uint8_t mask;
+    uint16_t ramp_ms;   //Until the load is usable after the LDO is switched on
+} rail_info_t;
+
+static const rail_info_t rails[Axp2101RailCount] = {
+    [Axp2101RailRtc] = { "rtc", AXP2101_LDO_ALDO1, 1 },
+    [Axp2101RailBacklight] = { "backlight", AXP2101_LDO_ALDO2, 1 },
+    [Axp2101RailTouch] = { "touch", AXP2101_LDO_ALDO3, 300 },   //FT6x36 power-on to first I2C access
+    [Axp2101RailRadio] = { "radio", AXP2101_LDO_ALDO4, 5 },
+    [Axp2101RailHaptic] = { "haptic", AXP2101_LDO_BLDO2, 1 }
+};
+
+static const i2c_reg_range_t volatile_regs[] = {
+    { XPOWERS_AXP2101_STATUS1, XPOWERS_AXP2101_STATUS2 },
+    { XPOWERS_AXP2101_RESET_FUEL_GAUGE, XPOWERS_AXP2101_RESET_FUEL_GAUGE },
+    { XPOWERS_AXP2101_PWRON_STATUS, XPOWERS_AXP2101_PWROFF_STATUS },
+    { XPOWERS_AXP2101_ADC_DATA_RELUST0, XPOWERS_AXP2101_ADC_DATA_RELUST9 },
+    { XPOWERS_AXP2101_INTSTS1, XPOWERS_AXP2101_INTSTS3 },
+    { XPOWERS_AXP2101_BAT_PERCENT_DATA, XPOWERS_AXP2101_BAT_PERCENT_DATA }
+};
+
+//Grouped into consecutive runs so each run is one burst, rail voltages are set before the rails are switched
+static const i2c_reg_init_t init_table[] = {
+    I2C_REG_MASKED(XPOWERS_AXP2101_INPUT_CUR_LIMIT_CTRL, 0U, 0x07U), //100mA current limit
+    I2C_REG_MASKED(XPOWERS_AXP2101_VOFF_SET, 0U, 0x07U), //2.6V power-off threshold
+    I2C_REG(XPOWERS_AXP2101_IRQ_OFF_ON_LEVEL_CTRL, 0x10U), //Set fastest on/off times
+    I2C_REG(XPOWERS_AXP2101_ADC_CHANNEL_CTRL, 0x1DU), //Battery, VBUS, system voltage and die temperature
+    I2C_REG(XPOWERS_AXP2101_IPRECHG_SET, 2U), //50mA precharge current limit
+    I2C_REG(XPOWERS_AXP2101_ICC_CHG_SET, 4U), //100mA constant current charge current limit
+    I2C_REG(XPOWERS_AXP2101_ITERM_CHG_SET_CTRL, 1U), //25mA termination current limit
+    I2C_REG(XPOWERS_AXP2101_CV_CHG_VOL_SET, 4U), //4.35V charge voltage limit
+    I2C_REG(XPOWERS_AXP2101_BTN_BAT_CHG_VOL_SET, 7U), //3.3V button battery charge termination voltage
+    I2C_REG(XPOWERS_AXP2101_CHARGE_GAUGE_WDT_CTRL, 0xEU), //Button battery charge enable
+    I2C_REG(XPOWERS_AXP2101_DC_ONOFF_DVM_CTRL, 1U), //Only enable DC1
+    I2C_REG(XPOWERS_AXP2101_LDO_VOL0_CTRL, 0x1CU), //RTC output voltage 3.3v
+    I2C_REG(XPOWERS_AXP2101_LDO_VOL1_CTRL, 0x1CU), //TFT backlight output voltage 3.3v
+    I2C_REG(XPOWERS_AXP2101_LDO_VOL2_CTRL, 0x1CU), //Touch output voltage 3.3v
+    I2C_REG(XPOWERS_AXP2101_LDO_VOL3_CTRL, 0x1CU), //Radio output voltage 3.3v
+    I2C_REG(XPOWERS_AXP2101_LDO_VOL5_CTRL, 0x1CU), //Vibrate output voltage 3.3v
+    //RTC, backlight and touch stay as the bootloader left them, radio and haptics wait for a user
+    I2C_REG(XPOWERS_AXP2101_LDO_ONOFF_CTRL0, AXP2101_LDO_ALDO1 | AXP2101_LDO_ALDO2 | AXP2101_LDO_ALDO3),
+    I2C_REG(XPOWERS_AXP2101_LDO_ONOFF_CTRL1, 0U), //Disable DLDO2
+    I2C_REG(XPOWERS_AXP2101_INTEN1, AXP2101_IRQ_ENABLED & 0xFFU),
+    I2C_REG(XPOWERS_AXP2101_INTEN2, (AXP2101_IRQ_ENABLED >> 8) & 0xFFU),
+    I2C_REG(XPOWERS_AXP2101_INTEN3, (AXP2101_IRQ_ENABLED >> 16) & 0xFFU),
+    I2C_REG_MASKED(XPOWERS_AXP2101_INTSTS1, 0xFFU, 0), //Clear what is pending from before boot
+    I2C_REG_MASKED(XPOWERS_AXP2101_INTSTS2, 0xFFU, 0),
+    I2C_REG_MASKED(XPOWERS_AXP2101_INTSTS3, 0xFFU, 0)
+};
+
+//Rails the init table left on are counted from boot
+static void start_rail_clocks(void)
+{
+    uint8_t enabled = 0;
+    uint8_t i;
+    i2c_cache_read(&reg_cache, XPOWERS_AXP2101_LDO_ONOFF_CTRL0, &enabled);
+    for (i = 0; i < Axp2101RailCount; ++i)
+    {
+        if (enabled & rails[i].mask) rail_on_since_us[i] = esp_timer_get_time();
+    }
+}
 
 void axp2101_init(i2c_master_dev_handle_t dev)
 {
     dev_handle = dev;
+    rail_mutex = xSemaphoreCreateMutex();
+    assert(rail_mutex != NULL);
+    i2c_cache_init(&reg_cache, dev_handle, volatile_regs, sizeof(volatile_regs) / sizeof(volatile_regs[0]));
+
+    ESP_ERROR_CHECK(i2c_write_init_table(dev_handle, init_table, sizeof(init_table) / sizeof(init_table[0])));
+    i2c_cache_seed(&reg_cache, init_table, sizeof(init_table) / sizeof(init_table[0]));
+    start_rail_clocks();
+    ESP_ERROR_CHECK(axp2101_rail_acquire(Axp2101RailRtc, NULL));
+
+    uint8_t value = 0;
+    i2c_cache_read(&reg_cache, XPOWERS_AXP2101_BAT_PERCENT_DATA, &value);
+    battery_percentage = value;
+    value = 0;
+    i2c_cache_read(&reg_cache, XPOWERS_AXP2101_STATUS1, &value);
+    vbus_present = (value & XPOWERS_AXP2101_STATUS1_VBUS_GOOD) != 0;
+}
+
+static void battery_percentage_done(esp_err_t err, const uint8_t *data, size_t len, void *user_data)
+{
+    if (err == ESP_OK) battery_percentage = data[0];
+}
+
+esp_err_t axp2101_request_battery_percentage(void)
+{
+    return i2c_submit_read(dev_handle, XPOWERS_AXP2101_BAT_PERCENT_DATA, 1, battery_percentage_done, NULL);
+}
+
+//Runs in the I2C worker, the status bits read are written back to clear exactly those
+static void irq_status_done(esp_err_t err, const uint8_t *data, size_t len, void *user_data)
+{
+    uint8_t status[XPOWERS_AXP2101_INTSTS_CNT];
+    uint8_t value;
+    uint32_t events = 0;
+    uint8_t pass;
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "IRQ status read failed: %s", esp_err_to_name(err));
+        gpio_intr_enable(BOARD_PMU_INT);
+        return;
+    }
+    memcpy(status, data, sizeof(status));
+
+    //INT is level low while any status bit is set, a source raised after the read keeps it low without a new edge
+    for (pass = 0; pass < AXP2101_IRQ_MAX_PASSES; ++pass)
+    {
+        events |= status[0] | ((uint32_t)status[1] << 8) | ((uint32_t)status[2] << 16);
+        if (i2c_write_registers(dev_handle, XPOWERS_AXP2101_INTSTS1, status, sizeof(status)) != ESP_OK) break;
+        if (gpio_get_level(BOARD_PMU_INT) != 0) break;
+        if (i2c_read_registers(dev_handle, XPOWERS_AXP2101_INTSTS1, status, sizeof(status)) != ESP_OK) break;
+    }
+    events &= AXP2101_IRQ_ENABLED;
+    gpio_intr_enable(BOARD_PMU_INT);
+
+    //INSERT and REMOVE can land in one batch, only STATUS1 says which came last
+    if (events != 0 && i2c_cache_read(&reg_cache, XPOWERS_AXP2101_STATUS1, &value) == ESP_OK)
+    {
+        vbus_present = (value & XPOWERS_AXP2101_STATUS1_VBUS_GOOD) != 0;
+    }
+    if (events & (AXP2101_IRQ_SOC_NEW | AXP2101_IRQ_VBUS_INSERT | AXP2101_IRQ_VBUS_REMOVE | AXP2101_IRQ_CHG_DONE))
+    {
+        if (i2c_read_register(dev_handle, XPOWERS_AXP2101_BAT_PERCENT_DATA, &value) == ESP_OK) battery_percentage = value;
+    }
+    if (events != 0 && event_cb != NULL)
+    {
+        event_cb(events, event_user_data);
+    }
+}
+
+//INT may be level triggered (light sleep wake-up), so it stays masked until the status is cleared
+static void axp2101_isr(void *arg)
+{
+    BaseType_t task_woken = pdFALSE;
+    gpio_intr_disable(BOARD_PMU_INT);
+    if (i2c_submit_read_from_isr(dev_handle, XPOWERS_AXP2101_INTSTS1, XPOWERS_AXP2101_INTSTS_CNT, irq_status_done, NULL,
+        &task_woken) != ESP_OK)
+    {
+        gpio_intr_enable(BOARD_PMU_INT);
+    }
+    portYIELD_FROM_ISR(task_woken);
+}
+
+//Needs the GPIO ISR service, which ft5436_init installs
+esp_err_t axp2101_irq_init(axp2101_event_cb_t cb, void *user_data)
+{
+    event_cb = cb;
+    event_user_data = user_data;
+
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_NEGEDGE,
+        .pin_bit_mask = 1ULL << BOARD_PMU_INT,
+        .mode = GPIO_MODE_INPUT,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+    };
+    ESP_RETURN_ON_ERROR(gpio_config(&io_conf), TAG, "PMU INT pin");
+    ESP_RETURN_ON_ERROR(gpio_isr_handler_add(BOARD_PMU_INT, axp2101_isr, NULL), TAG, "PMU INT handler");
+
+    //An edge before the handler was added is lost, drain whatever is pending now
+    if (gpio_get_level(BOARD_PMU_INT) == 0)
+    {
+        return i2c_submit_read(dev_handle, XPOWERS_AXP2101_INTSTS1, XPOWERS_AXP2101_INTSTS_CNT, irq_status_done, NULL);
+    }
+    return ESP_OK;
+}
+
+bool axp2101_is_vbus_present(void)
+{
+    return vbus_present;
+}
 
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_INPUT_CUR_LIMIT_CTRL, 0U)); //100mA current limit
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_VOFF_SET, 0U)); //2.6V power-off threshold
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_LDO_VOL0_CTRL, 0x1CU)); //RTC output voltage 3.3v
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_LDO_VOL1_CTRL, 0x1CU)); //TFT backlight output voltage 3.3v
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_LDO_VOL2_CTRL, 0x1CU)); //Touch output voltage 3.3v
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_LDO_VOL3_CTRL, 0x1CU)); //Radio output voltage 3.3v
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_LDO_VOL5_CTRL, 0x1CU)); //Vibrate output voltage 3.3v
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_DC_ONOFF_DVM_CTRL, 1U)); //Only enable DC1
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_LDO_ONOFF_CTRL1, 0U)); //Disable DLDO2
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_LDO_ONOFF_CTRL0, 0x2FU)); //Enable peripheral LDOs
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_IRQ_OFF_ON_LEVEL_CTRL, 0x10U)); //Set fastest on/off times
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_ADC_CHANNEL_CTRL, 0xDU)); //Set correct measurement channels
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_IPRECHG_SET, 2U)); //50mA precharge current limit
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_ICC_CHG_SET, 4U)); //100mA constant current charge current limit
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_ITERM_CHG_SET_CTRL, 1U)); //25mA termination current limit
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_CV_CHG_VOL_SET, 4U)); //4.35V charge voltage limit
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_BTN_BAT_CHG_VOL_SET, 7U)); //3.3V button battery charge termination voltage
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, XPOWERS_AXP2101_CHARGE_GAUGE_WDT_CTRL, 0xEU)); //Button battery charge enable
+//Results are big endian, voltages are 13 or 14 bit mV, the die temperature is a raw sensor code
+static void adc_done(esp_err_t err, const uint8_t *data, size_t len, void *user_data)
+{
+    axp2101_adc_t adc;
+
+    if (err != ESP_OK)
+    {
+        adc_cb(NULL, adc_user_data);
+        return;
+    }
+    adc.battery_mv = ((uint16_t)(data[0] & 0x1FU) << 8) | data[1];
+    adc.vbus_mv = vbus_present ? ((uint16_t)(data[4] & 0x3FU) << 8) | data[5] : 0;
+    adc.system_mv = ((uint16_t)(data[6] & 0x3FU) << 8) | data[7];
+    int32_t temp_raw = ((int32_t)(data[8] & 0x3FU) << 8) | data[9];
+    adc.die_temp_dc = (int16_t)(220 + (7274 - temp_raw) / 2); //XPOWERS_AXP2101_CONVERSION in 0.1 degC
+    adc_cb(&adc, adc_user_data);
+}
+
+esp_err_t axp2101_request_adc(axp2101_adc_cb_t cb, void *user_data)
+{
+    adc_cb = cb;
+    adc_user_data = user_data;
+    return i2c_submit_read(dev_handle, XPOWERS_AXP2101_ADC_DATA_RELUST0, AXP2101_ADC_DATA_SIZE, adc_done, NULL);
+}
+
+//The on/off register is cached, so a rail change is one write and a rail that is already on costs none
+static esp_err_t set_rail(axp2101_rail_t rail, bool on)
+{
+    uint8_t mask = rails[rail].mask;
+    ESP_RETURN_ON_ERROR(i2c_cache_update_bits(&reg_cache, XPOWERS_AXP2101_LDO_ONOFF_CTRL0, mask, on ? mask : 0), TAG, "rails");
+    ESP_RETURN_ON_ERROR(i2c_cache_commit(&reg_cache), TAG, "rails");
+
+    int64_t now_us = esp_timer_get_time();
+    if (on)
+    {
+        rail_on_since_us[rail] = now_us;
+    }
+    else if (rail_on_since_us[rail] != 0)
+    {
+        rail_on_total_us[rail] += now_us - rail_on_since_us[rail];
+        rail_on_since_us[rail] = 0;
+    }
+    return ESP_OK;
 }
 
+esp_err_t axp2101_rail_acquire(axp2101_rail_t rail, bool *powered_up)
+{
+    uint8_t enabled = 0;
+    esp_err_t err = ESP_OK;
+    bool switched = false;
+
+    xSemaphoreTake(rail_mutex, portMAX_DELAY);
+    if (rail_refs[rail] == 0)
+    {
+        err = i2c_cache_read(&reg_cache, XPOWERS_AXP2101_LDO_ONOFF_CTRL0, &enabled);
+        switched = err == ESP_OK && (enabled & rails[rail].mask) == 0;
+        if (switched) err = set_rail(rail, true);
+        if (switched && err == ESP_OK) rail_ready_us[rail] = esp_timer_get_time() + rails[rail].ramp_ms * 1000;
+    }
+    if (err == ESP_OK) rail_refs[rail]++;
+    int64_t ready_us = rail_ready_us[rail];
+    xSemaphoreGive(rail_mutex);
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Rail %s on failed: %s", rails[rail].name, esp_err_to_name(err));
+        return err;
+    }
+    if (switched) ESP_LOGD(TAG, "Rail %s on", rails[rail].name);
+    //A second user that arrives during the ramp waits for the same deadline, outside the mutex so other rails go on
+    int64_t wait_us = ready_us - esp_timer_get_time();
+    if (wait_us > 0)
+    {
+        vTaskDelay(pdMS_TO_TICKS((wait_us + 999) / 1000));
+    }
+    if (powered_up != NULL) *powered_up = switched;
+    return ESP_OK;
+}
+
+//Runs in the system bus worker, the ramp is waited out there too
+static void rail_acquire_job(void *arg)
+{
+    axp2101_rail_t rail = (axp2101_rail_t)(intptr_t)arg;
+    esp_err_t err = axp2101_rail_acquire(rail, NULL);
+    if (rail_cb[rail] != NULL) rail_cb[rail](err, rail_cb_user_data[rail]);
+}
+
+static void rail_release_job(void *arg)
+{
+    axp2101_rail_t rail = (axp2101_rail_t)(intptr_t)arg;
+    esp_err_t err = axp2101_rail_release(rail);
+    if (err != ESP_OK) ESP_LOGW(TAG, "Rail %s off failed: %s", rails[rail].name, esp_err_to_name(err));
+}
+
+esp_err_t axp2101_rail_acquire_async(axp2101_rail_t rail, axp2101_rail_cb_t cb, void *user_data)
+{
+    rail_cb[rail] = cb;
+    rail_cb_user_data[rail] = user_data;
+    return i2c_submit_call(I2C_BUS_SYSTEM, rail_acquire_job, (void *)(intptr_t)rail);
+}
+
+esp_err_t axp2101_rail_release_async(axp2101_rail_t rail)
+{
+    return i2c_submit_call(I2C_BUS_SYSTEM, rail_release_job, (void *)(intptr_t)rail);
+}
+
+uint64_t axp2101_rail_get_on_time_us(axp2101_rail_t rail)
+{
+    xSemaphoreTake(rail_mutex, portMAX_DELAY);
+    uint64_t total_us = rail_on_total_us[rail];
+    if (rail_on_since_us[rail] != 0) total_us += esp_timer_get_time() - rail_on_since_us[rail];
+    xSemaphoreGive(rail_mutex);
+    return total_us;
+}
+
+esp_err_t axp2101_rail_release(axp2101_rail_t rail)
+{
+    esp_err_t err = ESP_OK;
+
+    xSemaphoreTake(rail_mutex, portMAX_DELAY);
+    if (rail_refs[rail] == 0)
+    {
+        err = ESP_ERR_INVALID_STATE;
+    }
+    else if (--rail_refs[rail] == 0)
+    {
+        err = set_rail(rail, false);
+        if (err == ESP_OK) ESP_LOGD(TAG, "Rail %s off", rails[rail].name);
+    }
+    xSemaphoreGive(rail_mutex);
+    return err;
+}
+
+//Last completed reading, never touches the bus
 uint8_t axp2101_get_battery_percentage()
 {
-    uint8_t value = 0;
-    i2c_read_register(dev_handle, XPOWERS_AXP2101_BAT_PERCENT_DATA, &value);
-    return value;
-}
\ No newline at end of file
+    return battery_percentage;
+}
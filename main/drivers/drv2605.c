@@ -1,30 +1,89 @@
 #include "drv2605.h"
 #include "i2c_controller.h"
+#include "axp2101.h"
 #include <esp_log.h>
+#include <esp_check.h>
 
 static const char *TAG = "drv2605";
 static i2c_master_dev_handle_t dev_handle;
+static i2c_reg_cache_t reg_cache;
+static bool rail_held;
+
+static const i2c_reg_range_t volatile_regs[] = {
+    { DRV2605_REG_STATUS, DRV2605_REG_STATUS },
+    { DRV2605_REG_GO, DRV2605_REG_GO },
+    { DRV2605_REG_AUTOCALCOMP, DRV2605_REG_AUTOCALEMP },
+    { DRV2605_REG_VBAT, DRV2605_REG_LRARESON }
+};
+
+//Waveform sequence and strength are left to the pattern engine
+static const i2c_reg_init_t init_table[] = {
+    I2C_REG(DRV2605_REG_MODE, DRV2605_MODE_INTTRIG),
+    I2C_REG(DRV2605_REG_LIBRARY, 1U)    //ERM library A, the reset value selects the empty library
+};
 
 void drv2605_init(i2c_master_dev_handle_t dev)
 {
     dev_handle = dev;
+    i2c_cache_init(&reg_cache, dev_handle, volatile_regs, sizeof(volatile_regs) / sizeof(volatile_regs[0]));
+
+    //The haptic rail is off until the first effect, the table is written each time it comes up
+    i2c_cache_seed(&reg_cache, init_table, sizeof(init_table) / sizeof(init_table[0]));
+}
+
+//Unchanged slots cost no bus traffic, changed ones are sent as one burst
+esp_err_t drv2605_load_sequence(const uint8_t sequence[DRV2605_WAVESEQ_COUNT])
+{
+    uint8_t i;
+    for (i = 0; i < DRV2605_WAVESEQ_COUNT; ++i)
+    {
+        ESP_RETURN_ON_ERROR(i2c_cache_write(&reg_cache, DRV2605_REG_WAVESEQ1 + i, sequence[i]), TAG, "sequence");
+    }
+    //While unpowered the change stays dirty and goes out with the rest of the configuration
+    if (!rail_held) return ESP_OK;
+    return i2c_cache_commit(&reg_cache);
+}
+
+esp_err_t drv2605_go(void)
+{
+    bool powered_up = false;
+
+    if (!rail_held)
+    {
+        ESP_RETURN_ON_ERROR(axp2101_rail_acquire(Axp2101RailHaptic, &powered_up), TAG, "rail");
+        rail_held = true;
+    }
+    if (powered_up) i2c_cache_restore(&reg_cache);
+    ESP_RETURN_ON_ERROR(i2c_cache_commit(&reg_cache), TAG, "configuration");
+    return i2c_cache_write(&reg_cache, DRV2605_REG_GO, 1U);
+}
 
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, DRV2605_REG_MODE, 0U));
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, DRV2605_REG_AUDIOMAX, 100U)); //100/255 strength
-    //ESP_ERROR_CHECK(i2c_write_register(dev_handle, DRV2605_REG_WAVESEQ1, 1U)); //Strong Click 100%
-    //ESP_ERROR_CHECK(i2c_write_register(dev_handle, DRV2605_REG_WAVESEQ1, 13U)); //Soft Fuzz 60%
-    //ESP_ERROR_CHECK(i2c_write_register(dev_handle, DRV2605_REG_WAVESEQ1, 24U)); //Sharp Tick 1 100%
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, DRV2605_REG_WAVESEQ1, 47U)); //Buzz 1 100%
-    //ESP_ERROR_CHECK(i2c_write_register(dev_handle, DRV2605_REG_WAVESEQ1, 52U)); //Pulsing Strong 1 100%
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, DRV2605_REG_WAVESEQ2, 0U));
+esp_err_t drv2605_stop(void)
+{
+    if (!rail_held) return ESP_OK;
+    return i2c_cache_write(&reg_cache, DRV2605_REG_GO, 0U);
 }
-    
-void drv2605_go()
+
+//GO clears itself at the end of the sequence
+esp_err_t drv2605_is_playing(bool *playing)
 {
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, DRV2605_REG_GO, 1U));
+    uint8_t go = 0;
+
+    if (!rail_held)
+    {
+        *playing = false;
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_ERROR(i2c_cache_read(&reg_cache, DRV2605_REG_GO, &go), TAG, "go");
+    *playing = (go & 1U) != 0;
+    return ESP_OK;
 }
 
-void drv2605_stop()
+esp_err_t drv2605_power_down(void)
 {
-    ESP_ERROR_CHECK(i2c_write_register(dev_handle, DRV2605_REG_GO, 0U));
-}
\ No newline at end of file
+    if (!rail_held) return ESP_OK;
+
+    ESP_RETURN_ON_ERROR(axp2101_rail_release(Axp2101RailHaptic), TAG, "rail");
+    rail_held = false;
+    return ESP_OK;
+}
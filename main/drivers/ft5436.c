@@ -2,6 +2,7 @@
 #include "i2c_controller.h"
 #include "t_watch_s3.h"
 #include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
 #include <esp_log.h>
 #include <esp_timer.h>
 
@@ -10,16 +11,20 @@ static const char *TAG = "ft5436";
 static void(*ft5436_isrHandler)(void *arg) = NULL;
 
 static i2c_master_dev_handle_t dev_handle;
-static uint8_t touch_cnt;
-static uint16_t touch_x[2];
-static uint16_t touch_y[2];
-static uint16_t touch_event[2];
+static ft5436_touch_data_t touch_data;
 static uint8_t rotation_index = 0;
 static uint16_t touch_width = 0;
 static uint16_t touch_height = 0;
+static uint8_t touch_threshold = FT6X36_DEFAULT_THRESHOLD;
+static ft5436_gesture_config_t gesture_config;
+static bool gestures_configured = false;
+static ft5436_touch_cb_t touch_cb = NULL;
+static void *touch_user_data = NULL;
 
+static void parse_data(const uint8_t *data, ft5436_touch_data_t *out);
 static bool read_data(void);
-static void swap(uint16_t *a, uint16_t *b);
+static esp_err_t write_config(void);
+static void swap_xy(ft5436_touch_point_t *point);
 
 void ft5436_init(i2c_master_dev_handle_t dev, uint8_t threshold)
 {
@@ -54,9 +59,8 @@ void ft5436_init(i2c_master_dev_handle_t dev, uint8_t threshold)
     esp_err_t isr_service = gpio_install_isr_service(0);
     ESP_LOGI(TAG, "ISR trigger install response: 0x%x %s", isr_service, (isr_service==0)?"ESP_OK":"");
 
-	ESP_ERROR_CHECK(i2c_write_register(dev_handle, FT6X36_REG_DEVICE_MODE, 0x00));
-	ESP_ERROR_CHECK(i2c_write_register(dev_handle, FT6X36_REG_THRESHHOLD, threshold));
-	ESP_ERROR_CHECK(i2c_write_register(dev_handle, FT6X36_REG_TOUCHRATE_ACTIVE, 0x0E));
+	touch_threshold = threshold;
+	ESP_ERROR_CHECK(write_config());
 }
 
 void ft5436_register_isr_handler(void (*fn)(void *arg)){
@@ -70,22 +74,22 @@ void ft5436_xy_touch(ft5436_point_t *point, uint8_t *count)
 
 	if (point != NULL)
 	{
-		point->x = touch_x[0];
-		point->y = touch_y[0];
+		point->x = touch_data.points[0].x;
+		point->y = touch_data.points[0].y;
 	}
 
-	*count = touch_cnt; 
+	*count = touch_data.count; 
 }
 
 void ft5436_xy_event(ft5436_point_t *point, ft5436_event_t *e)
 {
 	read_data();
-	ft5436_raw_event_t event = (ft5436_raw_event_t)touch_event[0];
+	ft5436_raw_event_t event = (ft5436_raw_event_t)touch_data.points[0].event;
 
 	if (point != NULL)
 	{
-		point->x = touch_x[0];
-		point->y = touch_y[0];
+		point->x = touch_data.points[0].x;
+		point->y = touch_data.points[0].y;
 	}
 	if (e != NULL)
 	{
@@ -105,6 +109,112 @@ void ft5436_xy_event(ft5436_point_t *point, ft5436_event_t *e)
 	}
 }
 
+bool ft5436_read_touch_data(ft5436_touch_data_t *data)
+{
+	bool ok = read_data();
+	*data = touch_data;
+	return ok;
+}
+
+static void touch_data_done(esp_err_t err, const uint8_t *data, size_t len, void *user_data)
+{
+	ft5436_touch_data_t touch = { 0 };
+	if (err == ESP_OK) parse_data(data, &touch);
+	touch_cb(err == ESP_OK, &touch, touch_user_data);
+}
+
+esp_err_t ft5436_request_touch_data(ft5436_touch_cb_t cb, void *user_data)
+{
+	touch_cb = cb;
+	touch_user_data = user_data;
+	return i2c_submit_read(dev_handle, FT6X36_REG_DEVICE_MODE, FT6X36_TOUCH_DATA_SIZE, touch_data_done, NULL);
+}
+
+// For the INT handler, the read then runs in the touch bus worker and never in the ISR
+esp_err_t ft5436_request_touch_data_from_isr(ft5436_touch_cb_t cb, void *user_data, BaseType_t *task_woken)
+{
+	touch_cb = cb;
+	touch_user_data = user_data;
+	return i2c_submit_read_from_isr(dev_handle, FT6X36_REG_DEVICE_MODE, FT6X36_TOUCH_DATA_SIZE, touch_data_done, NULL,
+		task_woken);
+}
+
+static esp_err_t write_gestures(void)
+{
+	const uint8_t regs[] = {
+		gesture_config.radian,
+		gesture_config.offset_left_right,
+		gesture_config.offset_up_down,
+		gesture_config.distance_left_right,
+		gesture_config.distance_up_down,
+		gesture_config.distance_zoom
+	};
+	return i2c_write_registers(dev_handle, FT6X36_REG_RADIAN_VALUE, regs, sizeof(regs));
+}
+
+// Kept so that ft5436_wake can restore them, hibernate resets the gesture engine too
+esp_err_t ft5436_configure_gestures(const ft5436_gesture_config_t *config)
+{
+	gesture_config = *config;
+	gestures_configured = true;
+	return write_gestures();
+}
+
+//Gesture ID and touch count only, for consumers that do not need coordinates
+esp_err_t ft5436_read_gesture(uint8_t *gesture_id, uint8_t *count)
+{
+	uint8_t data[2];
+	esp_err_t err = i2c_read_registers(dev_handle, FT6X36_REG_GESTURE_ID, data, sizeof(data));
+	if (err == ESP_OK)
+	{
+		*gesture_id = data[0];
+		*count = data[1] & 0x0F;
+	}
+	return err;
+}
+
+esp_err_t ft5436_set_report_rate(uint8_t rate)
+{
+	return i2c_write_register(dev_handle, FT6X36_REG_TOUCHRATE_ACTIVE, rate);
+}
+
+esp_err_t ft5436_set_monitor(bool auto_enter, uint8_t enter_time_s, uint8_t monitor_period)
+{
+	// CTRL and TIME_ENTER_MONITOR are consecutive, TOUCHRATE_ACTIVE sits between them and TOUCHRATE_MONITOR
+	const uint8_t regs[] = { auto_enter ? FT6X36_CTRL_AUTO_MONITOR : FT6X36_CTRL_KEEP_ACTIVE, enter_time_s };
+	esp_err_t err = i2c_write_registers(dev_handle, FT6X36_REG_CTRL, regs, sizeof(regs));
+	if (err != ESP_OK)
+	{
+		return err;
+	}
+	return i2c_write_register(dev_handle, FT6X36_REG_TOUCHRATE_MONITOR, monitor_period);
+}
+
+esp_err_t ft5436_set_power_mode(uint8_t mode)
+{
+	return i2c_write_register(dev_handle, FT6X36_REG_POWER_MODE, mode);
+}
+
+// Hibernate only ends on reset or a low pulse on INT, there is no reset line on this board.
+// The controller comes back with its power-on defaults, so the init table and gesture thresholds are written again.
+esp_err_t ft5436_wake(void)
+{
+	gpio_intr_disable(BOARD_TOUCH_INT);
+	gpio_set_direction(BOARD_TOUCH_INT, GPIO_MODE_OUTPUT);
+	gpio_set_level(BOARD_TOUCH_INT, 0);
+	vTaskDelay(pdMS_TO_TICKS(FT6X36_WAKE_PULSE_MS));
+	gpio_set_direction(BOARD_TOUCH_INT, GPIO_MODE_INPUT);
+	vTaskDelay(pdMS_TO_TICKS(FT6X36_WAKE_READY_MS));
+
+	esp_err_t err = write_config();
+	if (err == ESP_OK && gestures_configured)
+	{
+		err = write_gestures();
+	}
+	gpio_intr_enable(BOARD_TOUCH_INT);
+	return err;
+}
+
 void ft5436_set_rotation(uint8_t rotation) 
 {
 	rotation_index = rotation;
@@ -120,56 +230,80 @@ void ft5436_set_touch_height(uint16_t height)
 	touch_height = height;
 }
 
+static esp_err_t write_config(void)
+{
+	const i2c_reg_init_t init_table[] = {
+		I2C_REG_MASKED(FT6X36_REG_DEVICE_MODE, 0x00, 0x70),
+		I2C_REG(FT6X36_REG_THRESHHOLD, touch_threshold),
+		I2C_REG(FT6X36_REG_TOUCHRATE_ACTIVE, 0x0E),
+		I2C_REG(FT6X36_REG_INTERRUPT_MODE, FT6X36_INT_MODE_TRIGGER)
+	};
+	return i2c_write_init_table(dev_handle, init_table, sizeof(init_table) / sizeof(init_table[0]));
+}
+
+//One burst from DEVICE_MODE covers gesture, count and both points, half the bus time of two transfers
 static bool read_data(void)
 {
-    uint8_t data_size = 16U;     // Discarding last 2: 0x0E & 0x0F as not relevant
-    uint8_t data[data_size];
-    i2c_read_register(dev_handle, FT6X36_REG_NUM_TOUCHES, &touch_cnt);
-	i2c_master_receive(dev_handle, data, data_size, -1);
-	
-	/*
-    ESP_LOGD(TAG, "Registers:");
-    for (int16_t i = 0; i < data_size; i++)
-    {
-        ESP_LOGD(TAG, "%x:%hx", i, data[i]);
-    }
-	*/
-
-    const uint8_t addrShift = 6;
-	for (uint8_t i = 0; i < 2; i++)
+	uint8_t data[FT6X36_TOUCH_DATA_SIZE];
+	if (i2c_read_registers(dev_handle, FT6X36_REG_DEVICE_MODE, data, sizeof(data)) != ESP_OK)
 	{
-		touch_event[i] = data[0 + i * addrShift] >> 6;
-		touch_x[i] = data[1 + i * addrShift];
-		touch_y[i] = data[3 + i * addrShift];
+		touch_data.count = 0;
+		return false;
 	}
-	
+	parse_data(data, &touch_data);
+	return true;
+}
+
+static void parse_data(const uint8_t *data, ft5436_touch_data_t *out)
+{
+	out->gesture_id = data[FT6X36_REG_GESTURE_ID];
+	out->count = data[FT6X36_REG_NUM_TOUCHES] & 0x0F;
+	if (out->count > FT6X36_MAX_TOUCH_POINTS)
+	{
+		out->count = 0;	// Controller reports 0x0F while it has no valid data
+	}
+
+	const uint8_t addrShift = FT6X36_REG_P2_XH - FT6X36_REG_P1_XH;
+	for (uint8_t i = 0; i < FT6X36_MAX_TOUCH_POINTS; i++)
+	{
+		const uint8_t *p = &data[FT6X36_REG_P1_XH + i * addrShift];
+		ft5436_touch_point_t *point = &out->points[i];
+		point->event = p[0] >> 6;
+		point->x = ((p[0] & FT6X36_MSB_MASK) << 8) | (p[1] & FT6X36_LSB_MASK);
+		point->id = p[2] >> 4;
+		point->y = ((p[2] & FT6X36_MSB_MASK) << 8) | (p[3] & FT6X36_LSB_MASK);
+		point->weight = p[4];
+		point->area = p[5] >> 4;
+	}
+
+	ft5436_touch_point_t *p0 = &out->points[0];
+	ft5436_touch_point_t *p1 = &out->points[1];
 	switch (rotation_index)
   	{
 		case 1:
-			swap(&touch_x[0], &touch_y[0]);
-			swap(&touch_x[1], &touch_y[1]);
-			touch_y[0] = touch_width - touch_y[0] -1;
-			touch_y[1] = touch_width - touch_y[1] -1;
+			swap_xy(p0);
+			swap_xy(p1);
+			p0->y = touch_width - p0->y - 1;
+			p1->y = touch_width - p1->y - 1;
 			break;
 		case 2:
-			touch_x[0] = touch_width - touch_x[0] - 1;
-			touch_x[1] = touch_width - touch_x[1] - 1;
-			touch_y[0] = touch_height - touch_y[0] - 1;
-			touch_y[1] = touch_height - touch_y[1] - 1;
+			p0->x = touch_width - p0->x - 1;
+			p1->x = touch_width - p1->x - 1;
+			p0->y = touch_height - p0->y - 1;
+			p1->y = touch_height - p1->y - 1;
 			break;
 		case 3:
-			swap(&touch_x[0], &touch_y[0]);
-			swap(&touch_x[1], &touch_y[1]);
-			touch_x[0] = touch_height - touch_x[0] - 1;
-			touch_x[1] = touch_height - touch_x[1] - 1;
+			swap_xy(p0);
+			swap_xy(p1);
+			p0->x = touch_height - p0->x - 1;
+			p1->x = touch_height - p1->x - 1;
 			break;
   	}
-	return true;
 }
 
-static void swap(uint16_t *a, uint16_t *b) 
+static void swap_xy(ft5436_touch_point_t *point) 
 {
-    uint16_t *t = a;
-    *a = *b;
-    *b = *t;
+    uint16_t t = point->x;
+    point->x = point->y;
+    point->y = t;
 }
\ No newline at end of file
@@ -8,8 +8,12 @@
 #include "esp_lcd_panel_io.h"
 #include "esp_lcd_panel_vendor.h"
 #include "esp_lcd_panel_ops.h"
+#include "esp_lcd_panel_commands.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
 
 static const char *TAG = "st7789";
+static int64_t sleep_changed_us;
 
 void st7789_init(peripheral_handles_t *peripherals)
 {
@@ -29,7 +33,6 @@ void st7789_init(peripheral_handles_t *peripherals)
     };
     ESP_ERROR_CHECK(spi_bus_initialize(SPI2_HOST, &buscfg, SPI_DMA_CH_AUTO));
 
-    esp_lcd_panel_io_handle_t io_handle = NULL;
     esp_lcd_panel_io_spi_config_t io_config = {
         .dc_gpio_num = BOARD_TFT_DC,
         .cs_gpio_num = BOARD_TFT_CS,
@@ -39,7 +42,7 @@ void st7789_init(peripheral_handles_t *peripherals)
         .spi_mode = 0,
         .trans_queue_depth = 10
     };
-    ESP_ERROR_CHECK(esp_lcd_new_panel_io_spi((esp_lcd_spi_bus_handle_t)SPI2_HOST, &io_config, &io_handle));
+    ESP_ERROR_CHECK(esp_lcd_new_panel_io_spi((esp_lcd_spi_bus_handle_t)SPI2_HOST, &io_config, &(peripherals->st7789_io_handle)));
 
     esp_lcd_panel_dev_config_t panel_config = {
         .reset_gpio_num = -1,
@@ -47,10 +50,29 @@ void st7789_init(peripheral_handles_t *peripherals)
         .data_endian = LCD_RGB_DATA_ENDIAN_LITTLE,
         .bits_per_pixel = 16
     };
-    ESP_ERROR_CHECK(esp_lcd_new_panel_st7789(io_handle, &panel_config, &(peripherals->st7789_handle)));
+    ESP_ERROR_CHECK(esp_lcd_new_panel_st7789(peripherals->st7789_io_handle, &panel_config, &(peripherals->st7789_handle)));
     ESP_ERROR_CHECK(esp_lcd_panel_reset(peripherals->st7789_handle));
     ESP_ERROR_CHECK(esp_lcd_panel_init(peripherals->st7789_handle));
     ESP_ERROR_CHECK(esp_lcd_panel_mirror(peripherals->st7789_handle, true, true));
     ESP_ERROR_CHECK(esp_lcd_panel_invert_color(peripherals->st7789_handle, true));
     ESP_ERROR_CHECK(esp_lcd_panel_disp_on_off(peripherals->st7789_handle, true));
+}
+
+esp_err_t st7789_set_sleep(esp_lcd_panel_handle_t panel, bool sleep)
+{
+    //The panel ignores a sleep change that comes too soon after the previous one
+    int64_t settle_us = sleep_changed_us + ST7789_SLEEP_SETTLE_MS * 1000 - esp_timer_get_time();
+    if (sleep_changed_us != 0 && settle_us > 0)
+    {
+        vTaskDelay(pdMS_TO_TICKS((settle_us + 999) / 1000));
+    }
+
+    //The vendor driver sends SLPIN/SLPOUT and waits until the panel takes the next command
+    esp_err_t err = esp_lcd_panel_disp_sleep(panel, sleep);
+    sleep_changed_us = esp_timer_get_time();
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Sleep %d failed: %s", sleep, esp_err_to_name(err));
+    }
+    return err;
 }
\ No newline at end of file
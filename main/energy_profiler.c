@@ -0,0 +1,257 @@
+#include "energy_profiler.h"
+#include "axp2101.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char *TAG = "energy_profiler";
+
+typedef struct
+{
+    TaskHandle_t handle;
+    char name[configMAX_TASK_NAME_LEN];
+    configRUN_TIME_COUNTER_TYPE last;
+    uint64_t busy_us;
+    bool seen;                      //Still listed by the scheduler
+} task_slot_t;
+
+static const struct
+{
+    const char *name;
+    axp2101_rail_t rail;
+    uint32_t ua;
+} rail_loads[] = {
+    { "backlight", Axp2101RailBacklight, ENERGY_PROFILER_BACKLIGHT_UA },
+    { "touch", Axp2101RailTouch, ENERGY_PROFILER_TOUCH_UA },
+    { "radio", Axp2101RailRadio, ENERGY_PROFILER_RADIO_UA },
+    { "haptic", Axp2101RailHaptic, ENERGY_PROFILER_HAPTIC_UA }
+};
+
+static esp_timer_handle_t report_timer;
+static SemaphoreHandle_t mutex;
+static TaskStatus_t task_status[ENERGY_PROFILER_MAX_TASKS];
+static task_slot_t slots[ENERGY_PROFILER_MAX_TASKS];
+static size_t slot_count;
+static bool slots_full;
+static int64_t window_start_us;
+static bool window_charging;
+//The fuel gauge baseline outlives the window until it has moved enough to measure
+static int64_t gauge_start_us;
+static uint8_t gauge_start_percent;
+static uint64_t rail_start_us[sizeof(rail_loads) / sizeof(rail_loads[0])];
+static energy_report_t log_report;
+
+static task_slot_t *lookup_slot(TaskHandle_t handle, const char *name)
+{
+    size_t i;
+    for (i = 0; i < slot_count; ++i)
+    {
+        //A new task can reuse the TCB of a deleted one
+        if (slots[i].handle == handle && strcmp(slots[i].name, name) == 0) return &slots[i];
+    }
+    return NULL;
+}
+
+static task_slot_t *find_slot(TaskHandle_t handle, const char *name)
+{
+    task_slot_t *found = lookup_slot(handle, name);
+    if (found != NULL) return found;
+    if (slot_count == ENERGY_PROFILER_MAX_TASKS)
+    {
+        if (!slots_full) ESP_LOGW(TAG, "No slot for task %s", name);
+        slots_full = true;
+        return NULL;
+    }
+
+    task_slot_t *slot = &slots[slot_count++];
+    slot->handle = handle;
+    snprintf(slot->name, sizeof(slot->name), "%s", name);
+    slot->last = 0;     //Created after the window started, all of its run time belongs to it
+    slot->busy_us = 0;
+    slot->seen = true;
+    return slot;
+}
+
+//Drops the slots of deleted tasks, one with run time in the current window stays until that is reported
+static void prune_slots(void)
+{
+    size_t i, n = 0;
+    for (i = 0; i < slot_count; ++i)
+    {
+        if (slots[i].seen || slots[i].busy_us > 0) slots[n++] = slots[i];
+    }
+    if (n < slot_count) slots_full = false;
+    slot_count = n;
+}
+
+//One pass over the scheduler's run-time counters, idle tasks are the base load and not charged to anyone
+static void sample_tasks(bool count)
+{
+    UBaseType_t i, n;
+    n = uxTaskGetSystemState(task_status, ENERGY_PROFILER_MAX_TASKS, NULL);
+    if (n == 0)
+    {
+        ESP_LOGW(TAG, "More than %d tasks", ENERGY_PROFILER_MAX_TASKS);
+        return;
+    }
+
+    //Deleted tasks give their slots back before new ones ask for one
+    for (i = 0; i < slot_count; ++i)
+    {
+        slots[i].seen = false;
+    }
+    for (i = 0; i < n; ++i)
+    {
+        task_slot_t *slot = lookup_slot(task_status[i].xHandle, task_status[i].pcTaskName);
+        if (slot != NULL) slot->seen = true;
+    }
+    prune_slots();
+
+    for (i = 0; i < n; ++i)
+    {
+        TaskHandle_t handle = task_status[i].xHandle;
+        if (handle == xTaskGetIdleTaskHandleForCore(0) || handle == xTaskGetIdleTaskHandleForCore(1)) continue;
+
+        task_slot_t *slot = find_slot(handle, task_status[i].pcTaskName);
+        if (slot == NULL) continue;
+        if (count) slot->busy_us += task_status[i].ulRunTimeCounter - slot->last;
+        slot->last = task_status[i].ulRunTimeCounter;
+    }
+    if (axp2101_is_vbus_present()) window_charging = true;
+}
+
+static void start_window(bool restart_gauge)
+{
+    size_t i;
+    for (i = 0; i < slot_count; ++i)
+    {
+        slots[i].busy_us = 0;
+    }
+    sample_tasks(false);
+    for (i = 0; i < sizeof(rail_loads) / sizeof(rail_loads[0]); ++i)
+    {
+        rail_start_us[i] = axp2101_rail_get_on_time_us(rail_loads[i].rail);
+    }
+    window_start_us = esp_timer_get_time();
+    window_charging = axp2101_is_vbus_present();
+    if (restart_gauge)
+    {
+        gauge_start_us = window_start_us;
+        gauge_start_percent = axp2101_get_battery_percentage();
+    }
+}
+
+static void add_entry(energy_report_t *report, const char *name, uint64_t active_us, uint32_t ua, uint64_t window_us)
+{
+    energy_entry_t *entry = &report->entries[report->count++];
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    entry->ua = (uint32_t)(active_us * ua / window_us);
+    report->model_ua += entry->ua;
+}
+
+static void build_report(energy_report_t *report)
+{
+    size_t i;
+    sample_tasks(true);
+    uint64_t window_us = esp_timer_get_time() - window_start_us;
+    if (window_us == 0) window_us = 1;
+
+    memset(report, 0, sizeof(*report));
+    report->window_s = (uint32_t)(window_us / 1000000);
+    report->charging = window_charging;
+    for (i = 0; i < slot_count; ++i)
+    {
+        if (slots[i].busy_us > 0) add_entry(report, slots[i].name, slots[i].busy_us, ENERGY_PROFILER_CPU_CORE_UA, window_us);
+    }
+    add_entry(report, "base", window_us, ENERGY_PROFILER_BASE_UA, window_us);
+    for (i = 0; i < sizeof(rail_loads) / sizeof(rail_loads[0]); ++i)
+    {
+        uint64_t on_us = axp2101_rail_get_on_time_us(rail_loads[i].rail) - rail_start_us[i];
+        add_entry(report, rail_loads[i].name, on_us, rail_loads[i].ua, window_us);
+    }
+
+    //Percent of capacity to uAh, spread over the window
+    uint8_t percent = axp2101_get_battery_percentage();
+    if (report->charging || percent > gauge_start_percent || gauge_start_percent - percent < ENERGY_PROFILER_MIN_DROP_PERCENT) return;
+    uint64_t drained_uah = (uint64_t)(gauge_start_percent - percent) * ENERGY_PROFILER_BATTERY_MAH * 10;
+    report->measured_ua = (uint32_t)(drained_uah * 3600 * 1000000 / (uint64_t)(esp_timer_get_time() - gauge_start_us));
+    if (report->model_ua == 0) return;
+    for (i = 0; i < report->count; ++i)
+    {
+        report->entries[i].ua = (uint32_t)((uint64_t)report->entries[i].ua * report->measured_ua / report->model_ua);
+    }
+}
+
+//Runs in the esp_timer task
+static void report_timer_cb(void *arg)
+{
+    energy_profiler_log_report();
+}
+
+esp_err_t energy_profiler_init(void)
+{
+    const esp_timer_create_args_t timer_args = {
+        .callback = report_timer_cb,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "energy_profiler",
+        .skip_unhandled_events = true
+    };
+    mutex = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(mutex != NULL, ESP_ERR_NO_MEM, TAG, "mutex");
+    start_window(true);
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &report_timer), TAG, "timer");
+    return esp_timer_start_periodic(report_timer, (uint64_t)ENERGY_PROFILER_PERIOD_MS * 1000);
+}
+
+void energy_profiler_reset(void)
+{
+    if (mutex == NULL) return;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    start_window(true);
+    xSemaphoreGive(mutex);
+}
+
+void energy_profiler_get_report(energy_report_t *report)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    build_report(report);
+    xSemaphoreGive(mutex);
+}
+
+//Averages over the window, so uA read as uAh per hour. Each logged report closes its window
+void energy_profiler_log_report(void)
+{
+    size_t i;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    build_report(&log_report);
+    if (log_report.charging)
+    {
+        ESP_LOGI(TAG, "%" PRIu32 " s window, charging, model only", log_report.window_s);
+    }
+    else if (log_report.measured_ua == 0)
+    {
+        ESP_LOGI(TAG, "%" PRIu32 " s window, fuel gauge has not moved enough, model %" PRIu32 " uA", log_report.window_s,
+            log_report.model_ua);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "%" PRIu32 " s window, measured %" PRIu32 " uA, model %" PRIu32 " uA", log_report.window_s,
+            log_report.measured_ua, log_report.model_ua);
+    }
+    for (i = 0; i < log_report.count; ++i)
+    {
+        if (log_report.entries[i].ua == 0) continue;
+        ESP_LOGI(TAG, "  %-16s %3" PRIu32 ".%03" PRIu32 " mAh/h", log_report.entries[i].name,
+            log_report.entries[i].ua / 1000, log_report.entries[i].ua % 1000);
+    }
+    //A window without a measurement leaves the gauge baseline running, 1% steps need more than one period
+    start_window(log_report.charging || log_report.measured_ua > 0);
+    xSemaphoreGive(mutex);
+}
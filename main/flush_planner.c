@@ -0,0 +1,185 @@
+#include "flush_planner.h"
+#include "t_watch_s3.h"
+
+static flush_window_t windows[FLUSH_PLANNER_MAX_WINDOWS];
+static uint8_t window_cnt;
+static uint32_t unplanned_bytes;
+static uint32_t planned_bytes;
+
+//Cheapest way to send an area out of the framebuffer: one full-width band or one window per row span
+static uint32_t window_cost(const lv_area_t *area, bool *band)
+{
+    uint32_t height = lv_area_get_height(area);
+    uint32_t width = lv_area_get_width(area);
+    uint32_t band_bytes = FLUSH_PLANNER_WINDOW_OVERHEAD_BYTES + height * BOARD_TFT_WIDTH * sizeof(uint16_t);
+    uint32_t span_bytes = height * (FLUSH_PLANNER_WINDOW_OVERHEAD_BYTES + width * sizeof(uint16_t));
+
+    bool use_band = (width == BOARD_TFT_WIDTH || band_bytes <= span_bytes);
+    if (band != NULL) *band = use_band;
+    return use_band ? band_bytes : span_bytes;
+}
+
+static void set_window(flush_window_t *window, const lv_area_t *area)
+{
+    lv_area_copy(&window->area, area);
+    window_cost(area, &window->band);
+    window->transfers = window->band ? 1 : lv_area_get_height(area);
+}
+
+static uint32_t window_bytes(const flush_window_t *window)
+{
+    uint32_t height = lv_area_get_height(&window->area);
+    if (window->band) return FLUSH_PLANNER_WINDOW_OVERHEAD_BYTES + height * BOARD_TFT_WIDTH * sizeof(uint16_t);
+    return height * (FLUSH_PLANNER_WINDOW_OVERHEAD_BYTES + lv_area_get_width(&window->area) * sizeof(uint16_t));
+}
+
+static void remove_window(uint8_t index)
+{
+    window_cnt--;
+    for (; index < window_cnt; ++index)
+    {
+        windows[index] = windows[index + 1];
+    }
+}
+
+//Merge the pair of windows that saves the most bytes when sent as their bounding box, until none does
+static bool merge_best_pair(void)
+{
+    uint32_t best_saving = 0;
+    uint8_t best_i = 0;
+    uint8_t best_j = 0;
+    lv_area_t best_area;
+    lv_area_t joined;
+    uint8_t i, j;
+
+    for (i = 0; i < window_cnt; ++i)
+    {
+        for (j = i + 1; j < window_cnt; ++j)
+        {
+            lv_area_join(&joined, &windows[i].area, &windows[j].area);
+            uint32_t separate = window_cost(&windows[i].area, NULL) + window_cost(&windows[j].area, NULL);
+            uint32_t merged = window_cost(&joined, NULL);
+            if (merged <= separate && separate - merged >= best_saving)
+            {
+                best_saving = separate - merged;
+                best_i = i;
+                best_j = j;
+                lv_area_copy(&best_area, &joined);
+            }
+        }
+    }
+
+    if (best_i == best_j) return false;
+
+    set_window(&windows[best_i], &best_area);
+    remove_window(best_j);
+    return true;
+}
+
+//Drop rows of a window that an overlapping window already sends, or the whole window if it is covered
+static void trim_overlaps(void)
+{
+    uint8_t i = 0;
+    uint8_t j;
+
+    while (i < window_cnt)
+    {
+        bool removed = false;
+        for (j = 0; j < window_cnt && !removed; ++j)
+        {
+            if (i == j) continue;
+
+            lv_area_t *a = &windows[i].area;
+            const lv_area_t *b = &windows[j].area;
+            int32_t ax1 = windows[i].band ? 0 : a->x1;
+            int32_t ax2 = windows[i].band ? BOARD_TFT_WIDTH - 1 : a->x2;
+            int32_t bx1 = windows[j].band ? 0 : b->x1;
+            int32_t bx2 = windows[j].band ? BOARD_TFT_WIDTH - 1 : b->x2;
+            if (ax1 < bx1 || ax2 > bx2) continue;
+
+            lv_area_t trimmed;
+            lv_area_copy(&trimmed, a);
+            if (b->y1 <= trimmed.y1 && b->y2 >= trimmed.y1) trimmed.y1 = b->y2 + 1;
+            if (b->y1 <= trimmed.y2 && b->y2 >= trimmed.y2) trimmed.y2 = b->y1 - 1;
+
+            if (trimmed.y1 > trimmed.y2)
+            {
+                remove_window(i);
+                removed = true;
+            }
+            else if (trimmed.y1 != a->y1 || trimmed.y2 != a->y2)
+            {
+                //Keep the send mode, other windows may already rely on this one covering their columns
+                lv_area_copy(a, &trimmed);
+                if (!windows[i].band) windows[i].transfers = lv_area_get_height(a);
+            }
+        }
+        if (!removed) i++;
+    }
+}
+
+//Top to bottom order follows the panel scan and keeps tearing to a single line
+static void sort_windows(void)
+{
+    uint8_t i, j;
+    for (i = 1; i < window_cnt; ++i)
+    {
+        flush_window_t window = windows[i];
+        for (j = i; j > 0 && (windows[j - 1].area.y1 > window.area.y1 ||
+            (windows[j - 1].area.y1 == window.area.y1 && windows[j - 1].area.x1 > window.area.x1)); --j)
+        {
+            windows[j] = windows[j - 1];
+        }
+        windows[j] = window;
+    }
+}
+
+void flush_planner_reset(void)
+{
+    window_cnt = 0;
+}
+
+void flush_planner_add(const lv_area_t *area)
+{
+    unplanned_bytes += window_cost(area, NULL);
+
+    if (window_cnt == FLUSH_PLANNER_MAX_WINDOWS)
+    {
+        //Out of slots, fold into the last window rather than dropping the area
+        lv_area_t joined;
+        lv_area_join(&joined, &windows[window_cnt - 1].area, area);
+        set_window(&windows[window_cnt - 1], &joined);
+        return;
+    }
+    set_window(&windows[window_cnt++], area);
+}
+
+uint8_t flush_planner_plan(const flush_window_t **planned)
+{
+    uint8_t i;
+
+    while (merge_best_pair());
+    trim_overlaps();
+    sort_windows();
+
+    for (i = 0; i < window_cnt; ++i)
+    {
+        planned_bytes += window_bytes(&windows[i]);
+    }
+    *planned = windows;
+    return window_cnt;
+}
+
+uint32_t flush_planner_get_unplanned_bytes(void)
+{
+    uint32_t bytes = unplanned_bytes;
+    unplanned_bytes = 0;
+    return bytes;
+}
+
+uint32_t flush_planner_get_planned_bytes(void)
+{
+    uint32_t bytes = planned_bytes;
+    planned_bytes = 0;
+    return bytes;
+}
\ No newline at end of file
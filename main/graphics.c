@@ -1,30 +1,87 @@
 #include "graphics.h"
+#include "display_flush.h"
+#include "lvgl_notify.h"
+#include "flush_planner.h"
+#include "lv_draw_sw_pie.h"
 #include "t_watch_s3.h"
 #include "axp2101.h"
+#include "st7789.h"
+#include "i2c_controller.h"
 #include "ft5436.h"
+#include "touch_gesture.h"
+#include "touch_power.h"
+#include "touch_filter.h"
+#include "power_telemetry.h"
+#include "power_profile.h"
+#include "energy_profiler.h"
+#include "haptics.h"
 #include "lvgl.h"
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "driver/gpio.h"
-#include "esp_lcd_panel_ops.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_pm.h"
+#include <stdio.h>
+#include <stdlib.h>
 
-#define HARDWARE_MIRROR_CORRECTION (80)
 #define LVGL_COORD_CORRECTION (10)
 #define LVGL_TASK_STACK_SIZE (6 * 1024)
 #define LVGL_TASK_PRIORITY (2)
 #define LVGL_TIMEOUT_MS (10000)
-#define LVGL_UI_SLOWTICK_MS (1000)
+#define LVGL_TOUCH_IDLE_MS (3000)
+#define LVGL_TOUCH_POLL_MS (100)
+#define LVGL_WAKE_BUDGET_MS (60) //Wake interrupt to backlight on with the first frame on the panel
+#define LVGL_WAKE_FLUSH_TIMEOUT_MS (100)
+#define GRAPHICS_STATS_ENABLE (0)
+#define GRAPHICS_STATS_PERIOD_MS (10000)
+#define GRAPHICS_TOUCH_HW_GESTURES (0)
+#define GRAPHICS_TOUCH_FILTER (0) //Smooth and extrapolate drag positions before LVGL sees them
 
 static const char *TAG = "graphics";
 static DMA_ATTR uint16_t buf1[GRAPHICS_BUFFER_SIZE];
+#if !GRAPHICS_DIRECT_MODE
 static DMA_ATTR uint16_t buf2[GRAPHICS_BUFFER_SIZE];
+#endif
 static lv_display_t *lv_disp;
 static lv_indev_t *lv_touch_indev;
 static lv_obj_t *pwr_lbl;
-static esp_timer_handle_t lvgl_tick_timer;
 static TaskHandle_t lvgl_task_handle;
+static esp_lcd_panel_handle_t panel;
+static volatile int64_t wake_irq_time_us;
+static int64_t screen_off_time_us;
+static uint32_t wake_latency_last_us;
+static uint32_t wake_latency_max_us;
+static uint32_t wake_count;
+static volatile int64_t touch_irq_time_us;
+static bool touch_active;
+//The latest report, left by the touch bus worker for the next indev read
+static portMUX_TYPE touch_lock = portMUX_INITIALIZER_UNLOCKED;
+static ft5436_touch_data_t touch_latest;
+static int64_t touch_latest_us;
+static bool touch_sample_ready;
+static uint32_t touch_reads_queued;
+//Backlight pin and wake latency are set by the system bus worker once the rail has ramped
+static portMUX_TYPE backlight_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t wake_start_us;
+static bool backlight_wanted;
+static uint32_t pmu_events;
+#if GRAPHICS_STATS_ENABLE
+static uint32_t touch_reads_active;
+static uint32_t touch_reads_idle;
+static uint64_t touch_latency_sum_us;
+static uint32_t touch_latency_max_us;
+static uint32_t touch_latency_count;
+#endif
+#if GRAPHICS_STATS_ENABLE
+static int64_t render_start_us;
+static uint32_t render_idle_start_us[portNUM_PROCESSORS];
+static uint64_t render_wall_us;
+static uint64_t render_busy_us[portNUM_PROCESSORS];
+static uint32_t render_count;
+#endif
 
 static lv_color_t red_color = 
 {
@@ -48,98 +105,388 @@ static lv_color_t blue_color =
 };
 
 static lv_obj_t *debug_labels[4];
-static char report_buffer[512];
 
-static void print_stats()
+//Runs in the touch bus worker. Every report feeds the gesture ring from here, LVGL only sees the latest one
+static void touch_data_cb(bool ok, const ft5436_touch_data_t *touch, void *user_data)
 {
-    for(;;)
+    if (ok)
     {
-        vTaskGetRunTimeStats(report_buffer);
-        ESP_LOGI(TAG, "%s", report_buffer);
-        vTaskDelay(pdMS_TO_TICKS(2000));
+        int64_t now_us = esp_timer_get_time();
+        touch_sample_t sample = {
+            .time_us = now_us,
+            .x = touch->points[0].x,
+            .y = touch->points[0].y,
+            .pressed = touch->count > 0,
+            .gesture_id = touch->gesture_id
+        };
+        touch_ring_push(&sample);
+
+        portENTER_CRITICAL(&touch_lock);
+        touch_latest = *touch;
+        touch_latest_us = now_us;
+        portEXIT_CRITICAL(&touch_lock);
+        __atomic_store_n(&touch_sample_ready, true, __ATOMIC_RELEASE);
+#if GRAPHICS_STATS_ENABLE
+        if (touch_active) touch_reads_active++;
+        else touch_reads_idle++;
+#endif
     }
+    __atomic_fetch_sub(&touch_reads_queued, 1, __ATOMIC_RELEASE);
+    lvgl_notify(LVGL_NOTIFY_TOUCH);
 }
 
+//The controller runs in trigger mode and pulses INT once per report, each pulse queues one read to the touch bus worker.
+//INT is level triggered once it is a light sleep wake-up source, so it stays masked until the read is done
 static IRAM_ATTR void touch_isr(void *arg)
 {
     gpio_intr_disable(BOARD_TOUCH_INT);
-    BaseType_t xYieldRequired;
-    xYieldRequired = xTaskResumeFromISR(lvgl_task_handle);
+    touch_irq_time_us = esp_timer_get_time();
+    BaseType_t xYieldRequired = pdFALSE;
+    __atomic_fetch_add(&touch_reads_queued, 1, __ATOMIC_RELAXED);
+    if (ft5436_request_touch_data_from_isr(touch_data_cb, NULL, &xYieldRequired) != ESP_OK)
+    {
+        //Queue full, the LVGL task re-arms INT and the next report pulses again
+        __atomic_fetch_sub(&touch_reads_queued, 1, __ATOMIC_RELAXED);
+        lvgl_notify_from_isr(LVGL_NOTIFY_TOUCH, &xYieldRequired);
+    }
+    portYIELD_FROM_ISR(xYieldRequired);
+}
+
+//Called by LVGL whenever a timer is created or resumed, e.g. the refresh timer after an invalidation
+static void lvgl_timer_resume_cb(void *data)
+{
+    lvgl_notify(LVGL_NOTIFY_TIMER);
+}
+
+//RTC alarm or accelerometer line while the screen is off
+static void screen_wake_cb(int gpio_num)
+{
+    BaseType_t xYieldRequired = pdFALSE;
+    wake_irq_time_us = esp_timer_get_time();
+    lvgl_notify_from_isr(LVGL_NOTIFY_WAKE, &xYieldRequired);
     portYIELD_FROM_ISR(xYieldRequired);
 }
 
+static void update_power_label(void)
+{
+    lv_label_set_text_fmt(pwr_lbl, "%s%d%%", axp2101_is_vbus_present() ? LV_SYMBOL_CHARGE " " : "",
+        axp2101_get_battery_percentage());
+}
+
+//Runs in the I2C worker, the UI is only touched from the LVGL task
+static void pmu_event_cb(uint32_t events, void *user_data)
+{
+    uint32_t notify = LVGL_NOTIFY_PMU;
+    __atomic_fetch_or(&pmu_events, events, __ATOMIC_RELAXED);
+    if (events & AXP2101_IRQ_PKEY_SHORT) notify |= LVGL_NOTIFY_WAKE;
+    lvgl_notify(notify);
+}
+
+static void handle_pmu_events(void)
+{
+    uint32_t events = __atomic_exchange_n(&pmu_events, 0, __ATOMIC_RELAXED);
+    ESP_LOGI(TAG, "PMU events 0x%06lx", events);
+
+    //The telemetry rate follows the charge state
+    if (events & (AXP2101_IRQ_VBUS_INSERT | AXP2101_IRQ_VBUS_REMOVE))
+    {
+        power_telemetry_sample_now();
+        //A drain window starts when running from the battery again
+        energy_profiler_reset();
+    }
+    if (events & AXP2101_IRQ_VBUS_INSERT) haptics_play(HapticPatternCharge, HapticPriorityNotification);
+
+    lv_lock();
+    update_power_label();
+    if (events & AXP2101_IRQ_PKEY_SHORT) lv_display_trigger_activity(lv_disp);
+    lv_unlock();
+}
+
+//Blocks until the next LVGL timer is due or a notification arrives, returns the notification bits
+static uint32_t lvgl_wait(uint32_t timeout_ms)
+{
+    uint32_t notified;
+    bool woken;
+
+    //A missed lift-up report would leave the pointer pressed, so keep a slow read going while a finger is down
+    if (touch_active && timeout_ms > LVGL_TOUCH_POLL_MS)
+    {
+        timeout_ms = LVGL_TOUCH_POLL_MS;
+    }
+    woken = lvgl_notify_wait(timeout_ms, &notified);
+
+    //No I2C here, reads run in the touch bus worker and their sample is picked up on the notification that follows
+    if (!woken && touch_active && __atomic_load_n(&touch_reads_queued, __ATOMIC_ACQUIRE) == 0)
+    {
+        __atomic_fetch_add(&touch_reads_queued, 1, __ATOMIC_RELAXED);
+        if (ft5436_request_touch_data(touch_data_cb, NULL) != ESP_OK)
+        {
+            __atomic_fetch_sub(&touch_reads_queued, 1, __ATOMIC_RELAXED);
+        }
+    }
+    if (__atomic_exchange_n(&touch_sample_ready, false, __ATOMIC_ACQUIRE))
+    {
+        lv_lock();
+        lv_indev_read(lv_touch_indev);
+        lv_unlock();
+    }
+    //Re-armed on every return once no read is queued, not only after a read, so a pulse whose notification was taken
+    //with other bits or before a wake-up cannot leave the line masked for good
+    if (__atomic_load_n(&touch_reads_queued, __ATOMIC_ACQUIRE) == 0) gpio_intr_enable(BOARD_TOUCH_INT);
+    if (notified & LVGL_NOTIFY_PMU)
+    {
+        handle_pmu_events();
+    }
+    touch_gesture_process(esp_timer_get_time());
+    return notified;
+}
+
+//Runs in the system bus worker after the rail has ramped, unless the queue was full
+static void backlight_on_cb(esp_err_t err, void *user_data)
+{
+    ESP_ERROR_CHECK_WITHOUT_ABORT(err);
+    //A screen that went off again before the ramp ended stays dark
+    portENTER_CRITICAL(&backlight_lock);
+    if (backlight_wanted) gpio_set_level(BOARD_TFT_BL, 1);
+    portEXIT_CRITICAL(&backlight_lock);
+
+    wake_latency_last_us = (uint32_t)(esp_timer_get_time() - wake_start_us);
+    if (wake_latency_last_us > wake_latency_max_us) wake_latency_max_us = wake_latency_last_us;
+    wake_count++;
+    if (wake_latency_last_us > LVGL_WAKE_BUDGET_MS * 1000)
+    {
+        ESP_LOGW(TAG, "Wake to first frame %lu us, budget %d ms", wake_latency_last_us, LVGL_WAKE_BUDGET_MS);
+    }
+    else
+    {
+        ESP_LOGD(TAG, "Wake to first frame %lu us", wake_latency_last_us);
+    }
+}
+
+static void screen_off(void)
+{
+    portENTER_CRITICAL(&backlight_lock);
+    backlight_wanted = false;
+    gpio_set_level(BOARD_TFT_BL, 0);
+    portEXIT_CRITICAL(&backlight_lock);
+    //Queued behind a pending acquire, so the rail count stays balanced
+    if (axp2101_rail_release_async(Axp2101RailBacklight) != ESP_OK)
+    {
+        ESP_ERROR_CHECK_WITHOUT_ABORT(axp2101_rail_release(Axp2101RailBacklight));
+    }
+    st7789_set_sleep(panel, true);
+    touch_power_set_display_on(false);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(power_profile_set_screen_wake(true));
+
+    //Battery and charger events update the label while dark, only wake sources turn the screen on
+    screen_off_time_us = esp_timer_get_time();
+    while ((lvgl_wait(portMAX_DELAY) & (LVGL_NOTIFY_TOUCH | LVGL_NOTIFY_WAKE)) == 0)
+    {
+    }
+}
+
+//Panel and first frame first, the touch controller takes longer to leave hibernate and is not needed to see the screen
+static void screen_on(void)
+{
+    //The touch ISR stamps its own time, the PMU power key is only seen once its status read completes
+    wake_start_us = esp_timer_get_time();
+    if (wake_irq_time_us > screen_off_time_us) wake_start_us = wake_irq_time_us;
+    else if (touch_irq_time_us > screen_off_time_us) wake_start_us = touch_irq_time_us;
+
+    ESP_ERROR_CHECK_WITHOUT_ABORT(power_profile_set_screen_wake(false));
+    st7789_set_sleep(panel, false);
+    lv_display_trigger_activity(lv_disp);
+    power_profile_acquire(PowerClientRender);
+    lv_lock();
+    lv_timer_handler();
+    lv_unlock();
+    power_profile_release(PowerClientRender);
+
+    display_flush_wait(LVGL_WAKE_FLUSH_TIMEOUT_MS);
+    //The rail ramp is waited out in the system bus worker, the UI keeps running meanwhile
+    backlight_wanted = true;
+    esp_err_t err = axp2101_rail_acquire_async(Axp2101RailBacklight, backlight_on_cb, NULL);
+    if (err != ESP_OK) backlight_on_cb(axp2101_rail_acquire(Axp2101RailBacklight, NULL), NULL);
+
+    touch_power_set_display_on(true);
+}
+
 static void lvgl_port_task(void *arg)
 {
-    uint16_t task_delay_ms = 0;
-    uint16_t inactive_time = 0;
-    uint16_t slow_tick_counter = 0;
+    uint32_t task_delay_ms = 0;
+    uint32_t inactive_time = 0;
     for(;;)
     {
-        //inactive_time = lv_display_get_inactive_time(lv_disp);
+        inactive_time = lv_display_get_inactive_time(lv_disp);
         if (inactive_time < LVGL_TIMEOUT_MS)
         {
+            touch_power_set_ui_idle(inactive_time >= LVGL_TOUCH_IDLE_MS);
+            power_profile_acquire(PowerClientRender);
+            lv_lock();
             task_delay_ms = lv_timer_handler();
-            vTaskDelay(pdMS_TO_TICKS(task_delay_ms));
-            slow_tick_counter += task_delay_ms;
-
-            if (slow_tick_counter >= LVGL_UI_SLOWTICK_MS)
-            {
-                slow_tick_counter = 0;
-                lv_label_set_text_fmt(pwr_lbl, "%d%%", axp2101_get_battery_percentage());
-            }
+            lv_unlock();
+            power_profile_release(PowerClientRender);
+            //Wake up in time for the screen-off check even when no timer is pending
+            lvgl_wait(LV_MIN(task_delay_ms, LVGL_TIMEOUT_MS - inactive_time));
         }
         else 
         {
-            ESP_ERROR_CHECK(esp_timer_stop(lvgl_tick_timer));
-            ESP_ERROR_CHECK(gpio_set_level(BOARD_TFT_BL, 0));
-            ESP_ERROR_CHECK(gpio_intr_enable(BOARD_TOUCH_INT));
-            vTaskSuspend(lvgl_task_handle);
-            lv_tick_inc(LV_DEF_REFR_PERIOD);
-            task_delay_ms = lv_timer_handler();
-            ESP_ERROR_CHECK(esp_timer_restart(lvgl_tick_timer, LV_DEF_REFR_PERIOD * 1000));
-            vTaskDelay(pdMS_TO_TICKS(task_delay_ms));
-            ESP_ERROR_CHECK(gpio_set_level(BOARD_TFT_BL, 1));
+            screen_off();
+            screen_on();
         }
     }
 }
 
-//check px_map for color order
-static void flush_cb(lv_display_t * disp, const lv_area_t * area, uint8_t * px_map)
+#if GRAPHICS_STATS_ENABLE
+//Busy time per core while a frame renders, derived from the idle task run time counters (us)
+static void render_event_cb(lv_event_t *e)
+{
+    uint8_t core;
+    if (lv_event_get_code(e) == LV_EVENT_RENDER_START)
+    {
+        render_start_us = esp_timer_get_time();
+        for (core = 0; core < portNUM_PROCESSORS; ++core)
+        {
+            render_idle_start_us[core] = (uint32_t)ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+        }
+        return;
+    }
+
+    uint64_t wall_us = esp_timer_get_time() - render_start_us;
+    render_wall_us += wall_us;
+    render_count++;
+    for (core = 0; core < portNUM_PROCESSORS; ++core)
+    {
+        //A frame is far shorter than a 32-bit wrap, so the difference is right whatever the counter width
+        uint32_t idle_us = (uint32_t)ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core)) - render_idle_start_us[core];
+        render_busy_us[core] += (wall_us > idle_us) ? wall_us - idle_us : 0;
+    }
+}
+
+static void stats_timer_cb(lv_timer_t *timer)
 {
-    esp_lcd_panel_handle_t panel_handle = lv_display_get_user_data(disp);
-    int offsetx1 = area->x1;
-    int offsetx2 = area->x2;
-    int offsety1 = area->y1 + HARDWARE_MIRROR_CORRECTION;
-    int offsety2 = area->y2 + HARDWARE_MIRROR_CORRECTION;
-    esp_lcd_panel_draw_bitmap(panel_handle, offsetx1, offsety1, offsetx2 + 1, offsety2 + 1, px_map);
-    lv_display_flush_ready(disp);
+    display_flush_stats_t flush;
+    display_flush_get_stats(&flush);
+    uint32_t strips = flush.strips;
+    uint32_t bytes = flush.bytes;
+#if GRAPHICS_DIRECT_MODE
+    uint32_t unplanned = flush_planner_get_unplanned_bytes();
+    ESP_LOGI(TAG, "flush (direct): %lu windows/s, %lu B/s, %lu B/s without planning",
+        strips * 1000 / GRAPHICS_STATS_PERIOD_MS,
+        bytes * 1000 / GRAPHICS_STATS_PERIOD_MS,
+        unplanned * 1000 / GRAPHICS_STATS_PERIOD_MS);
+#else
+    ESP_LOGI(TAG, "flush (partial): %lu areas/s, %lu B/s",
+        strips * 1000 / GRAPHICS_STATS_PERIOD_MS,
+        bytes * 1000 / GRAPHICS_STATS_PERIOD_MS);
+#endif
+
+    ESP_LOGI(TAG, "lvgl task: %lu wakeups/min", lvgl_notify_get_wakeups() * 60000 / GRAPHICS_STATS_PERIOD_MS);
+    power_profile_log_stats();
+    if (wake_count > 0)
+    {
+        ESP_LOGI(TAG, "wake: %lu wakes, last %lu us, max %lu us, budget %d ms",
+            wake_count, wake_latency_last_us, wake_latency_max_us, LVGL_WAKE_BUDGET_MS);
+    }
+    wake_count = 0;
+    wake_latency_max_us = 0;
+#ifdef CONFIG_PM_PROFILING
+    //Time spent per power mode, including light sleep
+    esp_pm_dump_locks(stdout);
+#endif
+
+    ESP_LOGI(TAG, "touch: %lu I2C reads/s active, %lu I2C reads/s idle",
+        touch_reads_active * 1000 / GRAPHICS_STATS_PERIOD_MS, touch_reads_idle * 1000 / GRAPHICS_STATS_PERIOD_MS);
+    if (touch_latency_count > 0)
+    {
+        ESP_LOGI(TAG, "touch: INT to pressed avg %llu us, max %lu us",
+            touch_latency_sum_us / touch_latency_count, touch_latency_max_us);
+    }
+    ESP_LOGI(TAG, "touch power: state %d, %lu transitions", touch_power_get_state(), touch_power_get_transitions());
+    i2c_log_stats();
+    power_sample_t power;
+    if (power_telemetry_get_latest(&power) == ESP_OK)
+    {
+        ESP_LOGI(TAG, "power: bat %u mV %u%%, vbus %u mV, sys %u mV, die %s%d.%d C", power.battery_mv,
+            power.battery_percentage, power.vbus_mv, power.system_mv, power.die_temp_dc < 0 ? "-" : "",
+            abs(power.die_temp_dc / 10), abs(power.die_temp_dc % 10));
+    }
+    touch_reads_active = 0;
+    touch_reads_idle = 0;
+    touch_latency_sum_us = 0;
+    touch_latency_max_us = 0;
+    touch_latency_count = 0;
+
+    if (render_count > 0)
+    {
+        ESP_LOGI(TAG, "render: %lu frames, avg %llu us, core0 busy %llu us, core1 busy %llu us",
+            render_count, render_wall_us / render_count,
+            render_busy_us[0] / render_count, render_busy_us[1] / render_count);
+    }
+    render_count = 0;
+    render_wall_us = 0;
+    render_busy_us[0] = 0;
+    render_busy_us[1] = 0;
 }
+#endif
 
-static void increase_lvgl_tick(void *arg)
+//LVGL reads time on demand, so no periodic wakeup is needed to keep its clock running
+static uint32_t lvgl_tick_get_cb(void)
 {
-    lv_tick_inc(LV_DEF_REFR_PERIOD);
+    return (uint32_t)(esp_timer_get_time() / 1000);
 }
 
+//The report was read by the touch bus worker, see touch_data_cb
 static void touch_cb(lv_indev_t * indev, lv_indev_data_t * data)
 {
-    ft5436_point_t point;
-    uint8_t touch_cnt;
-    ft5436_xy_touch(&point, &touch_cnt);
+    portENTER_CRITICAL(&touch_lock);
+    ft5436_touch_data_t touch = touch_latest;
+#if GRAPHICS_TOUCH_FILTER
+    int64_t time_us = touch_latest_us;
+#endif
+    portEXIT_CRITICAL(&touch_lock);
 
-    if (touch_cnt > 0) 
+    if (touch.count > 0) 
     {
+#if GRAPHICS_TOUCH_FILTER
+        touch_sample_t sample = {
+            .time_us = time_us,
+            .x = touch.points[0].x,
+            .y = touch.points[0].y,
+            .pressed = true,
+            .gesture_id = touch.gesture_id
+        };
+        ft5436_point_t point;
+        touch_filter_update(&sample, &point);
         data->point.x = point.x;
         data->point.y = point.y;
+#else
+        data->point.x = touch.points[0].x;
+        data->point.y = touch.points[0].y;
+#endif
         data->state = LV_INDEV_STATE_PRESSED;
+        touch_active = true;
     } 
     else 
     {
         data->state = LV_INDEV_STATE_RELEASED;
+        touch_active = false;
+#if GRAPHICS_TOUCH_FILTER
+        touch_filter_reset();
+#endif
     }
 }
 
 static void button_pressed_cb(lv_event_t *e)
 {
+#if GRAPHICS_STATS_ENABLE
+    //INT edge to LV_EVENT_PRESSED
+    uint32_t latency_us = esp_timer_get_time() - touch_irq_time_us;
+    touch_latency_sum_us += latency_us;
+    touch_latency_count++;
+    if (latency_us > touch_latency_max_us) touch_latency_max_us = latency_us;
+#endif
+
     lv_event_code_t code = lv_event_get_code(e);
     lv_obj_t *target = (lv_obj_t*)lv_event_get_target(e);
     lv_obj_set_style_bg_color(target, red_color, LV_PART_MAIN);
@@ -147,6 +494,18 @@ static void button_pressed_cb(lv_event_t *e)
     ESP_LOGI(TAG, "%d", code);
 }
 
+static void gesture_cb(const touch_gesture_t *gesture, void *user_data)
+{
+    //Higher report rate only while a finger is dragging
+    if (gesture->type == DragStart) touch_power_set_dragging(true);
+    else if (gesture->type == DragEnd) touch_power_set_dragging(false);
+    else if (gesture->type == LongPress) haptics_play(HapticPatternClick, HapticPriorityUi);
+
+    //samples is the number of touch reads (interrupts) from press to recognition, for comparing hw and sw gestures
+    ESP_LOGD(TAG, "gesture %d at %d,%d dir %d v %ld,%ld after %u reads (%u B)", gesture->type, gesture->point.x, gesture->point.y,
+        gesture->direction, gesture->vx, gesture->vy, gesture->samples, gesture->samples * FT6X36_TOUCH_DATA_SIZE);
+}
+
 static void button_released_cb(lv_event_t *e)
 {
     lv_event_code_t code = lv_event_get_code(e);
@@ -158,24 +517,47 @@ static void button_released_cb(lv_event_t *e)
 
 void graphics_init(peripheral_handles_t *peripherals)
 {
+#if CONFIG_WATCH_PIE_SELFTEST
+    //A kernel that disagrees with LVGL's C path would corrupt every frame, so it is checked before the first one
+    if (!lv_draw_sw_pie_selftest()) ESP_LOGE(TAG, "PIE draw kernel selftest failed");
+#endif
+
     //Init LVGL
     lv_init();
+    lv_tick_set_cb(lvgl_tick_get_cb);
     lv_disp = lv_display_create(BOARD_TFT_WIDTH, BOARD_TFT_HEIGHT);
-    lv_display_set_buffers(lv_disp, buf1, buf2, GRAPHICS_BUFFER_SIZE * 2, LV_DISPLAY_RENDER_MODE_PARTIAL);
-    lv_display_set_flush_cb(lv_disp, flush_cb);
-    lv_display_set_user_data(lv_disp, peripherals->st7789_handle);
+#if GRAPHICS_DIRECT_MODE
+    lv_display_set_buffers(lv_disp, buf1, NULL, sizeof(buf1), LV_DISPLAY_RENDER_MODE_DIRECT);
+    ESP_LOGI(TAG, "Direct mode: framebuffer %u B, free DMA %u B, free internal %u B",
+        sizeof(buf1), heap_caps_get_free_size(MALLOC_CAP_DMA), heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+#else
+    lv_display_set_buffers(lv_disp, buf1, buf2, sizeof(buf1), LV_DISPLAY_RENDER_MODE_PARTIAL);
+    ESP_LOGI(TAG, "Partial mode: draw buffers 2 x %u B, free DMA %u B, free internal %u B",
+        sizeof(buf1), heap_caps_get_free_size(MALLOC_CAP_DMA), heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+#endif
+    ESP_ERROR_CHECK(display_flush_init(lv_disp, peripherals->st7789_handle, peripherals->st7789_io_handle,
+        GRAPHICS_DIRECT_MODE));
+    panel = peripherals->st7789_handle;
 
     lv_touch_indev = lv_indev_create();
     lv_indev_set_type(lv_touch_indev, LV_INDEV_TYPE_POINTER);
     lv_indev_set_display(lv_touch_indev, lv_disp);
     lv_indev_set_read_cb(lv_touch_indev, touch_cb);
+    lv_indev_set_mode(lv_touch_indev, LV_INDEV_MODE_EVENT);
+
+    touch_gesture_config_t gesture_config = TOUCH_GESTURE_DEFAULT_CONFIG();
+#if GRAPHICS_TOUCH_HW_GESTURES
+    const ft5436_gesture_config_t hw_gesture_config = FT5436_GESTURE_DEFAULT_CONFIG();
+    ESP_ERROR_CHECK(ft5436_configure_gestures(&hw_gesture_config));
+    gesture_config.hw_gestures = true;
+#endif
+    touch_gesture_init(&gesture_config, gesture_cb, NULL);
+    ESP_ERROR_CHECK(touch_power_init());
+#if GRAPHICS_TOUCH_FILTER
+    const touch_filter_config_t filter_config = TOUCH_FILTER_DEFAULT_CONFIG();
+    touch_filter_init(&filter_config, BOARD_TFT_WIDTH, BOARD_TFT_HEIGHT);
+#endif
 
-    esp_timer_create_args_t lvgl_tick_timer_args = {
-        .callback = increase_lvgl_tick,
-        .name = "lvgl_tick"
-    };
-    ESP_ERROR_CHECK(esp_timer_create(&lvgl_tick_timer_args, &lvgl_tick_timer));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(lvgl_tick_timer, LV_DEF_REFR_PERIOD * 1000));
     
     //Create UI
     lv_obj_t *scr = lv_display_get_screen_active(lv_disp);
@@ -214,13 +596,25 @@ void graphics_init(peripheral_handles_t *peripherals)
         lv_obj_set_style_text_color(label, lv_color_black(), LV_PART_MAIN);
     }
 
+#if GRAPHICS_STATS_ENABLE
+    lv_display_add_event_cb(lv_disp, render_event_cb, LV_EVENT_RENDER_START, NULL);
+    lv_display_add_event_cb(lv_disp, render_event_cb, LV_EVENT_RENDER_READY, NULL);
+    lv_timer_create(stats_timer_cb, GRAPHICS_STATS_PERIOD_MS, NULL);
+#endif
+
+    //The label changes on PMU interrupts (charge level, VBUS, charger), there is no polling
+    update_power_label();
+
     //Start LVGL loop
+    lv_timer_handler_set_resume_cb(lvgl_timer_resume_cb, NULL);
     ft5436_register_isr_handler(touch_isr);
-    ESP_ERROR_CHECK(gpio_intr_disable(BOARD_TOUCH_INT));
+    power_profile_set_wake_cb(screen_wake_cb);
 
     xTaskCreatePinnedToCore(lvgl_port_task, "lvgl", LVGL_TASK_STACK_SIZE, NULL, LVGL_TASK_PRIORITY, &lvgl_task_handle, 1);
+    lvgl_notify_init(lvgl_task_handle);
+    //PMU events notify the LVGL task, so they are enabled once it exists
+    ESP_ERROR_CHECK(axp2101_irq_init(pmu_event_cb, NULL));
     
+    ESP_ERROR_CHECK(axp2101_rail_acquire(Axp2101RailBacklight, NULL));
     ESP_ERROR_CHECK(gpio_set_level(BOARD_TFT_BL, 1));
-
-    //xTaskCreatePinnedToCore(print_stats, "print_stats", LVGL_TASK_STACK_SIZE, NULL, LVGL_TASK_PRIORITY, NULL, 0);
 }
\ No newline at end of file
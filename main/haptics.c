@@ -0,0 +1,204 @@
+#include "haptics.h"
+#include "drv2605.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include <stdbool.h>
+#include <inttypes.h>
+
+static const char *TAG = "haptics";
+
+typedef struct
+{
+    const char *name;
+    uint8_t sequence[DRV2605_WAVESEQ_COUNT];
+} haptic_pattern_info_t;
+
+typedef struct
+{
+    uint8_t pattern;
+    uint8_t priority;
+} haptic_request_t;
+
+//Effect numbers from ROM library A
+static const haptic_pattern_info_t patterns[HapticPatternCount] = {
+    [HapticPatternClick] = { "click", { 1 } },                                          //Strong Click 100%
+    [HapticPatternDoubleClick] = { "double click", { 10 } },                            //Double Click 100%
+    [HapticPatternNotify] = { "notify", { 24, DRV2605_WAIT_MS(100), 24 } },             //Sharp Tick 1 100%
+    [HapticPatternCharge] = { "charge", { 52 } },                                       //Pulsing Strong 1 100%
+    [HapticPatternAlarm] = { "alarm", { 47, DRV2605_WAIT_MS(150), 47, DRV2605_WAIT_MS(150),
+        47, DRV2605_WAIT_MS(150), 14, DRV2605_WAIT_MS(500) } }                          //Buzz 1, Strong Buzz 100%
+};
+
+static QueueHandle_t request_queue;
+static haptic_request_t pending[HAPTICS_PENDING_MAX];   //Highest priority first, in arrival order within one
+static uint8_t pending_count;
+static uint32_t dropped;
+
+static bool playing;
+static haptic_request_t current;
+static int64_t deadline_us;
+static int64_t idle_since_us;
+static bool powered;
+
+static void pending_insert(haptic_request_t request)
+{
+    uint8_t i, pos = pending_count;
+
+    if (pending_count == HAPTICS_PENDING_MAX)
+    {
+        if (pending[HAPTICS_PENDING_MAX - 1].priority >= request.priority)
+        {
+            dropped++;
+            return;
+        }
+        pending_count--;
+        pos = pending_count;
+        dropped++;
+    }
+    while (pos > 0 && pending[pos - 1].priority < request.priority)
+    {
+        pos--;
+    }
+    for (i = pending_count; i > pos; --i)
+    {
+        pending[i] = pending[i - 1];
+    }
+    pending[pos] = request;
+    pending_count++;
+}
+
+static haptic_request_t pending_pop(void)
+{
+    uint8_t i;
+    haptic_request_t request = pending[0];
+    pending_count--;
+    for (i = 0; i < pending_count; ++i)
+    {
+        pending[i] = pending[i + 1];
+    }
+    return request;
+}
+
+//Pauses count exactly, effects as HAPTICS_EFFECT_MAX_MS since their length is not known here
+static uint32_t sequence_timeout_ms(const uint8_t sequence[DRV2605_WAVESEQ_COUNT])
+{
+    uint32_t ms = HAPTICS_TIMEOUT_SLACK_MS;
+    uint8_t i;
+    for (i = 0; i < DRV2605_WAVESEQ_COUNT && sequence[i] != DRV2605_WAVESEQ_END; ++i)
+    {
+        if (sequence[i] & DRV2605_WAVESEQ_WAIT) ms += (sequence[i] & 0x7FU) * 10;
+        else ms += HAPTICS_EFFECT_MAX_MS;
+    }
+    return ms;
+}
+
+static void finish(esp_err_t err)
+{
+    if (err != ESP_OK) ESP_LOGW(TAG, "%s: %s", patterns[current.pattern].name, esp_err_to_name(err));
+    playing = false;
+    idle_since_us = esp_timer_get_time();
+}
+
+static void start_next(void)
+{
+    current = pending_pop();
+    //The eight slots go out in one burst, GO after them
+    esp_err_t err = drv2605_load_sequence(patterns[current.pattern].sequence);
+    if (err == ESP_OK) err = drv2605_go();
+    powered = true;
+    if (err != ESP_OK)
+    {
+        finish(err);
+        return;
+    }
+    playing = true;
+    deadline_us = esp_timer_get_time() + (int64_t)sequence_timeout_ms(patterns[current.pattern].sequence) * 1000;
+    ESP_LOGD(TAG, "Playing %s", patterns[current.pattern].name);
+}
+
+static void poll_playing(void)
+{
+    bool busy = false;
+    esp_err_t err = drv2605_is_playing(&busy);
+
+    if (err != ESP_OK)
+    {
+        finish(err);
+    }
+    else if (!busy)
+    {
+        finish(ESP_OK);
+    }
+    else if (esp_timer_get_time() > deadline_us)
+    {
+        finish(drv2605_stop());
+        ESP_LOGW(TAG, "%s did not finish", patterns[current.pattern].name);
+    }
+}
+
+static TickType_t wait_ticks(void)
+{
+    if (playing) return pdMS_TO_TICKS(HAPTICS_POLL_MS);
+    if (pending_count > 0) return 0;
+    if (powered) return pdMS_TO_TICKS(HAPTICS_POWER_DOWN_MS);
+    return portMAX_DELAY;
+}
+
+//Callers only push to the queue, every bus access including the GO polling happens here
+static void haptics_task(void *pv_parameters)
+{
+    haptic_request_t request;
+
+    for (;;)
+    {
+        if (xQueueReceive(request_queue, &request, wait_ticks()) == pdPASS)
+        {
+            do
+            {
+                pending_insert(request);
+            } while (xQueueReceive(request_queue, &request, 0) == pdPASS);
+        }
+
+        if (playing) poll_playing();
+        if (playing && pending_count > 0 && pending[0].priority > current.priority)
+        {
+            ESP_LOGD(TAG, "%s interrupted", patterns[current.pattern].name);
+            finish(drv2605_stop());
+        }
+        if (!playing && pending_count > 0)
+        {
+            start_next();
+        }
+        else if (!playing && powered && esp_timer_get_time() - idle_since_us >= HAPTICS_POWER_DOWN_MS * 1000)
+        {
+            ESP_ERROR_CHECK_WITHOUT_ABORT(drv2605_power_down());
+            powered = false;
+            if (dropped > 0) ESP_LOGW(TAG, "%" PRIu32 " patterns dropped", dropped);
+            dropped = 0;
+        }
+    }
+}
+
+esp_err_t haptics_init(void)
+{
+    request_queue = xQueueCreate(HAPTICS_QUEUE_LEN, sizeof(haptic_request_t));
+    ESP_RETURN_ON_FALSE(request_queue != NULL, ESP_ERR_NO_MEM, TAG, "queue");
+    if (xTaskCreate(haptics_task, "haptics", HAPTICS_TASK_STACK_SIZE, NULL, HAPTICS_TASK_PRIORITY, NULL) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t haptics_play(haptic_pattern_t pattern, haptic_priority_t priority)
+{
+    haptic_request_t request = { .pattern = pattern, .priority = priority };
+
+    ESP_RETURN_ON_FALSE(pattern < HapticPatternCount, ESP_ERR_INVALID_ARG, TAG, "pattern %d", pattern);
+    if (request_queue == NULL) return ESP_ERR_INVALID_STATE;
+    return xQueueSend(request_queue, &request, 0) == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
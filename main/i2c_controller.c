@@ -2,12 +2,164 @@
 #include "axp2101.h"
 #include "ft5436.h"
 #include "drv2605.h"
+#include "power_profile.h"
 #include "t_watch_s3.h"
 #include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
 #include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <assert.h>
 #include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+typedef struct
+{
+    i2c_master_dev_handle_t dev_handle;
+    i2c_job_cb_t cb;
+    i2c_call_fn_t call;         //Set for a call job, which runs call(user_data) instead of a transaction
+    void *user_data;
+    uint8_t reg;
+    uint8_t len;
+    bool write;
+    uint8_t data[I2C_BURST_MAX];
+} i2c_job_t;
+
+typedef struct
+{
+    i2c_master_dev_handle_t dev_handle;
+    i2c_master_bus_handle_t bus_handle;
+    i2c_bus_t bus;
+    const char *name;
+    uint16_t timeout_ms;
+    i2c_device_stats_t stats;
+} i2c_device_entry_t;
 
 static const char *TAG = "i2c_controller";
+static QueueHandle_t job_queues[I2C_BUS_COUNT];
+static i2c_device_entry_t devices[3];
+static uint8_t device_count;
+
+static void register_device(const char *name, i2c_master_dev_handle_t dev_handle, i2c_master_bus_handle_t bus_handle,
+    i2c_bus_t bus, uint16_t timeout_ms)
+{
+    i2c_device_entry_t *entry = &devices[device_count++];
+    entry->dev_handle = dev_handle;
+    entry->bus_handle = bus_handle;
+    entry->bus = bus;
+    entry->name = name;
+    entry->timeout_ms = timeout_ms;
+}
+
+static i2c_device_entry_t *find_device(i2c_master_dev_handle_t dev_handle)
+{
+    uint8_t i;
+    for (i = 0; i < device_count; ++i)
+    {
+        if (devices[i].dev_handle == dev_handle) return &devices[i];
+    }
+    return NULL;
+}
+
+//Every transaction ends within (I2C_RETRY_MAX + 1) deadlines plus the backoff, a stuck slave costs a stall, not a hang
+static esp_err_t transfer(i2c_master_dev_handle_t dev_handle, const uint8_t *write_buf, size_t write_len,
+    uint8_t *read_buf, size_t read_len)
+{
+    i2c_device_entry_t *entry = find_device(dev_handle);
+    int timeout_ms = entry != NULL ? entry->timeout_ms : I2C_DEFAULT_TIMEOUT_MS;
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    uint32_t backoff_ms = I2C_RETRY_BACKOFF_MS;
+    esp_err_t err = ESP_FAIL;
+    uint8_t attempt;
+
+    power_profile_acquire(PowerClientI2C);
+    for (attempt = 0; ; ++attempt)
+    {
+        int64_t start_us = esp_timer_get_time();
+        //The attempts left share what remains of the deadline, so a stuck bus still leaves time to clear it and retry
+        int attempt_ms = (int)((deadline_us - start_us) / 1000 / (I2C_RETRY_MAX + 1 - attempt));
+        if (attempt_ms < 1) attempt_ms = 1;
+        if (read_len > 0)
+        {
+            err = i2c_master_transmit_receive(dev_handle, write_buf, write_len, read_buf, read_len, attempt_ms);
+        }
+        else
+        {
+            err = i2c_master_transmit(dev_handle, write_buf, write_len, attempt_ms);
+        }
+        if (entry == NULL) break;
+
+        uint32_t latency_us = (uint32_t)(esp_timer_get_time() - start_us);
+        entry->stats.latency_sum_us += latency_us;
+        if (latency_us > entry->stats.latency_max_us) entry->stats.latency_max_us = latency_us;
+        entry->stats.transactions++;
+        if (err == ESP_OK) break;
+
+        entry->stats.errors++;
+        if (err == ESP_ERR_TIMEOUT)
+        {
+            //A slave holding SDA low after a glitch only lets go after the clear-bus SCL pulses
+            entry->stats.recoveries++;
+            i2c_master_bus_reset(entry->bus_handle);
+        }
+        //No retry that could not start before the deadline
+        if (attempt == I2C_RETRY_MAX || esp_timer_get_time() + (int64_t)backoff_ms * 1000 >= deadline_us) break;
+
+        entry->stats.retries++;
+        vTaskDelay(pdMS_TO_TICKS(backoff_ms));
+        backoff_ms *= 2;
+    }
+    power_profile_release(PowerClientI2C);
+
+    if (entry != NULL && err != ESP_OK)
+    {
+        entry->stats.failures++;
+        ESP_LOGW(TAG, "%s: transaction failed after %d attempts: %s", entry->name, attempt + 1, esp_err_to_name(err));
+    }
+    return err;
+}
+
+//One worker per bus, so a slow device only delays jobs queued behind it on the same bus
+static void i2c_worker_task(void *arg)
+{
+    QueueHandle_t queue = (QueueHandle_t)arg;
+    i2c_job_t job;
+    esp_err_t err;
+
+    while (1)
+    {
+        xQueueReceive(queue, &job, portMAX_DELAY);
+        if (job.call != NULL)
+        {
+            job.call(job.user_data);
+            continue;
+        }
+        if (job.write)
+        {
+            err = i2c_write_registers(job.dev_handle, job.reg, job.data, job.len);
+        }
+        else
+        {
+            err = i2c_read_registers(job.dev_handle, job.reg, job.data, job.len);
+        }
+        if (job.cb != NULL)
+        {
+            job.cb(err, job.data, job.len, job.user_data);
+        }
+    }
+}
+
+static void start_worker(i2c_bus_t bus, const char *name)
+{
+    job_queues[bus] = xQueueCreate(I2C_JOB_QUEUE_LEN, sizeof(i2c_job_t));
+    assert(job_queues[bus] != NULL);
+    BaseType_t res = xTaskCreate(i2c_worker_task, name, I2C_WORKER_STACK_SIZE, job_queues[bus], I2C_WORKER_PRIORITY, NULL);
+    assert(res == pdPASS);
+}
 
 void i2c_controller_init(peripheral_handles_t *peripherals)
 {
@@ -39,27 +191,307 @@ void i2c_controller_init(peripheral_handles_t *peripherals)
     i2c_device_config_t ft5436_config = {
         .dev_addr_length = I2C_ADDR_BIT_7,
         .device_address = FT6X36_ADDR,
-        .scl_speed_hz = 100000U
+        .scl_speed_hz = I2C_FAST_MODE_HZ
     };
     ESP_ERROR_CHECK(i2c_master_bus_add_device(i2c_bus0, &ft5436_config, &(peripherals->ft5436_handle)));
 
     i2c_device_config_t axp2101_config = {
         .dev_addr_length = I2C_ADDR_BIT_7,
         .device_address = AXP2101_SLAVE_ADDRESS,
-        .scl_speed_hz = 100000U
+        .scl_speed_hz = I2C_FAST_MODE_HZ
     };
     ESP_ERROR_CHECK(i2c_master_bus_add_device(i2c_bus1, &axp2101_config, &(peripherals->axp2101_handle)));
 
     i2c_device_config_t drv2605_config = {
         .dev_addr_length = I2C_ADDR_BIT_7,
         .device_address = DRV2605_SLAVE_ADDRESS,
-        .scl_speed_hz = 100000U
+        .scl_speed_hz = I2C_FAST_MODE_HZ
     };
     ESP_ERROR_CHECK(i2c_master_bus_add_device(i2c_bus1, &drv2605_config, &(peripherals->drv2605_handle)));
 
+    register_device("ft5436", peripherals->ft5436_handle, i2c_bus0, I2C_BUS_TOUCH, 10);
+    register_device("axp2101", peripherals->axp2101_handle, i2c_bus1, I2C_BUS_SYSTEM, I2C_DEFAULT_TIMEOUT_MS);
+    register_device("drv2605", peripherals->drv2605_handle, i2c_bus1, I2C_BUS_SYSTEM, 10);
+    start_worker(I2C_BUS_TOUCH, "i2c_touch");
+    start_worker(I2C_BUS_SYSTEM, "i2c_system");
+
+    int64_t start_us = esp_timer_get_time();
     axp2101_init(peripherals->axp2101_handle);
+    int64_t axp2101_us = esp_timer_get_time();
+    ESP_ERROR_CHECK(axp2101_rail_acquire(Axp2101RailTouch, NULL));
     ft5436_init(peripherals->ft5436_handle, FT6X36_DEFAULT_THRESHOLD);
+    int64_t ft5436_us = esp_timer_get_time();
     drv2605_init(peripherals->drv2605_handle);
+    int64_t end_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "Device init: axp2101 %" PRId64 " us, ft5436 %" PRId64 " us, drv2605 %" PRId64 " us, total %" PRId64 " us",
+        axp2101_us - start_us, ft5436_us - axp2101_us, end_us - ft5436_us, end_us - start_us);
+}
+
+static esp_err_t submit(i2c_job_t *job)
+{
+    i2c_device_entry_t *entry = find_device(job->dev_handle);
+    if (entry == NULL) return ESP_ERR_NOT_FOUND;
+    return xQueueSend(job_queues[entry->bus], job, 0) == pdTRUE ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+void i2c_set_device_timeout(i2c_master_dev_handle_t dev_handle, uint16_t timeout_ms)
+{
+    i2c_device_entry_t *entry = find_device(dev_handle);
+    if (entry != NULL) entry->timeout_ms = timeout_ms;
+}
+
+esp_err_t i2c_get_device_stats(i2c_master_dev_handle_t dev_handle, i2c_device_stats_t *stats)
+{
+    i2c_device_entry_t *entry = find_device(dev_handle);
+    if (entry == NULL) return ESP_ERR_NOT_FOUND;
+    *stats = entry->stats;
+    return ESP_OK;
+}
+
+void i2c_log_stats(void)
+{
+    uint8_t i;
+    for (i = 0; i < device_count; ++i)
+    {
+        const i2c_device_stats_t *stats = &devices[i].stats;
+        ESP_LOGI(TAG, "%s: %" PRIu32 " transactions, avg %" PRIu64 " us, max %" PRIu32 " us, %" PRIu32 " errors, %" PRIu32 " retries, "
+            "%" PRIu32 " recoveries, %" PRIu32 " failures",
+            devices[i].name, stats->transactions,
+            stats->transactions > 0 ? stats->latency_sum_us / stats->transactions : 0,
+            stats->latency_max_us, stats->errors, stats->retries, stats->recoveries, stats->failures);
+    }
+}
+
+esp_err_t i2c_submit_call(i2c_bus_t bus, i2c_call_fn_t fn, void *arg)
+{
+    if (bus >= I2C_BUS_COUNT || fn == NULL) return ESP_ERR_INVALID_ARG;
+    if (job_queues[bus] == NULL) return ESP_ERR_INVALID_STATE;
+
+    i2c_job_t job = {
+        .call = fn,
+        .user_data = arg
+    };
+    return xQueueSend(job_queues[bus], &job, 0) == pdTRUE ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t i2c_submit_read(i2c_master_dev_handle_t dev_handle, uint8_t reg, size_t len, i2c_job_cb_t cb, void *user_data)
+{
+    if (len == 0 || len > I2C_BURST_MAX) return ESP_ERR_INVALID_SIZE;
+
+    i2c_job_t job = {
+        .dev_handle = dev_handle,
+        .cb = cb,
+        .user_data = user_data,
+        .reg = reg,
+        .len = len,
+        .write = false
+    };
+    return submit(&job);
+}
+
+//For device interrupt lines, the transaction then runs in the bus worker instead of a dedicated task
+esp_err_t i2c_submit_read_from_isr(i2c_master_dev_handle_t dev_handle, uint8_t reg, size_t len, i2c_job_cb_t cb, void *user_data,
+    BaseType_t *task_woken)
+{
+    i2c_device_entry_t *entry = find_device(dev_handle);
+    if (entry == NULL) return ESP_ERR_NOT_FOUND;
+    if (len == 0 || len > I2C_BURST_MAX) return ESP_ERR_INVALID_SIZE;
+
+    i2c_job_t job = {
+        .dev_handle = dev_handle,
+        .cb = cb,
+        .user_data = user_data,
+        .reg = reg,
+        .len = len,
+        .write = false
+    };
+    return xQueueSendFromISR(job_queues[entry->bus], &job, task_woken) == pdTRUE ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t i2c_submit_write(i2c_master_dev_handle_t dev_handle, uint8_t reg, const uint8_t *data, size_t len, i2c_job_cb_t cb, void *user_data)
+{
+    if (len == 0 || len > I2C_BURST_MAX) return ESP_ERR_INVALID_SIZE;
+
+    i2c_job_t job = {
+        .dev_handle = dev_handle,
+        .cb = cb,
+        .user_data = user_data,
+        .reg = reg,
+        .len = len,
+        .write = true
+    };
+    memcpy(job.data, data, len);
+    return submit(&job);
+}
+
+#if CONFIG_WATCH_VERIFY_INIT_TABLES
+static esp_err_t verify_init_table(i2c_master_dev_handle_t dev_handle, const i2c_reg_init_t *table, size_t count)
+{
+    size_t i;
+    uint8_t value;
+    for (i = 0; i < count; ++i)
+    {
+        if (table[i].verify_mask == 0) continue;
+        ESP_RETURN_ON_ERROR(i2c_read_register(dev_handle, table[i].reg, &value), TAG, "readback of 0x%02x", table[i].reg);
+        if ((value ^ table[i].value) & table[i].verify_mask)
+        {
+            ESP_LOGW(TAG, "Register 0x%02x reads 0x%02x, wrote 0x%02x", table[i].reg, value, table[i].value);
+        }
+    }
+    return ESP_OK;
+}
+#endif
+
+esp_err_t i2c_write_init_table(i2c_master_dev_handle_t dev_handle, const i2c_reg_init_t *table, size_t count)
+{
+    uint8_t burst[I2C_BURST_MAX];
+    size_t i = 0;
+    while (i < count)
+    {
+        size_t len = 0;
+        uint8_t first = table[i].reg;
+        while (i < count && len < I2C_BURST_MAX && table[i].reg == (uint8_t)(first + len))
+        {
+            burst[len++] = table[i++].value;
+        }
+        ESP_RETURN_ON_ERROR(i2c_write_registers(dev_handle, first, burst, len), TAG, "init write at 0x%02x", first);
+    }
+#if CONFIG_WATCH_VERIFY_INIT_TABLES
+    return verify_init_table(dev_handle, table, count);
+#else
+    return ESP_OK;
+#endif
+}
+
+static inline bool reg_bit(const uint32_t *map, uint8_t reg)
+{
+    return (map[reg >> 5] >> (reg & 31)) & 1U;
+}
+
+static inline void set_reg_bit(uint32_t *map, uint8_t reg)
+{
+    map[reg >> 5] |= 1U << (reg & 31);
+}
+
+static inline void clear_reg_bit(uint32_t *map, uint8_t reg)
+{
+    map[reg >> 5] &= ~(1U << (reg & 31));
+}
+
+void i2c_cache_init(i2c_reg_cache_t *cache, i2c_master_dev_handle_t dev_handle, const i2c_reg_range_t *volatile_ranges, size_t count)
+{
+    size_t i;
+    uint32_t reg;
+    memset(cache, 0, sizeof(*cache));
+    cache->dev_handle = dev_handle;
+    for (i = 0; i < count; ++i)
+    {
+        for (reg = volatile_ranges[i].first; reg <= volatile_ranges[i].last; ++reg)
+        {
+            set_reg_bit(cache->volatile_map, reg);
+        }
+    }
+}
+
+void i2c_cache_seed(i2c_reg_cache_t *cache, const i2c_reg_init_t *table, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; ++i)
+    {
+        if (reg_bit(cache->volatile_map, table[i].reg)) continue;
+        cache->values[table[i].reg] = table[i].value;
+        set_reg_bit(cache->valid, table[i].reg);
+        clear_reg_bit(cache->dirty, table[i].reg);
+    }
+}
+
+void i2c_cache_invalidate(i2c_reg_cache_t *cache)
+{
+    memset(cache->valid, 0, sizeof(cache->valid));
+    memset(cache->dirty, 0, sizeof(cache->dirty));
+}
+
+void i2c_cache_restore(i2c_reg_cache_t *cache)
+{
+    uint8_t i;
+    for (i = 0; i < I2C_CACHE_WORDS; ++i)
+    {
+        cache->dirty[i] = cache->valid[i] & ~cache->volatile_map[i];
+    }
+}
+
+esp_err_t i2c_cache_read(i2c_reg_cache_t *cache, uint8_t reg, uint8_t *value)
+{
+    if (reg_bit(cache->valid, reg))
+    {
+        *value = cache->values[reg];
+        return ESP_OK;
+    }
+    cache->bus_reads++;
+    ESP_RETURN_ON_ERROR(i2c_read_register(cache->dev_handle, reg, value), TAG, "cache fill of 0x%02x", reg);
+    if (!reg_bit(cache->volatile_map, reg))
+    {
+        cache->values[reg] = *value;
+        set_reg_bit(cache->valid, reg);
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_cache_write(i2c_reg_cache_t *cache, uint8_t reg, uint8_t value)
+{
+    if (reg_bit(cache->volatile_map, reg))
+    {
+        cache->bus_writes++;
+        return i2c_write_register(cache->dev_handle, reg, value);
+    }
+    if (reg_bit(cache->valid, reg) && cache->values[reg] == value) return ESP_OK;
+
+    cache->values[reg] = value;
+    set_reg_bit(cache->valid, reg);
+    set_reg_bit(cache->dirty, reg);
+    return ESP_OK;
+}
+
+esp_err_t i2c_cache_update_bits(i2c_reg_cache_t *cache, uint8_t reg, uint8_t mask, uint8_t value)
+{
+    uint8_t current;
+    ESP_RETURN_ON_ERROR(i2c_cache_read(cache, reg, &current), TAG, "update of 0x%02x", reg);
+    return i2c_cache_write(cache, reg, (current & ~mask) | (value & mask));
+}
+
+esp_err_t i2c_cache_commit(i2c_reg_cache_t *cache)
+{
+    uint32_t reg = 0;
+    while (reg < I2C_CACHE_REGS)
+    {
+        if ((reg & 31) == 0 && cache->dirty[reg >> 5] == 0)
+        {
+            reg += 32;
+            continue;
+        }
+        if (!reg_bit(cache->dirty, reg))
+        {
+            reg++;
+            continue;
+        }
+        uint32_t first = reg;
+        while (reg < I2C_CACHE_REGS && reg - first < I2C_BURST_MAX && reg_bit(cache->dirty, reg)) reg++;
+
+        cache->bus_writes++;
+        esp_err_t err = i2c_write_registers(cache->dev_handle, first, &cache->values[first], reg - first);
+        if (err != ESP_OK)
+        {
+            //The device state is unknown now, the next access reads it back
+            while (first < reg)
+            {
+                clear_reg_bit(cache->valid, first);
+                clear_reg_bit(cache->dirty, first++);
+            }
+            return err;
+        }
+        while (first < reg) clear_reg_bit(cache->dirty, first++);
+    }
+    return ESP_OK;
 }
 
 esp_err_t i2c_write_register(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t value)
@@ -67,12 +499,30 @@ esp_err_t i2c_write_register(i2c_master_dev_handle_t dev_handle, uint8_t reg, ui
     uint8_t writeBuff[2];
 	writeBuff[0] = reg;
 	writeBuff[1] = value;
-	return i2c_master_transmit(dev_handle, writeBuff, 2, -1);
+	return transfer(dev_handle, writeBuff, 2, NULL, 0);
+}
+
+//Auto-incrementing write of consecutive registers starting at reg
+esp_err_t i2c_write_registers(i2c_master_dev_handle_t dev_handle, uint8_t reg, const uint8_t *data, size_t len)
+{
+    uint8_t writeBuff[I2C_BURST_MAX + 1];
+    if (len > I2C_BURST_MAX)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+	writeBuff[0] = reg;
+	memcpy(&writeBuff[1], data, len);
+	return transfer(dev_handle, writeBuff, len + 1, NULL, 0);
 }
 
 esp_err_t i2c_read_register(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t *value)
 {
-	return i2c_master_transmit_receive(dev_handle, &reg, 1, value, 1, -1);
+	return transfer(dev_handle, &reg, 1, value, 1);
+}
+
+esp_err_t i2c_read_registers(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t *data, size_t len)
+{
+	return transfer(dev_handle, &reg, 1, data, len);
 }
 
 uint8_t i2c_get_register8(i2c_master_dev_handle_t dev_handle, uint8_t reg)
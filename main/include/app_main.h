@@ -8,5 +8,6 @@ typedef struct
     i2c_master_dev_handle_t axp2101_handle;
     i2c_master_dev_handle_t ft5436_handle;
     i2c_master_dev_handle_t drv2605_handle;
+    esp_lcd_panel_io_handle_t st7789_io_handle;
     esp_lcd_panel_handle_t st7789_handle;
 } peripheral_handles_t;
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "driver/i2c_master.h"
+#include <stdbool.h>
 
 #define AXP2101_SLAVE_ADDRESS                            (0x34)
 
@@ -218,5 +219,71 @@
 
 #define XPOWERS_AXP2101_CONVERSION(raw)                 (22.0 + (7274 - raw) / 20.0)
 
+// IRQ bits, byte n of the mask is INTEN/INTSTS register n
+#define AXP2101_IRQ_SOC_NEW                              (1UL << 4)
+#define AXP2101_IRQ_WARNING_LEVEL1                       (1UL << 6)
+#define AXP2101_IRQ_WARNING_LEVEL2                       (1UL << 7)
+#define AXP2101_IRQ_PKEY_LONG                            (1UL << 10)
+#define AXP2101_IRQ_PKEY_SHORT                           (1UL << 11)
+#define AXP2101_IRQ_VBUS_REMOVE                          (1UL << 14)
+#define AXP2101_IRQ_VBUS_INSERT                          (1UL << 15)
+#define AXP2101_IRQ_CHG_START                            (1UL << 19)
+#define AXP2101_IRQ_CHG_DONE                             (1UL << 20)
+#define AXP2101_IRQ_ENABLED                              (AXP2101_IRQ_SOC_NEW | AXP2101_IRQ_WARNING_LEVEL1 | \
+                                                          AXP2101_IRQ_WARNING_LEVEL2 | AXP2101_IRQ_PKEY_LONG | \
+                                                          AXP2101_IRQ_PKEY_SHORT | AXP2101_IRQ_VBUS_REMOVE | \
+                                                          AXP2101_IRQ_VBUS_INSERT | AXP2101_IRQ_CHG_START | \
+                                                          AXP2101_IRQ_CHG_DONE)
+#define AXP2101_IRQ_MAX_PASSES                           (4)
+#define XPOWERS_AXP2101_STATUS1_VBUS_GOOD                (1U << 5)
+
+#define AXP2101_ADC_DATA_SIZE                            (XPOWERS_AXP2101_ADC_DATA_RELUST9 - XPOWERS_AXP2101_ADC_DATA_RELUST0 + 1)
+
+typedef struct
+{
+    uint16_t battery_mv;
+    uint16_t vbus_mv;               // 0 without VBUS, the ADC then reports noise
+    uint16_t system_mv;
+    int16_t die_temp_dc;            // 0.1 degC
+} axp2101_adc_t;
+
+// LDO_ONOFF_CTRL0 bits of the rails used on this board
+#define AXP2101_LDO_ALDO1                                (1U << 0)
+#define AXP2101_LDO_ALDO2                                (1U << 1)
+#define AXP2101_LDO_ALDO3                                (1U << 2)
+#define AXP2101_LDO_ALDO4                                (1U << 3)
+#define AXP2101_LDO_BLDO2                                (1U << 5)
+
+typedef enum
+{
+    Axp2101RailRtc,         // ALDO1, held by the driver so the clock keeps running
+    Axp2101RailBacklight,   // ALDO2
+    Axp2101RailTouch,       // ALDO3
+    Axp2101RailRadio,       // ALDO4
+    Axp2101RailHaptic,      // BLDO2
+    Axp2101RailCount
+} axp2101_rail_t;
+
+// Runs in the I2C worker task with the AXP2101_IRQ_* bits that were set
+typedef void (*axp2101_event_cb_t)(uint32_t events, void *user_data);
+// Runs in the I2C worker task, adc is NULL when the read failed
+typedef void (*axp2101_adc_cb_t)(const axp2101_adc_t *adc, void *user_data);
+// Runs in the I2C worker task once the rail is on and past its ramp
+typedef void (*axp2101_rail_cb_t)(esp_err_t err, void *user_data);
+
 void axp2101_init(i2c_master_dev_handle_t dev);
+esp_err_t axp2101_irq_init(axp2101_event_cb_t cb, void *user_data);
+bool axp2101_is_vbus_present(void);
+// Reference counted, the LDO is switched on by the first user and off by the last, not from an ISR
+esp_err_t axp2101_rail_acquire(axp2101_rail_t rail, bool *powered_up);
+esp_err_t axp2101_rail_release(axp2101_rail_t rail);
+// The same, queued to the system bus worker so the caller never waits on the bus or the ramp. Other system bus jobs
+// queue behind the ramp, so these are for rails with short ramps. One acquire per rail may be outstanding, cb may be NULL
+esp_err_t axp2101_rail_acquire_async(axp2101_rail_t rail, axp2101_rail_cb_t cb, void *user_data);
+esp_err_t axp2101_rail_release_async(axp2101_rail_t rail);
+// Time the LDO has been on since boot, whoever switched it
+uint64_t axp2101_rail_get_on_time_us(axp2101_rail_t rail);
+// All ADC results in one burst, one request may be outstanding at a time
+esp_err_t axp2101_request_adc(axp2101_adc_cb_t cb, void *user_data);
+esp_err_t axp2101_request_battery_percentage(void);
 uint8_t axp2101_get_battery_percentage();
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+#include "esp_err.h"
+#include "esp_lcd_types.h"
+
+//The panel is mounted mirrored, its visible rows start here in the ST7789 frame memory
+#define DISPLAY_FLUSH_ROW_OFFSET (80)
+
+typedef struct
+{
+    uint32_t strips;    //Areas (partial) or planned windows (direct) sent to the panel
+    uint32_t bytes;     //Pixel payload plus window setup, see FLUSH_PLANNER_WINDOW_OVERHEAD_BYTES
+} display_flush_stats_t;
+
+//Installs the flush callback on disp and the color transfer callback on io. LVGL gets flush ready from the SPI
+//ISR once the payload has left its buffer, so it renders the next area while the previous one is on the wire
+esp_err_t display_flush_init(lv_display_t *disp, esp_lcd_panel_handle_t panel, esp_lcd_panel_io_handle_t io, bool direct);
+//Blocks until every transfer of the last flush completed, false on timeout
+bool display_flush_wait(uint32_t timeout_ms);
+//Counters since the last call
+void display_flush_get_stats(display_flush_stats_t *stats);
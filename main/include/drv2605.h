@@ -1,6 +1,7 @@
 #pragma once
 
 #include "driver/i2c_master.h"
+#include <stdbool.h>
 
 #define DRV2605_SLAVE_ADDRESS       (0x5A)
 
@@ -51,6 +52,17 @@
 #define DRV2605_REG_VBAT            (0x21)              //* Vbat voltage-monitor register
 #define DRV2605_REG_LRARESON        (0x22)              //* LRA resonance-period register
 
+#define DRV2605_WAVESEQ_COUNT       (8)
+#define DRV2605_WAVESEQ_WAIT        (0x80)              //* Slot is a pause of (value & 0x7F) x 10 ms
+#define DRV2605_WAIT_MS(ms)         ((uint8_t)(DRV2605_WAVESEQ_WAIT | ((ms) / 10)))
+#define DRV2605_WAVESEQ_END         (0x00)              //* Ends the sequence early
+
 void drv2605_init(i2c_master_dev_handle_t dev);
-void drv2605_go();
-void drv2605_stop();
\ No newline at end of file
+esp_err_t drv2605_load_sequence(const uint8_t sequence[DRV2605_WAVESEQ_COUNT]);
+//Powers the haptic rail on first use and replays the configuration if it was off
+esp_err_t drv2605_go(void);
+esp_err_t drv2605_stop(void);
+//Reads GO from the device, one short I2C transaction
+esp_err_t drv2605_is_playing(bool *playing);
+//Releases the haptic rail, the next go powers it up again
+esp_err_t drv2605_power_down(void);
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#define ENERGY_PROFILER_PERIOD_MS (10 * 60 * 1000)
+#define ENERGY_PROFILER_MAX_TASKS (24)
+#define ENERGY_PROFILER_BATTERY_MAH (470)
+//The fuel gauge moves in 1% steps, fewer than this are not a usable measurement
+#define ENERGY_PROFILER_MIN_DROP_PERCENT (2)
+
+//Board estimates of what each consumer draws from the battery while active, in uA
+#define ENERGY_PROFILER_BASE_UA (1500)          //Light sleep, PMU and regulators
+#define ENERGY_PROFILER_CPU_CORE_UA (20000)     //Per core while a task runs
+#define ENERGY_PROFILER_BACKLIGHT_UA (25000)
+#define ENERGY_PROFILER_TOUCH_UA (3000)         //ALDO3 also feeds the panel
+#define ENERGY_PROFILER_RADIO_UA (5000)
+#define ENERGY_PROFILER_HAPTIC_UA (60000)
+
+typedef struct
+{
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t ua;                    //Average over the window, i.e. uAh per hour
+} energy_entry_t;
+
+typedef struct
+{
+    uint32_t window_s;
+    uint32_t model_ua;              //Sum of all entries before scaling
+    uint32_t measured_ua;           //From the fuel gauge over its baseline, which can span several windows, 0 without a usable drop
+    bool charging;                  //VBUS was seen, the window says nothing about drain
+    size_t count;
+    energy_entry_t entries[ENERGY_PROFILER_MAX_TASKS + 5];  //Tasks, then base, backlight, touch, radio, haptic
+} energy_report_t;
+
+esp_err_t energy_profiler_init(void);
+//Starts a new window, e.g. when the charger is removed
+void energy_profiler_reset(void);
+//Scaled to the fuel gauge when the window has a measurement, fills the report for the log or a BLE characteristic
+void energy_profiler_get_report(energy_report_t *report);
+//Logs the report and starts a new window, every ENERGY_PROFILER_PERIOD_MS from the esp_timer task
+void energy_profiler_log_report(void);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+
+#define FLUSH_PLANNER_MAX_WINDOWS (32)
+//CASET, RASET and RAMWR with their parameters plus the setup time of three SPI transactions at 10 MHz
+#define FLUSH_PLANNER_WINDOW_OVERHEAD_BYTES (32)
+
+typedef struct
+{
+    lv_area_t area;
+    bool band;          //Sent as one full-width window, otherwise as one window per row span
+    uint16_t transfers; //Number of draw_bitmap calls needed
+} flush_window_t;
+
+void flush_planner_reset(void);
+void flush_planner_add(const lv_area_t *area);
+uint8_t flush_planner_plan(const flush_window_t **windows);
+uint32_t flush_planner_get_unplanned_bytes(void);
+uint32_t flush_planner_get_planned_bytes(void);
\ No newline at end of file
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "driver/i2c_master.h"
+#include "freertos/FreeRTOS.h"
 
 #define FT6X36_ADDR						0x38
 
@@ -41,6 +43,12 @@
 #define FT6X36_REG_PANEL_ID				0xA8
 #define FT6X36_REG_STATE				0xBC
 
+#define FT6X36_INT_MODE_POLLING			0x00 // INT held low while touched
+#define FT6X36_INT_MODE_TRIGGER			0x01 // INT pulsed once per report
+
+#define FT6X36_CTRL_KEEP_ACTIVE			0x00
+#define FT6X36_CTRL_AUTO_MONITOR		0x01 // Drop to monitor mode after TIME_ENTER_MONITOR without touch
+
 #define FT6X36_PMODE_ACTIVE				0x00
 #define FT6X36_PMODE_MONITOR			0x01
 #define FT6X36_PMODE_STANDBY			0x02
@@ -66,6 +74,12 @@
 #define FT6X36_MSB_MASK                 0x0F
 #define FT6X36_LSB_MASK                 0xFF
 
+#define FT6X36_WAKE_PULSE_MS			5
+#define FT6X36_WAKE_READY_MS			50
+
+#define FT6X36_MAX_TOUCH_POINTS			2
+#define FT6X36_TOUCH_DATA_SIZE			(FT6X36_REG_P2_MISC + 1) // Registers 0x00-0x0E in one burst
+
 typedef enum 
 {
 	PressDown,
@@ -83,7 +97,12 @@ typedef enum
 	Tap,
 	DragStart,
 	DragMove,
-	DragEnd
+	DragEnd,
+	DoubleTap,
+	LongPress,
+	Swipe,
+	ZoomIn,
+	ZoomOut
 } ft5436_event_t;
 
 typedef struct 
@@ -92,10 +111,60 @@ typedef struct
 	uint16_t y;
 } ft5436_point_t;
 
+typedef struct __attribute__((packed))
+{
+	uint16_t x;
+	uint16_t y;
+	uint8_t event;	// ft5436_raw_event_t
+	uint8_t id;
+	uint8_t weight;
+	uint8_t area;
+} ft5436_touch_point_t;
+
+typedef struct __attribute__((packed))
+{
+	uint8_t gesture_id;
+	uint8_t count;
+	ft5436_touch_point_t points[FT6X36_MAX_TOUCH_POINTS];
+} ft5436_touch_data_t;
+
+// On-chip gesture engine thresholds, registers 0x91-0x96
+typedef struct
+{
+	uint8_t radian;					// Minimum angle for a swipe to count as straight
+	uint8_t offset_left_right;		// Maximum perpendicular drift during a left/right swipe
+	uint8_t offset_up_down;			// Maximum perpendicular drift during an up/down swipe
+	uint8_t distance_left_right;	// Minimum travel for a left/right swipe
+	uint8_t distance_up_down;		// Minimum travel for an up/down swipe
+	uint8_t distance_zoom;			// Minimum change in finger distance for a zoom
+} ft5436_gesture_config_t;
+
+#define FT5436_GESTURE_DEFAULT_CONFIG() { \
+	.radian = 10, \
+	.offset_left_right = 25, \
+	.offset_up_down = 25, \
+	.distance_left_right = 25, \
+	.distance_up_down = 25, \
+	.distance_zoom = 50 \
+}
+
+// Runs in the touch bus worker, data holds no points when ok is false
+typedef void (*ft5436_touch_cb_t)(bool ok, const ft5436_touch_data_t *data, void *user_data);
+
 void ft5436_init(i2c_master_dev_handle_t dev, uint8_t threshold);
 void ft5436_register_isr_handler(void (*fn)(void *arg));
 void ft5436_xy_touch(ft5436_point_t *point, uint8_t *count);
 void ft5436_xy_event(ft5436_point_t *point, ft5436_event_t *event);
+bool ft5436_read_touch_data(ft5436_touch_data_t *data);
+// The same burst queued on the touch bus worker, the callback and its argument are shared by all requests
+esp_err_t ft5436_request_touch_data(ft5436_touch_cb_t cb, void *user_data);
+esp_err_t ft5436_request_touch_data_from_isr(ft5436_touch_cb_t cb, void *user_data, BaseType_t *task_woken);
+esp_err_t ft5436_configure_gestures(const ft5436_gesture_config_t *config);
+esp_err_t ft5436_read_gesture(uint8_t *gesture_id, uint8_t *count);
+esp_err_t ft5436_set_report_rate(uint8_t rate);
+esp_err_t ft5436_set_monitor(bool auto_enter, uint8_t enter_time_s, uint8_t monitor_period);
+esp_err_t ft5436_set_power_mode(uint8_t mode);
+esp_err_t ft5436_wake(void);
 void ft5436_set_rotation(uint8_t rotation);
 void ft5436_set_touch_width(uint16_t width);
 void ft5436_set_touch_height(uint16_t height);
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define HAPTICS_QUEUE_LEN (8)
+#define HAPTICS_PENDING_MAX (4)         //Waiting patterns, the lowest priority one is dropped when full
+#define HAPTICS_TASK_STACK_SIZE (3 * 1024)
+#define HAPTICS_TASK_PRIORITY (2)
+#define HAPTICS_POLL_MS (20)            //GO is read this often while a pattern plays
+#define HAPTICS_EFFECT_MAX_MS (1000)    //Bound for one ROM effect slot, the long transition ramps take about a second
+#define HAPTICS_TIMEOUT_SLACK_MS (200)  //Added to a pattern's bound before it is stopped as stuck
+#define HAPTICS_POWER_DOWN_MS (1000)    //Idle time before the haptic rail is released
+
+typedef enum
+{
+    HapticPatternClick,
+    HapticPatternDoubleClick,
+    HapticPatternNotify,
+    HapticPatternCharge,
+    HapticPatternAlarm,
+    HapticPatternCount
+} haptic_pattern_t;
+
+//A higher priority pattern interrupts the one playing, equal ones wait in order
+typedef enum
+{
+    HapticPriorityUi,
+    HapticPriorityNotification,
+    HapticPriorityAlarm
+} haptic_priority_t;
+
+esp_err_t haptics_init(void);
+//One queue push, never waits, ESP_ERR_NO_MEM if the queue is full
+esp_err_t haptics_play(haptic_pattern_t pattern, haptic_priority_t priority);
@@ -1,8 +1,104 @@
 #pragma once
 
 #include "app_main.h"
+#include "freertos/FreeRTOS.h"
+
+#define I2C_BURST_MAX (32)
+#define I2C_STANDARD_MODE_HZ (100000U)
+#define I2C_FAST_MODE_HZ (400000U)
+
+//One entry of a device init table, consecutive registers are merged into one auto-increment burst
+typedef struct
+{
+    uint8_t reg;
+    uint8_t value;
+    uint8_t verify_mask; //Bits compared by the CONFIG_WATCH_VERIFY_INIT_TABLES readback, 0 for write-only or self-clearing registers
+} i2c_reg_init_t;
+
+#define I2C_REG(r, v) { .reg = (r), .value = (v), .verify_mask = 0xFF }
+#define I2C_REG_MASKED(r, v, m) { .reg = (r), .value = (v), .verify_mask = (m) }
+
+#define I2C_JOB_QUEUE_LEN (8)
+#define I2C_WORKER_STACK_SIZE (3 * 1024)
+#define I2C_WORKER_PRIORITY (3)
+#define I2C_DEFAULT_TIMEOUT_MS (20)
+#define I2C_RETRY_MAX (2)
+#define I2C_RETRY_BACKOFF_MS (1)       //Doubles with every retry
+#define I2C_CACHE_REGS (256)
+#define I2C_CACHE_WORDS (I2C_CACHE_REGS / 32)
+
+//Inclusive register range that is never cached (status, ADC, self-clearing)
+typedef struct
+{
+    uint8_t first;
+    uint8_t last;
+} i2c_reg_range_t;
+
+//Shadow copy of a device's register file, callers serialize access per device
+typedef struct
+{
+    i2c_master_dev_handle_t dev_handle;
+    uint8_t values[I2C_CACHE_REGS];
+    uint32_t volatile_map[I2C_CACHE_WORDS];
+    uint32_t valid[I2C_CACHE_WORDS];
+    uint32_t dirty[I2C_CACHE_WORDS];
+    uint32_t bus_reads;
+    uint32_t bus_writes;
+} i2c_reg_cache_t;
+
+typedef enum
+{
+    I2C_BUS_TOUCH,      //FT6x36
+    I2C_BUS_SYSTEM,     //AXP2101, DRV2605
+    I2C_BUS_COUNT
+} i2c_bus_t;
+
+//Counters are updated without locking, a sample taken while a transaction finishes may be off by one
+typedef struct
+{
+    uint32_t transactions;
+    uint32_t errors;            //Failed attempts, including ones that succeeded on retry
+    uint32_t retries;
+    uint32_t recoveries;        //Bus clears after a timeout
+    uint32_t failures;          //Transactions that failed after all retries
+    uint32_t latency_max_us;
+    uint64_t latency_sum_us;
+} i2c_device_stats_t;
+
+//Runs in the bus worker task, data holds the bytes read (reads only)
+typedef void (*i2c_job_cb_t)(esp_err_t err, const uint8_t *data, size_t len, void *user_data);
+//Runs in the bus worker task, which owns the bus meanwhile, so it may use the blocking calls for devices on that bus
+typedef void (*i2c_call_fn_t)(void *arg);
 
 void i2c_controller_init(peripheral_handles_t *peripherals);
 esp_err_t i2c_write_register(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t value);
+esp_err_t i2c_write_registers(i2c_master_dev_handle_t dev_handle, uint8_t reg, const uint8_t *data, size_t len);
 esp_err_t i2c_read_register(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t *value);
-uint8_t i2c_get_register8(i2c_master_dev_handle_t dev_handle, uint8_t reg);
\ No newline at end of file
+esp_err_t i2c_read_registers(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t *data, size_t len);
+esp_err_t i2c_write_init_table(i2c_master_dev_handle_t dev_handle, const i2c_reg_init_t *table, size_t count);
+uint8_t i2c_get_register8(i2c_master_dev_handle_t dev_handle, uint8_t reg);
+void i2c_cache_init(i2c_reg_cache_t *cache, i2c_master_dev_handle_t dev_handle, const i2c_reg_range_t *volatile_ranges, size_t count);
+//Marks the values of an already written init table as known
+void i2c_cache_seed(i2c_reg_cache_t *cache, const i2c_reg_init_t *table, size_t count);
+void i2c_cache_invalidate(i2c_reg_cache_t *cache);
+//Marks every known register dirty, so the next commit rewrites the configuration of a device that lost power
+void i2c_cache_restore(i2c_reg_cache_t *cache);
+esp_err_t i2c_cache_read(i2c_reg_cache_t *cache, uint8_t reg, uint8_t *value);
+//Cached registers are only marked dirty until the next commit, volatile ones go to the wire right away
+esp_err_t i2c_cache_write(i2c_reg_cache_t *cache, uint8_t reg, uint8_t value);
+esp_err_t i2c_cache_update_bits(i2c_reg_cache_t *cache, uint8_t reg, uint8_t mask, uint8_t value);
+//Writes all dirty registers, consecutive ones as one burst
+esp_err_t i2c_cache_commit(i2c_reg_cache_t *cache);
+
+//Queue a transaction on the device's bus worker, fails with ESP_ERR_NO_MEM instead of waiting when the queue is full
+esp_err_t i2c_submit_read(i2c_master_dev_handle_t dev_handle, uint8_t reg, size_t len, i2c_job_cb_t cb, void *user_data);
+esp_err_t i2c_submit_read_from_isr(i2c_master_dev_handle_t dev_handle, uint8_t reg, size_t len, i2c_job_cb_t cb, void *user_data,
+    BaseType_t *task_woken);
+esp_err_t i2c_submit_write(i2c_master_dev_handle_t dev_handle, uint8_t reg, const uint8_t *data, size_t len, i2c_job_cb_t cb, void *user_data);
+//Queue a multi-transaction sequence (a state change, a rail switch and its ramp) in order with the bus's other jobs
+esp_err_t i2c_submit_call(i2c_bus_t bus, i2c_call_fn_t fn, void *arg);
+
+//Bounds a whole call including its retries, not each attempt
+void i2c_set_device_timeout(i2c_master_dev_handle_t dev_handle, uint16_t timeout_ms);
+esp_err_t i2c_get_device_stats(i2c_master_dev_handle_t dev_handle, i2c_device_stats_t *stats);
+void i2c_log_stats(void);
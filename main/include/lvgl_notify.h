@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define LVGL_NOTIFY_TOUCH (1 << 0)
+#define LVGL_NOTIFY_TIMER (1 << 1)
+#define LVGL_NOTIFY_PMU (1 << 2)
+#define LVGL_NOTIFY_WAKE (1 << 3)
+//Index 0 belongs to LVGL itself, lv_thread_sync_wait takes it with LV_USE_FREERTOS_TASK_NOTIFY.
+//Needs CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES of at least 2
+#define LVGL_NOTIFY_INDEX (1)
+
+//Events are dropped until the LVGL task is set
+void lvgl_notify_init(TaskHandle_t lvgl_task);
+void lvgl_notify(uint32_t bits);
+void lvgl_notify_from_isr(uint32_t bits, BaseType_t *woken);
+//Called by the LVGL task, collects every bit sent since the last call. False on timeout
+bool lvgl_notify_wait(uint32_t timeout_ms, uint32_t *bits);
+//Returns from lvgl_notify_wait since the last call
+uint32_t lvgl_notify_get_wakeups(void);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#define POWER_PROFILE_MAX_FREQ_MHZ (240)
+#define POWER_PROFILE_MIN_FREQ_MHZ (CONFIG_XTAL_FREQ)
+
+//Work that keeps the chip out of light sleep while it runs
+typedef enum
+{
+    PowerClientRender,      //lv_timer_handler, CPU at POWER_PROFILE_MAX_FREQ_MHZ
+    PowerClientFlush,       //Panel DMA in flight, APB at 80 MHz
+    PowerClientI2C,         //I2C transaction, APB at 80 MHz
+    PowerClientCount
+} power_client_t;
+
+typedef enum
+{
+    PowerStateBurst,        //Render lock held
+    PowerStateIO,           //Only flush or I2C locks held
+    PowerStateIdle,         //No lock, light sleep whenever FreeRTOS is idle long enough
+    PowerStateCount
+} power_state_t;
+
+//Runs in the ISR of a screen-off wake-up line
+typedef void (*power_wake_cb_t)(int gpio_num);
+
+//Creates the locks, acquire and release are no-ops before this
+esp_err_t power_profile_init(void);
+//Configures DFS and light sleep, once the wake-up GPIOs have their interrupt handlers
+esp_err_t power_profile_start(void);
+void power_profile_set_wake_cb(power_wake_cb_t cb);
+//Arms the lines that only matter while the screen is off (RTC alarm, accelerometer), each one fires once per arming
+esp_err_t power_profile_set_screen_wake(bool armed);
+//Reference counted per client, both may be called from an ISR that is not in IRAM
+void power_profile_acquire(power_client_t client);
+void power_profile_release(power_client_t client);
+//Time per state and per client since the last call
+void power_profile_log_stats(void);
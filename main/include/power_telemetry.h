@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define POWER_TELEMETRY_PERIOD_CHARGING_MS (10 * 1000)
+#define POWER_TELEMETRY_PERIOD_BATTERY_MS (60 * 1000)
+#define POWER_TELEMETRY_DOWNSAMPLE (5)      //Samples averaged into one history entry
+#define POWER_TELEMETRY_HISTORY_SIZE (128)  //5 min per entry on battery, about 10 h
+
+#define POWER_TELEMETRY_FLAG_VBUS (1U << 0)
+
+//14 bytes, so the history stays under 2 KB
+typedef struct __attribute__((packed))
+{
+    uint32_t time_s;                //Uptime at the last sample of the entry
+    uint16_t battery_mv;
+    uint16_t vbus_mv;
+    uint16_t system_mv;
+    int16_t die_temp_dc;            //0.1 degC
+    uint8_t battery_percentage;
+    uint8_t flags;                  //POWER_TELEMETRY_FLAG_*, set if seen in any sample of the entry
+} power_sample_t;
+
+esp_err_t power_telemetry_init(void);
+//Takes a sample now, e.g. after a charger event, and reschedules the timer for the current charge state.
+//The sample runs in the esp_timer task like the periodic ones, this only arms it
+void power_telemetry_sample_now(void);
+esp_err_t power_telemetry_get_latest(power_sample_t *sample);
+//Copies the history oldest first, returns the number of entries copied
+size_t power_telemetry_get_history(power_sample_t *out, size_t max);
@@ -2,4 +2,10 @@
 
 #include "app_main.h"
 
-void st7789_init(peripheral_handles_t *peripherals);
\ No newline at end of file
+#include <stdbool.h>
+
+#define ST7789_SLEEP_SETTLE_MS      (120)   //Between SLPIN and SLPOUT in either order
+
+void st7789_init(peripheral_handles_t *peripherals);
+//SLPIN/SLPOUT, the frame memory is kept so nothing has to be redrawn on wake
+esp_err_t st7789_set_sleep(esp_lcd_panel_handle_t panel, bool sleep);
\ No newline at end of file
@@ -52,4 +52,11 @@
 #define BOARD_MIC_DATA              (47)
 #define BOARD_MIC_CLOCK             (44)
 
-#define GRAPHICS_BUFFER_SIZE (BOARD_TFT_WIDTH * BOARD_TFT_HEIGHT / 10)
\ No newline at end of file
+//1: keep one full-frame buffer and only push changed rows, 0: double-buffered 1/10 screen strips
+#define GRAPHICS_DIRECT_MODE (0)
+
+#if GRAPHICS_DIRECT_MODE
+#define GRAPHICS_BUFFER_SIZE (BOARD_TFT_WIDTH * BOARD_TFT_HEIGHT)
+#else
+#define GRAPHICS_BUFFER_SIZE (BOARD_TFT_WIDTH * BOARD_TFT_HEIGHT / 10)
+#endif
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include "touch_gesture.h"
+
+typedef struct
+{
+	float alpha;				// Position gain, lower removes more jitter but lags more
+	float beta;					// Velocity gain
+	uint16_t predict_ms;		// Extrapolation horizon, roughly read-to-photon time
+	uint16_t max_predict_px;	// Clamp on the extrapolated offset so flicks do not overshoot
+	uint8_t deadband_px;		// Movement below this while nearly still is treated as jitter
+} touch_filter_config_t;
+
+#define TOUCH_FILTER_DEFAULT_CONFIG() { \
+	.alpha = 0.6f, \
+	.beta = 0.15f, \
+	.predict_ms = 25, \
+	.max_predict_px = 24, \
+	.deadband_px = 2 \
+}
+
+void touch_filter_init(const touch_filter_config_t *config, uint16_t width, uint16_t height);
+void touch_filter_reset(void);
+// Filters one pressed sample and returns the position predicted for predict_ms ahead
+void touch_filter_update(const touch_sample_t *sample, ft5436_point_t *out);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ft5436.h"
+
+#define TOUCH_RING_SIZE					32	// Power of two
+
+typedef struct
+{
+	int64_t time_us;
+	uint16_t x;
+	uint16_t y;
+	bool pressed;
+	uint8_t gesture_id;				// FT6X36_GEST_ID_*, taken from the same burst read
+} touch_sample_t;
+
+typedef enum
+{
+	SwipeNone,
+	SwipeUp,
+	SwipeDown,
+	SwipeLeft,
+	SwipeRight
+} touch_swipe_dir_t;
+
+typedef struct
+{
+	ft5436_event_t type;
+	ft5436_point_t point;
+	touch_swipe_dir_t direction;	// Swipe only
+	int32_t vx;						// px/s, drag and swipe only
+	int32_t vy;
+	int64_t time_us;
+	uint16_t samples;				// Samples (one I2C read each) from press to recognition
+} touch_gesture_t;
+
+typedef struct
+{
+	uint16_t tap_max_ms;
+	uint16_t double_tap_ms;			// Max gap between the release of the first tap and the second press
+	uint16_t long_press_ms;
+	uint16_t move_threshold_px;		// Movement that turns a press into a drag
+	uint16_t swipe_min_distance_px;
+	uint16_t swipe_min_velocity;	// px/s at release
+	bool hw_gestures;				// Swipe and zoom from the controller's gesture engine instead of the coordinates
+} touch_gesture_config_t;
+
+#define TOUCH_GESTURE_DEFAULT_CONFIG() { \
+	.tap_max_ms = 250, \
+	.double_tap_ms = 300, \
+	.long_press_ms = 600, \
+	.move_threshold_px = 10, \
+	.swipe_min_distance_px = 40, \
+	.swipe_min_velocity = 300, \
+	.hw_gestures = false \
+}
+
+typedef void (*touch_gesture_cb_t)(const touch_gesture_t *gesture, void *user_data);
+
+// Single producer, single consumer, no locks: push may run in an ISR or another task than pop
+bool touch_ring_push(const touch_sample_t *sample);
+bool touch_ring_pop(touch_sample_t *sample);
+uint32_t touch_ring_dropped(void);
+
+void touch_gesture_init(const touch_gesture_config_t *config, touch_gesture_cb_t cb, void *user_data);
+void touch_gesture_reset(void);
+// Drains the ring and feeds the recognizer, now_us drives long-press detection without new samples
+void touch_gesture_process(int64_t now_us);
+// Feeds one sample directly, for replaying recorded streams
+void touch_gesture_feed(const touch_sample_t *sample);
\ No newline at end of file
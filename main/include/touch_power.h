@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Report rates (TOUCHRATE_ACTIVE) and monitor scan period (TOUCHRATE_MONITOR, ms)
+#define TOUCH_POWER_RATE_NORMAL				0x06
+#define TOUCH_POWER_RATE_DRAG				0x0E
+#define TOUCH_POWER_MONITOR_PERIOD_MS		40
+#define TOUCH_POWER_MONITOR_ENTER_S			2
+// A hibernated controller cannot report a touch, the screen is then woken by the power key, RTC or accelerometer.
+// Off, so a tap on the dark screen still wakes it from monitor mode
+#ifndef TOUCH_POWER_HIBERNATE_ON_SCREEN_OFF
+#define TOUCH_POWER_HIBERNATE_ON_SCREEN_OFF	(0)
+#endif
+
+typedef enum
+{
+	TouchPowerActive,
+	TouchPowerDrag,
+	TouchPowerMonitor,
+	TouchPowerHibernate
+} touch_power_state_t;
+
+esp_err_t touch_power_init(void);
+// The setters only queue the transition, it runs in the touch bus worker
+void touch_power_set_dragging(bool dragging);
+void touch_power_set_ui_idle(bool idle);
+void touch_power_set_display_on(bool on);
+touch_power_state_t touch_power_get_state(void);
+uint32_t touch_power_get_transitions(void);
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "lvgl_notify.h"
+#include "sdkconfig.h"
+#include <stdint.h>
+
+#if CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES <= LVGL_NOTIFY_INDEX
+#error "LVGL task events need a second task notification, set CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES to 2"
+#endif
+
+static TaskHandle_t task_handle;
+static uint32_t wakeup_count;
+
+void lvgl_notify_init(TaskHandle_t lvgl_task)
+{
+    task_handle = lvgl_task;
+}
+
+void lvgl_notify(uint32_t bits)
+{
+    if (task_handle != NULL)
+    {
+        xTaskNotifyIndexed(task_handle, LVGL_NOTIFY_INDEX, bits, eSetBits);
+    }
+}
+
+void lvgl_notify_from_isr(uint32_t bits, BaseType_t *woken)
+{
+    if (task_handle != NULL)
+    {
+        xTaskNotifyIndexedFromISR(task_handle, LVGL_NOTIFY_INDEX, bits, eSetBits, woken);
+    }
+}
+
+bool lvgl_notify_wait(uint32_t timeout_ms, uint32_t *bits)
+{
+    BaseType_t woken;
+    *bits = 0;
+    woken = xTaskNotifyWaitIndexed(LVGL_NOTIFY_INDEX, 0, UINT32_MAX, bits,
+        timeout_ms == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms));
+    wakeup_count++;
+    return woken == pdTRUE;
+}
+
+uint32_t lvgl_notify_get_wakeups(void)
+{
+    uint32_t count = wakeup_count;
+    wakeup_count = 0;
+    return count;
+}
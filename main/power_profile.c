@@ -0,0 +1,221 @@
+#include "power_profile.h"
+#include "t_watch_s3.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+static const char *TAG = "power_profile";
+
+static const char *const client_names[PowerClientCount] = { "render", "flush", "i2c" };
+static const char *const state_names[PowerStateCount] = { "burst", "io", "idle" };
+//Interrupt lines that have to wake the chip from light sleep
+static const gpio_num_t wakeup_pins[] = { BOARD_TOUCH_INT, BOARD_PMU_INT };
+//Only armed while the screen is off, nothing clears these sources yet so they are masked after the first edge
+static const gpio_num_t screen_wake_pins[] = { BOARD_RTC_INT_PIN, BOARD_BMA423_INT1 };
+static const gpio_int_type_t screen_wake_levels[] = { GPIO_INTR_LOW_LEVEL, GPIO_INTR_HIGH_LEVEL };
+static power_wake_cb_t wake_cb = NULL;
+
+static esp_pm_lock_handle_t locks[PowerClientCount];
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static uint16_t refs[PowerClientCount];
+static power_state_t state = PowerStateIdle;
+static int64_t state_since_us;
+static int64_t client_since_us[PowerClientCount];
+static uint64_t state_us[PowerStateCount];
+static uint64_t client_us[PowerClientCount];
+static int64_t stats_since_us;
+
+static power_state_t resolve_state(void)
+{
+    if (refs[PowerClientRender] > 0) return PowerStateBurst;
+    if (refs[PowerClientFlush] > 0 || refs[PowerClientI2C] > 0) return PowerStateIO;
+    return PowerStateIdle;
+}
+
+//Called with the spinlock held
+static void update_state(int64_t now_us)
+{
+    power_state_t next = resolve_state();
+    if (next == state) return;
+    state_us[state] += now_us - state_since_us;
+    state_since_us = now_us;
+    state = next;
+}
+
+esp_err_t power_profile_init(void)
+{
+    ESP_RETURN_ON_ERROR(esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, client_names[PowerClientRender], &locks[PowerClientRender]),
+        TAG, "render lock");
+    ESP_RETURN_ON_ERROR(esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, client_names[PowerClientFlush], &locks[PowerClientFlush]),
+        TAG, "flush lock");
+    ESP_RETURN_ON_ERROR(esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, client_names[PowerClientI2C], &locks[PowerClientI2C]),
+        TAG, "i2c lock");
+    state_since_us = esp_timer_get_time();
+    stats_since_us = state_since_us;
+    return ESP_OK;
+}
+
+static void screen_wake_isr(void *arg)
+{
+    gpio_num_t pin = (gpio_num_t)(intptr_t)arg;
+    gpio_intr_disable(pin);
+    gpio_wakeup_disable(pin);
+    if (wake_cb != NULL) wake_cb(pin);
+}
+
+static esp_err_t init_screen_wake_pin(uint8_t index)
+{
+    gpio_num_t pin = screen_wake_pins[index];
+    bool active_low = screen_wake_levels[index] == GPIO_INTR_LOW_LEVEL;
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_DISABLE,
+        .pin_bit_mask = 1ULL << pin,
+        .mode = GPIO_MODE_INPUT,
+        .pull_down_en = active_low ? GPIO_PULLDOWN_DISABLE : GPIO_PULLDOWN_ENABLE,
+        .pull_up_en = active_low ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
+    };
+    ESP_RETURN_ON_ERROR(gpio_config(&io_conf), TAG, "wake pin %d", pin);
+    ESP_RETURN_ON_ERROR(gpio_sleep_sel_dis(pin), TAG, "sleep select %d", pin);
+    return gpio_isr_handler_add(pin, screen_wake_isr, (void *)(intptr_t)pin);
+}
+
+void power_profile_set_wake_cb(power_wake_cb_t cb)
+{
+    wake_cb = cb;
+}
+
+esp_err_t power_profile_set_screen_wake(bool armed)
+{
+    uint8_t i;
+    for (i = 0; i < sizeof(screen_wake_pins) / sizeof(screen_wake_pins[0]); ++i)
+    {
+        if (armed)
+        {
+            ESP_RETURN_ON_ERROR(gpio_wakeup_enable(screen_wake_pins[i], screen_wake_levels[i]), TAG, "arm %d", screen_wake_pins[i]);
+            ESP_RETURN_ON_ERROR(gpio_intr_enable(screen_wake_pins[i]), TAG, "arm %d", screen_wake_pins[i]);
+        }
+        else
+        {
+            gpio_intr_disable(screen_wake_pins[i]);
+            gpio_wakeup_disable(screen_wake_pins[i]);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t power_profile_start(void)
+{
+    uint8_t i;
+    for (i = 0; i < sizeof(screen_wake_pins) / sizeof(screen_wake_pins[0]); ++i)
+    {
+        ESP_RETURN_ON_ERROR(init_screen_wake_pin(i), TAG, "screen wake %d", screen_wake_pins[i]);
+    }
+    for (i = 0; i < sizeof(wakeup_pins) / sizeof(wakeup_pins[0]); ++i)
+    {
+        //Keep the pin configuration through sleep, the lines are active low
+        ESP_RETURN_ON_ERROR(gpio_sleep_sel_dis(wakeup_pins[i]), TAG, "sleep select %d", wakeup_pins[i]);
+        ESP_RETURN_ON_ERROR(gpio_wakeup_enable(wakeup_pins[i], GPIO_INTR_LOW_LEVEL), TAG, "wakeup %d", wakeup_pins[i]);
+    }
+    //The backlight and the panel control lines must not float while the chip sleeps between frames
+    ESP_RETURN_ON_ERROR(gpio_sleep_sel_dis(BOARD_TFT_BL), TAG, "backlight");
+    ESP_RETURN_ON_ERROR(gpio_sleep_sel_dis(BOARD_TFT_CS), TAG, "panel CS");
+    ESP_RETURN_ON_ERROR(gpio_sleep_sel_dis(BOARD_TFT_DC), TAG, "panel DC");
+    ESP_RETURN_ON_ERROR(esp_sleep_enable_gpio_wakeup(), TAG, "GPIO wakeup");
+
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = POWER_PROFILE_MAX_FREQ_MHZ,
+        .min_freq_mhz = POWER_PROFILE_MIN_FREQ_MHZ,
+        .light_sleep_enable = true
+    };
+    ESP_RETURN_ON_ERROR(esp_pm_configure(&pm_config), TAG, "DFS");
+    ESP_LOGI(TAG, "DFS %d-%d MHz with light sleep", POWER_PROFILE_MIN_FREQ_MHZ, POWER_PROFILE_MAX_FREQ_MHZ);
+    return ESP_OK;
+}
+
+void power_profile_acquire(power_client_t client)
+{
+    bool first;
+    if (locks[client] == NULL) return;
+
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL_SAFE(&lock);
+    first = refs[client]++ == 0;
+    if (first)
+    {
+        client_since_us[client] = now_us;
+        update_state(now_us);
+    }
+    portEXIT_CRITICAL_SAFE(&lock);
+
+    //esp_pm locks are counted too, one reference per client is enough
+    if (first) esp_pm_lock_acquire(locks[client]);
+}
+
+void power_profile_release(power_client_t client)
+{
+    bool last = false;
+    if (locks[client] == NULL) return;
+
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL_SAFE(&lock);
+    if (refs[client] > 0)
+    {
+        last = --refs[client] == 0;
+        if (last)
+        {
+            client_us[client] += now_us - client_since_us[client];
+            update_state(now_us);
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&lock);
+
+    if (last) esp_pm_lock_release(locks[client]);
+}
+
+void power_profile_log_stats(void)
+{
+    uint64_t states[PowerStateCount];
+    uint64_t clients[PowerClientCount];
+    uint8_t i;
+
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL_SAFE(&lock);
+    state_us[state] += now_us - state_since_us;
+    state_since_us = now_us;
+    for (i = 0; i < PowerClientCount; ++i)
+    {
+        if (refs[i] > 0)
+        {
+            client_us[i] += now_us - client_since_us[i];
+            client_since_us[i] = now_us;
+        }
+        clients[i] = client_us[i];
+        client_us[i] = 0;
+    }
+    for (i = 0; i < PowerStateCount; ++i)
+    {
+        states[i] = state_us[i];
+        state_us[i] = 0;
+    }
+    portEXIT_CRITICAL_SAFE(&lock);
+
+    uint64_t period_us = now_us - stats_since_us;
+    stats_since_us = now_us;
+    if (period_us == 0) return;
+    for (i = 0; i < PowerStateCount; ++i)
+    {
+        ESP_LOGI(TAG, "%s: %" PRIu64 " ms (%" PRIu64 "%%)", state_names[i], states[i] / 1000, states[i] * 100 / period_us);
+    }
+    for (i = 0; i < PowerClientCount; ++i)
+    {
+        ESP_LOGI(TAG, "%s held %" PRIu64 " ms", client_names[i], clients[i] / 1000);
+    }
+}
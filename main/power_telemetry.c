@@ -0,0 +1,167 @@
+#include "power_telemetry.h"
+#include "axp2101.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+static const char *TAG = "power_telemetry";
+
+static esp_timer_handle_t sample_timer;
+//One-shot for sample_now, so every sample and reschedule runs in the esp_timer task
+static esp_timer_handle_t now_timer;
+static uint64_t period_us;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static power_sample_t latest;
+static bool latest_valid;
+static power_sample_t history[POWER_TELEMETRY_HISTORY_SIZE];
+static uint16_t history_head;
+static uint16_t history_count;
+
+//Sums of the samples that go into the next history entry
+static uint32_t acc_battery_mv;
+static uint32_t acc_vbus_mv;
+static uint32_t acc_system_mv;
+static int32_t acc_die_temp_dc;
+static uint16_t acc_percentage;
+static uint8_t acc_flags;
+static uint8_t acc_count;
+
+static void schedule(void)
+{
+    uint64_t next_us = (uint64_t)(axp2101_is_vbus_present() ? POWER_TELEMETRY_PERIOD_CHARGING_MS
+        : POWER_TELEMETRY_PERIOD_BATTERY_MS) * 1000;
+    if (next_us == period_us) return;
+
+    period_us = next_us;
+    esp_timer_stop(sample_timer);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_timer_start_periodic(sample_timer, period_us));
+}
+
+static void accumulate(const power_sample_t *sample)
+{
+    acc_battery_mv += sample->battery_mv;
+    acc_vbus_mv += sample->vbus_mv;
+    acc_system_mv += sample->system_mv;
+    acc_die_temp_dc += sample->die_temp_dc;
+    acc_percentage += sample->battery_percentage;
+    acc_flags |= sample->flags;
+    if (++acc_count < POWER_TELEMETRY_DOWNSAMPLE) return;
+
+    power_sample_t entry = {
+        .time_s = sample->time_s,
+        .battery_mv = acc_battery_mv / acc_count,
+        .vbus_mv = acc_vbus_mv / acc_count,
+        .system_mv = acc_system_mv / acc_count,
+        .die_temp_dc = acc_die_temp_dc / acc_count,
+        .battery_percentage = acc_percentage / acc_count,
+        .flags = acc_flags
+    };
+    taskENTER_CRITICAL(&lock);
+    history[history_head] = entry;
+    history_head = (history_head + 1) % POWER_TELEMETRY_HISTORY_SIZE;
+    if (history_count < POWER_TELEMETRY_HISTORY_SIZE) history_count++;
+    taskEXIT_CRITICAL(&lock);
+
+    acc_battery_mv = 0;
+    acc_vbus_mv = 0;
+    acc_system_mv = 0;
+    acc_die_temp_dc = 0;
+    acc_percentage = 0;
+    acc_flags = 0;
+    acc_count = 0;
+}
+
+//Runs in the I2C worker
+static void adc_cb(const axp2101_adc_t *adc, void *user_data)
+{
+    if (adc == NULL)
+    {
+        ESP_LOGW(TAG, "ADC read failed");
+        return;
+    }
+
+    power_sample_t sample = {
+        .time_s = (uint32_t)(esp_timer_get_time() / 1000000),
+        .battery_mv = adc->battery_mv,
+        .vbus_mv = adc->vbus_mv,
+        .system_mv = adc->system_mv,
+        .die_temp_dc = adc->die_temp_dc,
+        .battery_percentage = axp2101_get_battery_percentage(),
+        .flags = adc->vbus_mv > 0 ? POWER_TELEMETRY_FLAG_VBUS : 0
+    };
+    taskENTER_CRITICAL(&lock);
+    latest = sample;
+    latest_valid = true;
+    taskEXIT_CRITICAL(&lock);
+
+    accumulate(&sample);
+    //Sign on its own, -0.5 C would otherwise print as 0.-5
+    ESP_LOGD(TAG, "bat %u mV, vbus %u mV, sys %u mV, die %s%d.%d C, %u%%", sample.battery_mv, sample.vbus_mv,
+        sample.system_mv, sample.die_temp_dc < 0 ? "-" : "", abs(sample.die_temp_dc / 10), abs(sample.die_temp_dc % 10),
+        sample.battery_percentage);
+}
+
+//Runs in the esp_timer task, the read itself is queued so the timer task never waits on the bus
+static void sample_timer_cb(void *arg)
+{
+    if (axp2101_request_adc(adc_cb, NULL) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "ADC request dropped");
+    }
+    schedule();
+}
+
+esp_err_t power_telemetry_init(void)
+{
+    const esp_timer_create_args_t timer_args = {
+        .callback = sample_timer_cb,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "power_telemetry",
+        .skip_unhandled_events = true
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &sample_timer), TAG, "timer");
+    const esp_timer_create_args_t now_args = {
+        .callback = sample_timer_cb,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "power_telemetry_now"
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&now_args, &now_timer), TAG, "timer");
+    sample_timer_cb(NULL);
+    return ESP_OK;
+}
+
+void power_telemetry_sample_now(void)
+{
+    //Already armed means a sample is about to be taken anyway
+    esp_timer_start_once(now_timer, 0);
+}
+
+esp_err_t power_telemetry_get_latest(power_sample_t *sample)
+{
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    taskENTER_CRITICAL(&lock);
+    if (latest_valid)
+    {
+        *sample = latest;
+        err = ESP_OK;
+    }
+    taskEXIT_CRITICAL(&lock);
+    return err;
+}
+
+size_t power_telemetry_get_history(power_sample_t *out, size_t max)
+{
+    size_t i;
+    taskENTER_CRITICAL(&lock);
+    size_t count = history_count < max ? history_count : max;
+    size_t first = (history_head + POWER_TELEMETRY_HISTORY_SIZE - count) % POWER_TELEMETRY_HISTORY_SIZE;
+    for (i = 0; i < count; ++i)
+    {
+        out[i] = history[(first + i) % POWER_TELEMETRY_HISTORY_SIZE];
+    }
+    taskEXIT_CRITICAL(&lock);
+    return count;
+}
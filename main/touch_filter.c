@@ -0,0 +1,86 @@
+#include "touch_filter.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define TOUCH_FILTER_STILL_PX_PER_MS (0.05f)
+
+static touch_filter_config_t config;
+static uint16_t max_x;
+static uint16_t max_y;
+static bool tracking;
+static int64_t last_time_us;
+static float pos_x;
+static float pos_y;
+static float vel_x;		// px/ms
+static float vel_y;
+static ft5436_point_t last_out;
+
+static float clampf(float value, float min, float max)
+{
+	return value < min ? min : (value > max ? max : value);
+}
+
+void touch_filter_init(const touch_filter_config_t *cfg, uint16_t width, uint16_t height)
+{
+	config = *cfg;
+	max_x = width - 1;
+	max_y = height - 1;
+	touch_filter_reset();
+}
+
+void touch_filter_reset(void)
+{
+	tracking = false;
+	vel_x = 0.0f;
+	vel_y = 0.0f;
+}
+
+//Alpha-beta tracker on position and velocity, then extrapolation to the expected display time
+void touch_filter_update(const touch_sample_t *sample, ft5436_point_t *out)
+{
+	if (!tracking)
+	{
+		tracking = true;
+		last_time_us = sample->time_us;
+		pos_x = sample->x;
+		pos_y = sample->y;
+		vel_x = 0.0f;
+		vel_y = 0.0f;
+		last_out.x = sample->x;
+		last_out.y = sample->y;
+		*out = last_out;
+		return;
+	}
+
+	float dt_ms = (sample->time_us - last_time_us) / 1000.0f;
+	last_time_us = sample->time_us;
+	if (dt_ms > 0.0f)
+	{
+		float pred_x = pos_x + vel_x * dt_ms;
+		float pred_y = pos_y + vel_y * dt_ms;
+		float res_x = sample->x - pred_x;
+		float res_y = sample->y - pred_y;
+		pos_x = pred_x + config.alpha * res_x;
+		pos_y = pred_y + config.alpha * res_y;
+		vel_x += config.beta * res_x / dt_ms;
+		vel_y += config.beta * res_y / dt_ms;
+	}
+
+	float ahead_x = clampf(vel_x * config.predict_ms, -config.max_predict_px, config.max_predict_px);
+	float ahead_y = clampf(vel_y * config.predict_ms, -config.max_predict_px, config.max_predict_px);
+	ft5436_point_t next = {
+		.x = (uint16_t)lroundf(clampf(pos_x + ahead_x, 0.0f, max_x)),
+		.y = (uint16_t)lroundf(clampf(pos_y + ahead_y, 0.0f, max_y))
+	};
+
+	bool still = fabsf(vel_x) < TOUCH_FILTER_STILL_PX_PER_MS && fabsf(vel_y) < TOUCH_FILTER_STILL_PX_PER_MS;
+	if (still && abs((int32_t)next.x - last_out.x) <= config.deadband_px &&
+		abs((int32_t)next.y - last_out.y) <= config.deadband_px)
+	{
+		*out = last_out;
+		return;
+	}
+	last_out = next;
+	*out = next;
+}
@@ -0,0 +1,260 @@
+#include "touch_gesture.h"
+#include <stdlib.h>
+
+static touch_sample_t ring[TOUCH_RING_SIZE];
+static uint32_t ring_head;	// Written by the producer only
+static uint32_t ring_tail;	// Written by the consumer only
+static volatile uint32_t ring_dropped;
+
+static touch_gesture_config_t config;
+static touch_gesture_cb_t gesture_cb = NULL;
+static void *gesture_user_data = NULL;
+
+static bool pressed;
+static bool dragging;
+static bool long_pressed;
+static bool hw_reported;
+static uint16_t press_samples;
+static touch_sample_t start;
+static touch_sample_t last;
+static int32_t velocity_x;
+static int32_t velocity_y;
+static bool tap_pending;
+static int64_t tap_release_us;
+static ft5436_point_t tap_point;
+
+bool touch_ring_push(const touch_sample_t *sample)
+{
+	uint32_t head = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+	uint32_t tail = __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE);
+	if (head - tail == TOUCH_RING_SIZE)
+	{
+		ring_dropped++;
+		return false;
+	}
+	ring[head & (TOUCH_RING_SIZE - 1)] = *sample;
+	__atomic_store_n(&ring_head, head + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+bool touch_ring_pop(touch_sample_t *sample)
+{
+	uint32_t tail = __atomic_load_n(&ring_tail, __ATOMIC_RELAXED);
+	uint32_t head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+	if (head == tail)
+	{
+		return false;
+	}
+	*sample = ring[tail & (TOUCH_RING_SIZE - 1)];
+	__atomic_store_n(&ring_tail, tail + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+uint32_t touch_ring_dropped(void)
+{
+	return ring_dropped;
+}
+
+static void emit(ft5436_event_t type, const touch_sample_t *at, touch_swipe_dir_t direction)
+{
+	if (gesture_cb == NULL) return;
+
+	touch_gesture_t gesture = {
+		.type = type,
+		.point = { .x = at->x, .y = at->y },
+		.direction = direction,
+		.vx = velocity_x,
+		.vy = velocity_y,
+		.time_us = at->time_us,
+		.samples = press_samples
+	};
+	gesture_cb(&gesture, gesture_user_data);
+}
+
+static touch_swipe_dir_t swipe_direction(void)
+{
+	int32_t dx = (int32_t)last.x - start.x;
+	int32_t dy = (int32_t)last.y - start.y;
+
+	if (abs(dx) >= abs(dy))
+	{
+		if (abs(dx) < config.swipe_min_distance_px || abs(velocity_x) < config.swipe_min_velocity) return SwipeNone;
+		return dx > 0 ? SwipeRight : SwipeLeft;
+	}
+	if (abs(dy) < config.swipe_min_distance_px || abs(velocity_y) < config.swipe_min_velocity) return SwipeNone;
+	return dy > 0 ? SwipeDown : SwipeUp;
+}
+
+static void check_hw_gesture(const touch_sample_t *sample)
+{
+	ft5436_event_t type = Swipe;
+	touch_swipe_dir_t direction = SwipeNone;
+
+	if (!config.hw_gestures || hw_reported) return;
+
+	switch (sample->gesture_id)
+	{
+		case FT6X36_GEST_ID_MOVE_UP:
+			direction = SwipeUp;
+			break;
+		case FT6X36_GEST_ID_MOVE_DOWN:
+			direction = SwipeDown;
+			break;
+		case FT6X36_GEST_ID_MOVE_LEFT:
+			direction = SwipeLeft;
+			break;
+		case FT6X36_GEST_ID_MOVE_RIGHT:
+			direction = SwipeRight;
+			break;
+		case FT6X36_GEST_ID_ZOOM_IN:
+			type = ZoomIn;
+			break;
+		case FT6X36_GEST_ID_ZOOM_OUT:
+			type = ZoomOut;
+			break;
+		default:
+			return;
+	}
+	hw_reported = true;
+	emit(type, sample, direction);
+}
+
+static void check_long_press(int64_t now_us)
+{
+	if (pressed && !dragging && !long_pressed && now_us - start.time_us >= (int64_t)config.long_press_ms * 1000)
+	{
+		long_pressed = true;
+		emit(LongPress, &last, SwipeNone);
+	}
+}
+
+static void on_press(const touch_sample_t *sample)
+{
+	pressed = true;
+	dragging = false;
+	long_pressed = false;
+	hw_reported = false;
+	press_samples = 1;
+	velocity_x = 0;
+	velocity_y = 0;
+	start = *sample;
+	last = *sample;
+}
+
+static void on_move(const touch_sample_t *sample)
+{
+	int64_t dt_us = sample->time_us - last.time_us;
+	press_samples++;
+	if (dt_us > 0)
+	{
+		//Average with the previous estimate to damp report jitter
+		int32_t vx = (int32_t)(((int64_t)sample->x - last.x) * 1000000 / dt_us);
+		int32_t vy = (int32_t)(((int64_t)sample->y - last.y) * 1000000 / dt_us);
+		velocity_x = (velocity_x + vx) / 2;
+		velocity_y = (velocity_y + vy) / 2;
+	}
+	last = *sample;
+
+	if (!dragging && !long_pressed &&
+		(abs((int32_t)sample->x - start.x) >= config.move_threshold_px ||
+		 abs((int32_t)sample->y - start.y) >= config.move_threshold_px))
+	{
+		dragging = true;
+		emit(DragStart, &start, SwipeNone);
+	}
+
+	if (dragging)
+	{
+		emit(DragMove, sample, SwipeNone);
+	}
+	else
+	{
+		check_long_press(sample->time_us);
+	}
+}
+
+static void on_release(const touch_sample_t *sample)
+{
+	//The release report carries no coordinates, the gesture ends where the last sample was
+	touch_sample_t end = last;
+	end.time_us = sample->time_us;
+	pressed = false;
+	press_samples++;
+
+	if (dragging)
+	{
+		touch_swipe_dir_t direction = config.hw_gestures ? SwipeNone : swipe_direction();
+		if (direction != SwipeNone)
+		{
+			emit(Swipe, &end, direction);
+		}
+		emit(DragEnd, &end, SwipeNone);
+		tap_pending = false;
+		return;
+	}
+
+	if (long_pressed || hw_reported || end.time_us - start.time_us > (int64_t)config.tap_max_ms * 1000)
+	{
+		tap_pending = false;
+		return;
+	}
+
+	if (tap_pending && start.time_us - tap_release_us <= (int64_t)config.double_tap_ms * 1000 &&
+		abs((int32_t)start.x - tap_point.x) < config.move_threshold_px * 2 &&
+		abs((int32_t)start.y - tap_point.y) < config.move_threshold_px * 2)
+	{
+		tap_pending = false;
+		emit(DoubleTap, &end, SwipeNone);
+		return;
+	}
+
+	//Tap is reported right away, a following DoubleTap is delivered in addition rather than instead
+	tap_pending = true;
+	tap_release_us = end.time_us;
+	tap_point.x = end.x;
+	tap_point.y = end.y;
+	emit(Tap, &end, SwipeNone);
+}
+
+void touch_gesture_init(const touch_gesture_config_t *cfg, touch_gesture_cb_t cb, void *user_data)
+{
+	config = *cfg;
+	gesture_cb = cb;
+	gesture_user_data = user_data;
+	touch_gesture_reset();
+}
+
+void touch_gesture_reset(void)
+{
+	pressed = false;
+	dragging = false;
+	long_pressed = false;
+	hw_reported = false;
+	tap_pending = false;
+	velocity_x = 0;
+	velocity_y = 0;
+}
+
+void touch_gesture_feed(const touch_sample_t *sample)
+{
+	if (sample->pressed)
+	{
+		if (!pressed) on_press(sample);
+		else on_move(sample);
+		check_hw_gesture(sample);
+	}
+	else if (pressed)
+	{
+		on_release(sample);
+	}
+}
+
+void touch_gesture_process(int64_t now_us)
+{
+	touch_sample_t sample;
+	while (touch_ring_pop(&sample))
+	{
+		touch_gesture_feed(&sample);
+	}
+	check_long_press(now_us);
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "touch_power.h"
+#include "ft5436.h"
+#include "i2c_controller.h"
+#include <esp_log.h>
+
+static const char *TAG = "touch_power";
+
+//The inputs are set by the UI, state and everything below it only change in the touch bus worker
+static volatile bool dragging;
+static volatile bool ui_idle;
+static volatile bool display_on = true;
+static bool apply_queued;
+static volatile touch_power_state_t state = TouchPowerActive;
+static uint8_t report_rate;
+static volatile uint32_t transitions;
+
+static touch_power_state_t resolve_state(void)
+{
+	if (!display_on) return TOUCH_POWER_HIBERNATE_ON_SCREEN_OFF ? TouchPowerHibernate : TouchPowerMonitor;
+	if (dragging) return TouchPowerDrag;
+	if (ui_idle) return TouchPowerMonitor;
+	return TouchPowerActive;
+}
+
+static esp_err_t set_rate(uint8_t rate)
+{
+	if (rate == report_rate) return ESP_OK;
+
+	esp_err_t err = ft5436_set_report_rate(rate);
+	if (err == ESP_OK) report_rate = rate;
+	return err;
+}
+
+//Only the registers that differ between the two states are written
+static void apply_state(void)
+{
+	touch_power_state_t next = resolve_state();
+	esp_err_t err = ESP_OK;
+
+	if (next == state) return;
+
+	//Hibernate reset the controller's registers, the driver restores its own and the monitor settings are ours
+	if (state == TouchPowerHibernate)
+	{
+		err = ft5436_wake();
+		if (err == ESP_OK) err = ft5436_set_monitor(true, TOUCH_POWER_MONITOR_ENTER_S, TOUCH_POWER_MONITOR_PERIOD_MS);
+		if (err != ESP_OK)
+		{
+			ESP_LOGW(TAG, "Wake from hibernate failed: %s", esp_err_to_name(err));
+			return;
+		}
+	}
+
+	switch (next)
+	{
+		case TouchPowerActive:
+		case TouchPowerDrag:
+			if (state == TouchPowerMonitor) err = ft5436_set_power_mode(FT6X36_PMODE_ACTIVE);
+			if (err == ESP_OK) err = set_rate(next == TouchPowerDrag ? TOUCH_POWER_RATE_DRAG : TOUCH_POWER_RATE_NORMAL);
+			break;
+		case TouchPowerMonitor:
+			err = ft5436_set_power_mode(FT6X36_PMODE_MONITOR);
+			break;
+		case TouchPowerHibernate:
+			err = ft5436_set_power_mode(FT6X36_PMODE_HIBERNATE);
+			//Whatever rate was set is gone once the controller wakes
+			if (err == ESP_OK) report_rate = 0;
+			break;
+	}
+
+	if (err != ESP_OK)
+	{
+		ESP_LOGW(TAG, "Transition %d -> %d failed: %s", state, next, esp_err_to_name(err));
+		return;
+	}
+	ESP_LOGD(TAG, "%d -> %d", state, next);
+	state = next;
+	transitions++;
+}
+
+static void apply_job(void *arg)
+{
+	//Cleared first, so an input that changes during the transition queues another one
+	__atomic_store_n(&apply_queued, false, __ATOMIC_SEQ_CST);
+	apply_state();
+}
+
+//The transition goes to the touch bus worker and uses the inputs as they are when it runs, several changes in a row
+//cost one transition. A failed one is retried on the next change, as before
+static void request_apply(void)
+{
+	if (__atomic_exchange_n(&apply_queued, true, __ATOMIC_SEQ_CST)) return;
+
+	esp_err_t err = i2c_submit_call(I2C_BUS_TOUCH, apply_job, NULL);
+	if (err != ESP_OK)
+	{
+		__atomic_store_n(&apply_queued, false, __ATOMIC_SEQ_CST);
+		ESP_LOGW(TAG, "Transition not queued: %s", esp_err_to_name(err));
+	}
+}
+
+esp_err_t touch_power_init(void)
+{
+	esp_err_t err = ft5436_set_monitor(true, TOUCH_POWER_MONITOR_ENTER_S, TOUCH_POWER_MONITOR_PERIOD_MS);
+	if (err == ESP_OK) err = ft5436_set_report_rate(TOUCH_POWER_RATE_NORMAL);
+	if (err == ESP_OK) err = ft5436_set_power_mode(FT6X36_PMODE_ACTIVE);
+	report_rate = TOUCH_POWER_RATE_NORMAL;
+	state = TouchPowerActive;
+	return err;
+}
+
+void touch_power_set_dragging(bool value)
+{
+	dragging = value;
+	request_apply();
+}
+
+void touch_power_set_ui_idle(bool idle)
+{
+	if (idle == ui_idle) return;
+	ui_idle = idle;
+	request_apply();
+}
+
+void touch_power_set_display_on(bool on)
+{
+	display_on = on;
+	request_apply();
+}
+
+touch_power_state_t touch_power_get_state(void)
+{
+	return state;
+}
+
+uint32_t touch_power_get_transitions(void)
+{
+	return transitions;
+}
\ No newline at end of file